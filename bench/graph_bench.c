@@ -0,0 +1,450 @@
+/* graph_bench: headless micro-benchmarks of graph generation, the sparse
+ * store and the analytics, without a window or a GPU. Every measurement is
+ * one CSV line or JSON object so runs of different releases can be
+ * diffed. */
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "analysis.h"
+#include "graph.h"
+#include "layout.h"
+
+/* the reference sampler is O(N) per edge */
+#define BENCH_LINEAR_SCAN_MAX_NODES 10000u
+#define BENCH_MAX_THREAD_COUNTS 16u
+
+typedef enum {
+  BENCH_FORMAT_CSV = 0,
+  BENCH_FORMAT_JSON,
+} BenchFormat;
+
+typedef struct {
+  BenchFormat format;
+  uint32_t max_nodes;
+  uint64_t max_edges;
+  uint32_t repeats;
+  uint64_t seed;
+
+  /* 1, 2, 4, ... and every online core */
+  uint32_t thread_counts[BENCH_MAX_THREAD_COUNTS];
+  uint32_t thread_count_count;
+
+  uint32_t result_count;
+} Bench;
+
+typedef struct {
+  const char* benchmark;
+  const char* variant;
+  uint32_t nodes;
+  uint32_t m;
+  uint32_t threads;
+  uint64_t edges;
+  /* best of the repeats */
+  double seconds;
+  uint64_t peak_rss_kb;
+} BenchResult;
+
+static double Seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+/* start a new high-water mark of the resident set, Linux only. Elsewhere
+ * the peak stays the one of the whole process */
+static void ResetPeakRss(void) {
+  FILE* file = fopen("/proc/self/clear_refs", "w");
+  if (file != NULL) {
+    fputs("5", file);
+    fclose(file);
+  }
+}
+
+static uint64_t PeakRssKb(void) {
+  FILE* file = fopen("/proc/self/status", "r");
+  if (file != NULL) {
+    char line[256];
+    unsigned long long kb = 0;
+    bool found = false;
+    while (!found && fgets(line, sizeof(line), file) != NULL) {
+      found = 1 == sscanf(line, "VmHWM: %llu kB", &kb);
+    }
+    fclose(file);
+    if (found) {
+      return kb;
+    }
+  }
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return (uint64_t)usage.ru_maxrss;
+}
+
+static void PrintResult(Bench* bench, const BenchResult* result) {
+  double edges_per_second =
+      result->seconds > 0.0 ? (double)result->edges / result->seconds : 0.0;
+  double ns_per_edge = result->edges > 0
+                           ? result->seconds * 1e9 / (double)result->edges
+                           : 0.0;
+  if (bench->format == BENCH_FORMAT_JSON) {
+    printf("%s  {\"benchmark\": \"%s\", \"variant\": \"%s\", \"nodes\": %u, "
+           "\"m\": %u, \"threads\": %u, \"edges\": %llu, \"seconds\": %.9f, "
+           "\"edges_per_sec\": %.1f, \"ns_per_edge\": %.3f, "
+           "\"peak_rss_kb\": %llu}",
+           bench->result_count > 0 ? ",\n" : "", result->benchmark,
+           result->variant, result->nodes, result->m, result->threads,
+           (unsigned long long)result->edges, result->seconds,
+           edges_per_second, ns_per_edge,
+           (unsigned long long)result->peak_rss_kb);
+  } else {
+    printf("%s,%s,%u,%u,%u,%llu,%.9f,%.1f,%.3f,%llu\n", result->benchmark,
+           result->variant, result->nodes, result->m, result->threads,
+           (unsigned long long)result->edges, result->seconds,
+           edges_per_second, ns_per_edge,
+           (unsigned long long)result->peak_rss_kb);
+  }
+  fflush(stdout);
+  bench->result_count++;
+}
+
+static void Record(BenchResult* result, double seconds) {
+  if (result->seconds == 0.0 || seconds < result->seconds) {
+    result->seconds = seconds;
+  }
+}
+
+/* init() and generate() in one mode, only generate() is timed */
+static int BenchGenerate(Bench* bench, uint32_t nodes, uint32_t m,
+                         GenerateMode mode, const char* variant,
+                         uint32_t threads) {
+  BenchResult result = {.benchmark = "generate",
+                        .variant = variant,
+                        .nodes = nodes,
+                        .m = m,
+                        .threads = threads};
+  ResetPeakRss();
+  for (uint32_t r = 0; r < bench->repeats; r++) {
+    Graph graph;
+    if (0 != init(&graph, nodes, m + 1)) {
+      return -1;
+    }
+    GenerateOptions options = {
+        .m = m, .mode = mode, .seed = bench->seed, .thread_count = threads};
+    double start = Seconds();
+    int status = generate(&graph, &options);
+    double seconds = Seconds() - start;
+    result.edges = graph.edge_count;
+    GraphDestroy(&graph);
+    if (status != 0) {
+      return -1;
+    }
+    Record(&result, seconds);
+  }
+  result.peak_rss_kb = PeakRssKb();
+  PrintResult(bench, &result);
+  return 0;
+}
+
+/* every edge of a frozen graph once, as the pairs GraphFreezeEdges()
+ * takes */
+static uint32_t* EdgePairs(const Graph* graph) {
+  uint32_t* pairs =
+      (uint32_t*)malloc(sizeof(uint32_t) * 2 * (graph->edge_count + 1));
+  if (pairs == NULL) {
+    fprintf(stderr, "failed to allocate %llu edges\n",
+            (unsigned long long)graph->edge_count);
+    return NULL;
+  }
+  uint64_t edge_count = 0;
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    uint32_t count = 0;
+    const uint32_t* neighbors = GraphNeighbors(graph, i, &count);
+    for (uint32_t k = 0; k < count; k++) {
+      if (i < neighbors[k]) {
+        pairs[2 * edge_count] = i;
+        pairs[2 * edge_count + 1] = neighbors[k];
+        edge_count++;
+      }
+    }
+  }
+  return pairs;
+}
+
+static int BuildStore(Graph* store, uint32_t nodes, const uint32_t* pairs,
+                      uint64_t edge_count, bool rows) {
+  if (0 != GraphCreate(store, nodes)) {
+    return -1;
+  }
+  while (store->node_count < nodes) {
+    GraphAddNode(store);
+  }
+  if (!rows) {
+    return GraphFreezeEdges(store, pairs, edge_count);
+  }
+  for (uint64_t e = 0; e < edge_count; e++) {
+    if (0 != GraphAddEdge(store, pairs[2 * e], pairs[2 * e + 1])) {
+      return -1;
+    }
+  }
+  return GraphFreeze(store);
+}
+
+/* building the store edge by edge and in one pass, and walking it */
+static int BenchStore(Bench* bench, const Graph* graph, uint32_t m) {
+  uint32_t* pairs = EdgePairs(graph);
+  if (pairs == NULL) {
+    return -1;
+  }
+  const char* variants[2] = {"add_edge_freeze", "freeze_edges"};
+  for (uint32_t v = 0; v < 2; v++) {
+    BenchResult result = {.benchmark = "store",
+                          .variant = variants[v],
+                          .nodes = graph->node_count,
+                          .m = m,
+                          .threads = 1,
+                          .edges = graph->edge_count};
+    ResetPeakRss();
+    for (uint32_t r = 0; r < bench->repeats; r++) {
+      Graph store;
+      double start = Seconds();
+      int status = BuildStore(&store, graph->node_count, pairs,
+                              graph->edge_count, v == 0);
+      double seconds = Seconds() - start;
+      GraphDestroy(&store);
+      if (status != 0) {
+        free(pairs);
+        return -1;
+      }
+      Record(&result, seconds);
+    }
+    result.peak_rss_kb = PeakRssKb();
+    PrintResult(bench, &result);
+  }
+  free(pairs);
+
+  BenchResult result = {.benchmark = "store",
+                        .variant = "neighbor_scan",
+                        .nodes = graph->node_count,
+                        .m = m,
+                        .threads = 1,
+                        .edges = graph->edge_count};
+  ResetPeakRss();
+  uint64_t checksum = 0;
+  for (uint32_t r = 0; r < bench->repeats; r++) {
+    double start = Seconds();
+    for (uint32_t i = 0; i < graph->node_count; i++) {
+      uint32_t count = 0;
+      const uint32_t* neighbors = GraphNeighbors(graph, i, &count);
+      for (uint32_t k = 0; k < count; k++) {
+        checksum += neighbors[k];
+      }
+    }
+    Record(&result, Seconds() - start);
+  }
+  result.peak_rss_kb = PeakRssKb();
+  /* keeps the scan from being optimized away */
+  if (checksum == 0 && graph->edge_count > 0) {
+    fprintf(stderr, "neighbor scan saw no edges\n");
+  }
+  PrintResult(bench, &result);
+  return 0;
+}
+
+static int BenchAnalysis(Bench* bench, const Graph* graph, uint32_t m,
+                         uint32_t threads) {
+  BenchResult histogram_result = {.benchmark = "analysis",
+                                  .variant = "degree_histogram",
+                                  .nodes = graph->node_count,
+                                  .m = m,
+                                  .threads = threads,
+                                  .edges = graph->edge_count};
+  BenchResult fit_result = histogram_result;
+  fit_result.variant = "power_law_fit";
+  ResetPeakRss();
+  for (uint32_t r = 0; r < bench->repeats; r++) {
+    DegreeHistogram histogram;
+    double start = Seconds();
+    if (0 != DegreeHistogramFromGraph(&histogram, graph, threads)) {
+      return -1;
+    }
+    Record(&histogram_result, Seconds() - start);
+
+    PowerLawFit fit;
+    start = Seconds();
+    int status = PowerLawFitDegrees(&histogram, threads, &fit);
+    double seconds = Seconds() - start;
+    DegreeHistogramDestroy(&histogram);
+    /* too few distinct degrees is not a failure of the benchmark */
+    if (status == 0) {
+      Record(&fit_result, seconds);
+    }
+  }
+  histogram_result.peak_rss_kb = PeakRssKb();
+  fit_result.peak_rss_kb = histogram_result.peak_rss_kb;
+  PrintResult(bench, &histogram_result);
+  if (fit_result.seconds > 0.0) {
+    PrintResult(bench, &fit_result);
+  }
+  return 0;
+}
+
+/* one ForceAtlas2 iteration, after the one that sizes the tree */
+static int BenchLayout(Bench* bench, const Graph* graph, uint32_t m,
+                       uint32_t threads) {
+  BenchResult result = {.benchmark = "layout",
+                        .variant = "step",
+                        .nodes = graph->node_count,
+                        .m = m,
+                        .threads = threads,
+                        .edges = graph->edge_count};
+  ResetPeakRss();
+  LayoutOptions options;
+  LayoutDefaultOptions(&options);
+  options.thread_count = threads;
+  options.seed = bench->seed;
+  Layout layout;
+  if (0 != LayoutCreate(&layout, graph, &options)) {
+    return -1;
+  }
+  int status = 0.f > LayoutStep(&layout) ? -1 : 0;
+  for (uint32_t r = 0; status == 0 && r < bench->repeats; r++) {
+    double start = Seconds();
+    status = 0.f > LayoutStep(&layout) ? -1 : 0;
+    Record(&result, Seconds() - start);
+  }
+  LayoutDestroy(&layout);
+  if (status != 0) {
+    return -1;
+  }
+  result.peak_rss_kb = PeakRssKb();
+  PrintResult(bench, &result);
+  return 0;
+}
+
+static int BenchSize(Bench* bench, uint32_t nodes, uint32_t m) {
+  if (0 != BenchGenerate(bench, nodes, m, GENERATE_MODE_REPEATED_ENDPOINTS,
+                         "repeated_endpoints", 1)) {
+    return -1;
+  }
+  if (nodes <= BENCH_LINEAR_SCAN_MAX_NODES &&
+      0 != BenchGenerate(bench, nodes, m, GENERATE_MODE_LINEAR_SCAN,
+                         "linear_scan", 1)) {
+    return -1;
+  }
+  for (uint32_t t = 0; t < bench->thread_count_count; t++) {
+    if (0 != BenchGenerate(bench, nodes, m, GENERATE_MODE_PARALLEL,
+                           "parallel", bench->thread_counts[t])) {
+      return -1;
+    }
+  }
+
+  /* the store and analytics benchmarks share one graph */
+  Graph graph;
+  if (0 != init(&graph, nodes, m + 1)) {
+    return -1;
+  }
+  GenerateOptions options = {.m = m, .seed = bench->seed};
+  int status = generate(&graph, &options);
+  if (status == 0) {
+    status = BenchStore(bench, &graph, m);
+  }
+  for (uint32_t t = 0; status == 0 && t < bench->thread_count_count; t++) {
+    status = BenchAnalysis(bench, &graph, m, bench->thread_counts[t]);
+  }
+  for (uint32_t t = 0; status == 0 && t < bench->thread_count_count; t++) {
+    status = BenchLayout(bench, &graph, m, bench->thread_counts[t]);
+  }
+  GraphDestroy(&graph);
+  return status;
+}
+
+static void Usage(const char* name) {
+  fprintf(stderr,
+          "usage: %s [--format csv|json] [--max-nodes <n>] "
+          "[--max-edges <n>] [--repeats <n>] [--seed <n>]\n",
+          name);
+}
+
+static int ParseArguments(Bench* bench, int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc) {
+      return -1;
+    }
+    const char* value = argv[i + 1];
+    if (0 == strcmp(argv[i], "--format")) {
+      if (0 == strcmp(value, "json")) {
+        bench->format = BENCH_FORMAT_JSON;
+      } else if (0 == strcmp(value, "csv")) {
+        bench->format = BENCH_FORMAT_CSV;
+      } else {
+        return -1;
+      }
+    } else if (0 == strcmp(argv[i], "--max-nodes")) {
+      bench->max_nodes = (uint32_t)strtoul(value, NULL, 10);
+    } else if (0 == strcmp(argv[i], "--max-edges")) {
+      bench->max_edges = strtoull(value, NULL, 10);
+    } else if (0 == strcmp(argv[i], "--repeats")) {
+      bench->repeats = (uint32_t)strtoul(value, NULL, 10);
+    } else if (0 == strcmp(argv[i], "--seed")) {
+      bench->seed = strtoull(value, NULL, 10);
+    } else {
+      return -1;
+    }
+    i++;
+  }
+  return bench->repeats > 0 ? 0 : -1;
+}
+
+int main(int argc, char** argv) {
+  Bench bench = {.format = BENCH_FORMAT_CSV,
+                 .max_nodes = 1000000,
+                 .max_edges = 20000000,
+                 .repeats = 3,
+                 .seed = 1};
+  if (0 != ParseArguments(&bench, argc, argv)) {
+    Usage(argv[0]);
+    return 1;
+  }
+
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  uint32_t cores = online > 0 ? (uint32_t)online : 1u;
+  for (uint32_t t = 1; t < cores && bench.thread_count_count <
+                                        BENCH_MAX_THREAD_COUNTS - 1;
+       t *= 2) {
+    bench.thread_counts[bench.thread_count_count++] = t;
+  }
+  bench.thread_counts[bench.thread_count_count++] = cores;
+
+  if (bench.format == BENCH_FORMAT_JSON) {
+    printf("[\n");
+  } else {
+    printf("benchmark,variant,nodes,m,threads,edges,seconds,edges_per_sec,"
+           "ns_per_edge,peak_rss_kb\n");
+  }
+
+  /* N and m over several orders of magnitude, as far as the limits allow */
+  const uint32_t ms[] = {1, 4, 16, 64};
+  int status = 0;
+  for (uint64_t nodes = 1000; status == 0 && nodes <= bench.max_nodes;
+       nodes *= 10) {
+    for (uint32_t i = 0; status == 0 && i < sizeof(ms) / sizeof(ms[0]); i++) {
+      if (nodes <= ms[i] + 1 || nodes * ms[i] > bench.max_edges) {
+        continue;
+      }
+      status = BenchSize(&bench, (uint32_t)nodes, ms[i]);
+    }
+  }
+
+  if (bench.format == BENCH_FORMAT_JSON) {
+    printf("\n]\n");
+  }
+  if (status != 0) {
+    fprintf(stderr, "benchmark failed\n");
+    return 1;
+  }
+  return 0;
+}
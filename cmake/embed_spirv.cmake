@@ -0,0 +1,32 @@
+# write the SPIR-V binaries in SPIRV_FILES, separated by '|', to OUTPUT as
+# the table of PipelineShader that pipeline.c looks shaders up in.
+# cmake -DSPIRV_FILES=a.spv|b.spv -DOUTPUT=shaders.c -P embed_spirv.cmake
+string(REPLACE "|" ";" SPIRV_FILES "${SPIRV_FILES}")
+
+set(CONTENT "/* generated from the compiled shaders by embed_spirv.cmake */\n")
+string(APPEND CONTENT "#include \"pipeline.h\"\n\n")
+set(TABLE "")
+set(INDEX 0)
+foreach(SPIRV ${SPIRV_FILES})
+    get_filename_component(NAME ${SPIRV} NAME)
+    file(READ ${SPIRV} HEX HEX)
+    # SPIR-V is a stream of little-endian 32-bit words
+    string(REGEX REPLACE "(..)(..)(..)(..)" "0x\\4\\3\\2\\1u,\n"
+        WORDS "${HEX}")
+    string(APPEND CONTENT
+        "static const uint32_t shader_${INDEX}[] = {\n${WORDS}};\n\n")
+    string(APPEND TABLE
+        "    {\"${NAME}\", shader_${INDEX}, sizeof(shader_${INDEX})},\n")
+    math(EXPR INDEX "${INDEX} + 1")
+endforeach()
+string(APPEND CONTENT "const PipelineShader pipeline_shaders[] = {\n")
+string(APPEND CONTENT "${TABLE}};\n")
+string(APPEND CONTENT "const uint32_t pipeline_shader_count = ${INDEX};\n")
+
+# only touch the output when it changes, so nothing rebuilds needlessly
+if(EXISTS ${OUTPUT})
+    file(READ ${OUTPUT} PREVIOUS)
+endif()
+if(NOT "${PREVIOUS}" STREQUAL "${CONTENT}")
+    file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
@@ -0,0 +1,13 @@
+#version 450
+
+layout(location = 0) out vec4 out_color;
+
+layout(push_constant) uniform View {
+  vec4 color;
+  vec2 scale;
+  vec2 offset;
+  vec2 pixel;
+  float point_size;
+};
+
+void main() { out_color = color; }
@@ -0,0 +1,36 @@
+#version 450
+
+/* two vertices per edge, the endpoints are pulled from the edge buffer and
+ * their positions from the node buffer */
+layout(std430, set = 0, binding = 0) readonly buffer Positions {
+  vec2 positions[];
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer Edges {
+  uint edges[];
+};
+
+/* min x, min y, max x, max y of the part of the world that is shown, the
+ * same for every vertex */
+layout(location = 0) in vec4 bounds;
+
+layout(push_constant) uniform View {
+  vec4 color;
+  vec2 scale;
+  vec2 offset;
+  vec2 pixel;
+  float point_size;
+};
+
+void main() {
+  /* map the bounds' enclosing square to [-1, 1], scale keeps it square on
+   * screen */
+  vec2 center = 0.5 * (bounds.xy + bounds.zw);
+  vec2 extent = bounds.zw - bounds.xy;
+  float radius = 0.5 * max(extent.x, extent.y);
+  if (!(radius > 0.0)) {
+    radius = 1.0;
+  }
+  vec2 normalized = (positions[edges[gl_VertexIndex]] - center) / radius;
+  gl_Position = vec4(normalized * scale + offset, 0.0, 1.0);
+}
@@ -0,0 +1,38 @@
+#version 450
+
+/* one instance per node, a quad of point_size pixels around the node's
+ * position pulled from the node buffer */
+layout(std430, set = 0, binding = 0) readonly buffer Positions {
+  vec2 positions[];
+};
+
+/* min x, min y, max x, max y of the part of the world that is shown, the
+ * same for every vertex */
+layout(location = 0) in vec4 bounds;
+
+layout(push_constant) uniform View {
+  vec4 color;
+  vec2 scale;
+  vec2 offset;
+  vec2 pixel;
+  float point_size;
+};
+
+void main() {
+  /* map the bounds' enclosing square to [-1, 1], scale keeps it square on
+   * screen */
+  vec2 center = 0.5 * (bounds.xy + bounds.zw);
+  vec2 extent = bounds.zw - bounds.xy;
+  float radius = 0.5 * max(extent.x, extent.y);
+  if (!(radius > 0.0)) {
+    radius = 1.0;
+  }
+  vec2 normalized = (positions[gl_InstanceIndex] - center) / radius;
+
+  /* triangle strip corners (-1, -1), (1, -1), (-1, 1), (1, 1) */
+  vec2 corner = vec2(float(gl_VertexIndex & 1), float(gl_VertexIndex >> 1));
+  corner = 2.0 * corner - 1.0;
+  gl_Position = vec4(normalized * scale + offset +
+                         0.5 * point_size * pixel * corner,
+                     0.0, 1.0);
+}
@@ -0,0 +1,390 @@
+
+#include "analysis.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* nodes a histogram thread should at least get, below that the thread
+ * start costs more than the counting */
+#define ANALYSIS_MIN_NODES_PER_THREAD (1u << 18)
+
+/* interleaved sub-histograms per thread, consecutive nodes of the same
+ * degree then increment different counters instead of waiting on one */
+#define ANALYSIS_HISTOGRAM_WAYS 4u
+
+static uint32_t AnalysisThreadCount(uint32_t requested) {
+  if (requested != 0) {
+    return requested;
+  }
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  return online > 0 ? (uint32_t)online : 1u;
+}
+
+/* run worker on every task, the calling thread takes the first one */
+static void AnalysisRun(void* (*worker)(void*), void* tasks,
+                        size_t task_size, uint32_t task_count) {
+  pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * task_count);
+  bool* started = (bool*)calloc(task_count, sizeof(bool));
+  uint8_t* base = (uint8_t*)tasks;
+
+  for (uint32_t i = 1; i < task_count; i++) {
+    if (threads != NULL && started != NULL &&
+        0 == pthread_create(&threads[i], NULL, worker, base + i * task_size)) {
+      started[i] = true;
+    } else {
+      /* a failed thread creation only costs speed */
+      worker(base + i * task_size);
+    }
+  }
+  worker(base);
+  for (uint32_t i = 1; i < task_count; i++) {
+    if (started != NULL && started[i]) {
+      pthread_join(threads[i], NULL);
+    }
+  }
+
+  free(started);
+  free(threads);
+}
+
+typedef struct {
+  const uint32_t* degree;
+  uint32_t begin;
+  uint32_t end;
+  uint32_t max_degree;
+  /* ANALYSIS_HISTOGRAM_WAYS rows of stride counters */
+  uint32_t* counts;
+  uint32_t stride;
+} HistogramTask;
+
+static void* MaxDegreeWorker(void* arg) {
+  HistogramTask* task = (HistogramTask*)arg;
+  const uint32_t* degree = task->degree;
+  /* branch-free max reduction, vectorizes */
+  uint32_t max_degree = 0;
+  for (uint32_t i = task->begin; i < task->end; i++) {
+    max_degree = degree[i] > max_degree ? degree[i] : max_degree;
+  }
+  task->max_degree = max_degree;
+  return NULL;
+}
+
+static void* CountDegreesWorker(void* arg) {
+  HistogramTask* task = (HistogramTask*)arg;
+  const uint32_t* degree = task->degree;
+  uint32_t* counts = task->counts;
+  uint32_t stride = task->stride;
+
+  uint32_t i = task->begin;
+  for (; i + ANALYSIS_HISTOGRAM_WAYS <= task->end;
+       i += ANALYSIS_HISTOGRAM_WAYS) {
+    counts[degree[i]]++;
+    counts[stride + degree[i + 1]]++;
+    counts[2 * stride + degree[i + 2]]++;
+    counts[3 * stride + degree[i + 3]]++;
+  }
+  for (; i < task->end; i++) {
+    counts[degree[i]]++;
+  }
+  return NULL;
+}
+
+int DegreeHistogramCreate(DegreeHistogram* histogram, const uint32_t* degree,
+                          uint32_t node_count, uint32_t thread_count) {
+  memset(histogram, 0, sizeof(DegreeHistogram));
+  histogram->node_count = node_count;
+  if (node_count == 0) {
+    return 0;
+  }
+
+  thread_count = AnalysisThreadCount(thread_count);
+  uint32_t useful = node_count / ANALYSIS_MIN_NODES_PER_THREAD + 1;
+  if (thread_count > useful) {
+    thread_count = useful;
+  }
+  HistogramTask* tasks =
+      (HistogramTask*)calloc(thread_count, sizeof(HistogramTask));
+  if (tasks == NULL) {
+    fprintf(stderr, "failed to allocate %u histogram tasks\n", thread_count);
+    return -1;
+  }
+  for (uint32_t t = 0; t < thread_count; t++) {
+    tasks[t].degree = degree;
+    tasks[t].begin = (uint32_t)((uint64_t)node_count * t / thread_count);
+    tasks[t].end = (uint32_t)((uint64_t)node_count * (t + 1) / thread_count);
+  }
+
+  /* first pass sizes the tables, the second fills one per thread */
+  AnalysisRun(MaxDegreeWorker, tasks, sizeof(HistogramTask), thread_count);
+  uint32_t max_degree = 0;
+  for (uint32_t t = 0; t < thread_count; t++) {
+    if (tasks[t].max_degree > max_degree) {
+      max_degree = tasks[t].max_degree;
+    }
+  }
+  uint32_t stride = max_degree + 1;
+  uint32_t* counts = (uint32_t*)calloc(
+      (size_t)thread_count * ANALYSIS_HISTOGRAM_WAYS * stride,
+      sizeof(uint32_t));
+  uint64_t* totals = (uint64_t*)calloc(stride, sizeof(uint64_t));
+  if (counts == NULL || totals == NULL) {
+    fprintf(stderr, "failed to allocate the histogram up to degree %u\n",
+            max_degree);
+    free(totals);
+    free(counts);
+    free(tasks);
+    return -1;
+  }
+  for (uint32_t t = 0; t < thread_count; t++) {
+    tasks[t].counts = counts + (size_t)t * ANALYSIS_HISTOGRAM_WAYS * stride;
+    tasks[t].stride = stride;
+  }
+  AnalysisRun(CountDegreesWorker, tasks, sizeof(HistogramTask),
+              thread_count);
+
+  uint32_t distinct_count = 0;
+  for (uint32_t row = 0; row < thread_count * ANALYSIS_HISTOGRAM_WAYS;
+       row++) {
+    const uint32_t* row_counts = counts + (size_t)row * stride;
+    for (uint32_t k = 0; k < stride; k++) {
+      totals[k] += row_counts[k];
+    }
+  }
+  for (uint32_t k = 0; k < stride; k++) {
+    distinct_count += totals[k] != 0;
+  }
+  free(counts);
+  free(tasks);
+
+  histogram->degrees = (uint32_t*)malloc(sizeof(uint32_t) * distinct_count);
+  histogram->counts = (uint64_t*)malloc(sizeof(uint64_t) * distinct_count);
+  if (histogram->degrees == NULL || histogram->counts == NULL) {
+    fprintf(stderr, "failed to allocate %u histogram entries\n",
+            distinct_count);
+    free(totals);
+    DegreeHistogramDestroy(histogram);
+    return -1;
+  }
+  for (uint32_t k = 0; k < stride; k++) {
+    if (totals[k] != 0) {
+      histogram->degrees[histogram->distinct_count] = k;
+      histogram->counts[histogram->distinct_count] = totals[k];
+      histogram->distinct_count++;
+    }
+  }
+  histogram->max_degree = max_degree;
+  free(totals);
+  return 0;
+}
+
+int DegreeHistogramFromGraph(DegreeHistogram* histogram, const Graph* graph,
+                             uint32_t thread_count) {
+  return DegreeHistogramCreate(histogram, graph->degree, graph->node_count,
+                               thread_count);
+}
+
+void DegreeHistogramDestroy(DegreeHistogram* histogram) {
+  free(histogram->degrees);
+  free(histogram->counts);
+  memset(histogram, 0, sizeof(DegreeHistogram));
+}
+
+void DegreeCcdf(const DegreeHistogram* histogram, double* ccdf) {
+  double scale = 1.0 / (double)histogram->node_count;
+  uint64_t tail = 0;
+  for (uint32_t d = histogram->distinct_count; d-- > 0;) {
+    tail += histogram->counts[d];
+    ccdf[d] = (double)tail * scale;
+  }
+}
+
+uint32_t DegreeLogBins(const DegreeHistogram* histogram, double base,
+                       LogBin* bins, uint32_t max_bins) {
+  if (base <= 1.0 || histogram->node_count == 0) {
+    return 0;
+  }
+
+  uint32_t bin_count = 0;
+  uint32_t d = 0;
+  /* degree 0 has no place on a log axis */
+  while (d < histogram->distinct_count && histogram->degrees[d] == 0) {
+    d++;
+  }
+  double lower = 1.0;
+  while (bin_count < max_bins && lower <= (double)histogram->max_degree) {
+    /* integer degrees of the bin are ceil(lower) .. ceil(upper) - 1, a bin
+     * narrower than one integer is widened until it holds one */
+    double upper = lower * base;
+    while (ceil(upper) - ceil(lower) < 1.0) {
+      upper *= base;
+    }
+    double width = ceil(upper) - ceil(lower);
+
+    uint64_t count = 0;
+    while (d < histogram->distinct_count &&
+           (double)histogram->degrees[d] < upper) {
+      count += histogram->counts[d];
+      d++;
+    }
+    LogBin* bin = &bins[bin_count++];
+    bin->lower = lower;
+    bin->upper = upper;
+    bin->center = sqrt(lower * upper);
+    bin->density = (double)count / (width * (double)histogram->node_count);
+    lower = upper;
+  }
+  return bin_count;
+}
+
+/* suffix sums over the distinct degrees, laid out as separate arrays so
+ * the scan over a tail is a straight loop over contiguous doubles */
+typedef struct {
+  uint32_t count;
+  const uint32_t* degrees;
+  /* nodes with degree >= degrees[d] */
+  double* tail;
+  /* sum of ln(k) over those nodes */
+  double* tail_log;
+  /* ln(degrees[d] - 1/2) */
+  double* log_half;
+} PowerLawTables;
+
+typedef struct {
+  const PowerLawTables* tables;
+  uint32_t first;
+  uint32_t end;
+  uint32_t step;
+  PowerLawFit best;
+} PowerLawTask;
+
+/* alpha for the tail starting at candidate i and the KS distance between
+ * the empirical and the fitted CCDF over that tail */
+static void PowerLawCandidate(const PowerLawTables* tables, uint32_t i,
+                              PowerLawFit* fit) {
+  double n = tables->tail[i];
+  double alpha =
+      1.0 + n / (tables->tail_log[i] - n * tables->log_half[i]);
+
+  double inverse_n = 1.0 / n;
+  double exponent = 1.0 - alpha;
+  double origin = tables->log_half[i];
+  const double* tail = tables->tail;
+  const double* log_half = tables->log_half;
+  double ks = 0.0;
+  for (uint32_t d = i; d < tables->count; d++) {
+    double model = exp(exponent * (log_half[d] - origin));
+    double distance = fabs(tail[d] * inverse_n - model);
+    ks = distance > ks ? distance : ks;
+  }
+
+  fit->alpha = alpha;
+  fit->sigma = (alpha - 1.0) / sqrt(n);
+  fit->xmin = tables->degrees[i];
+  fit->tail_count = (uint64_t)n;
+  fit->ks = ks;
+}
+
+static void* PowerLawWorker(void* arg) {
+  PowerLawTask* task = (PowerLawTask*)arg;
+  task->best.ks = INFINITY;
+  /* candidates are dealt out round-robin, the tails shrink with xmin so
+   * contiguous ranges would leave the first thread with most of the work */
+  for (uint32_t i = task->first; i < task->end; i += task->step) {
+    PowerLawFit fit;
+    PowerLawCandidate(task->tables, i, &fit);
+    if (fit.ks < task->best.ks) {
+      task->best = fit;
+    }
+  }
+  return NULL;
+}
+
+int PowerLawFitDegrees(const DegreeHistogram* histogram,
+                       uint32_t thread_count, PowerLawFit* fit) {
+  memset(fit, 0, sizeof(PowerLawFit));
+
+  /* the fit only sees degrees >= 1 */
+  uint32_t first = 0;
+  while (first < histogram->distinct_count &&
+         histogram->degrees[first] == 0) {
+    first++;
+  }
+  uint32_t count = histogram->distinct_count - first;
+  if (count < 2) {
+    fprintf(stderr, "PowerLawFitDegrees: need at least two degrees\n");
+    return -1;
+  }
+
+  PowerLawTables tables = {};
+  tables.count = count;
+  tables.degrees = histogram->degrees + first;
+  double* storage = (double*)malloc(sizeof(double) * 3 * count);
+  if (storage == NULL) {
+    fprintf(stderr, "failed to allocate the power-law tables\n");
+    return -1;
+  }
+  tables.tail = storage;
+  tables.tail_log = storage + count;
+  tables.log_half = storage + 2 * count;
+
+  double tail = 0.0;
+  double tail_log = 0.0;
+  for (uint32_t d = count; d-- > 0;) {
+    double k = (double)tables.degrees[d];
+    double c = (double)histogram->counts[first + d];
+    tail += c;
+    tail_log += c * log(k);
+    tables.tail[d] = tail;
+    tables.tail_log[d] = tail_log;
+    tables.log_half[d] = log(k - 0.5);
+  }
+
+  /* a candidate needs a tail of ANALYSIS_MIN_TAIL nodes and at least two
+   * distinct degrees */
+  uint32_t end = 0;
+  while (end + 1 < count && tables.tail[end] >= ANALYSIS_MIN_TAIL) {
+    end++;
+  }
+  if (end == 0) {
+    fprintf(stderr, "PowerLawFitDegrees: fewer than %u nodes in any tail\n",
+            ANALYSIS_MIN_TAIL);
+    free(storage);
+    return -1;
+  }
+
+  thread_count = AnalysisThreadCount(thread_count);
+  if (thread_count > end) {
+    thread_count = end;
+  }
+  PowerLawTask* tasks =
+      (PowerLawTask*)calloc(thread_count, sizeof(PowerLawTask));
+  if (tasks == NULL) {
+    fprintf(stderr, "failed to allocate %u fit tasks\n", thread_count);
+    free(storage);
+    return -1;
+  }
+  for (uint32_t t = 0; t < thread_count; t++) {
+    tasks[t].tables = &tables;
+    tasks[t].first = t;
+    tasks[t].end = end;
+    tasks[t].step = thread_count;
+  }
+  AnalysisRun(PowerLawWorker, tasks, sizeof(PowerLawTask), thread_count);
+
+  /* ties go to the smaller xmin, independent of the thread count */
+  *fit = tasks[0].best;
+  for (uint32_t t = 1; t < thread_count; t++) {
+    const PowerLawFit* best = &tasks[t].best;
+    if (best->ks < fit->ks || (best->ks == fit->ks && best->xmin < fit->xmin)) {
+      *fit = *best;
+    }
+  }
+
+  free(tasks);
+  free(storage);
+  return 0;
+}
@@ -0,0 +1,72 @@
+#ifndef ANALYSIS_H_
+#define ANALYSIS_H_
+
+#include <stdint.h>
+
+#include "graph.h"
+
+/* smallest tail the power-law fit accepts for a candidate xmin, shorter
+ * tails give estimates that are mostly noise */
+#define ANALYSIS_MIN_TAIL 50u
+
+/* nodes per degree, only the degrees that occur are stored, in increasing
+ * order, so the fits work on a few thousand entries instead of one per
+ * node */
+typedef struct {
+  uint32_t node_count;
+  uint32_t max_degree;
+  uint32_t distinct_count;
+  uint32_t* degrees;
+  uint64_t* counts;
+} DegreeHistogram;
+
+/* count the degrees of node_count nodes on thread_count threads (0 uses
+ * every online core) */
+int DegreeHistogramCreate(DegreeHistogram* histogram, const uint32_t* degree,
+                          uint32_t node_count, uint32_t thread_count);
+
+/* the degree array is valid in every graph layout, including mapped
+ * files */
+int DegreeHistogramFromGraph(DegreeHistogram* histogram, const Graph* graph,
+                             uint32_t thread_count);
+
+void DegreeHistogramDestroy(DegreeHistogram* histogram);
+
+/* P(degree >= degrees[i]) for every distinct degree, ccdf needs
+ * distinct_count entries */
+void DegreeCcdf(const DegreeHistogram* histogram, double* ccdf);
+
+/* bin [lower, upper) holds the degrees of that range, density is the
+ * fraction of nodes per integer degree so bins of different width are
+ * comparable on a log-log plot */
+typedef struct {
+  double lower;
+  double upper;
+  double center;
+  double density;
+} LogBin;
+
+/* geometric bins starting at degree 1, each base times wider than the last,
+ * writes at most max_bins and returns how many were written */
+uint32_t DegreeLogBins(const DegreeHistogram* histogram, double base,
+                       LogBin* bins, uint32_t max_bins);
+
+typedef struct {
+  /* P(k) ~ k^-alpha for k >= xmin */
+  double alpha;
+  /* standard error of alpha */
+  double sigma;
+  uint32_t xmin;
+  uint64_t tail_count;
+  /* Kolmogorov–Smirnov distance between the tail and the fitted law */
+  double ks;
+} PowerLawFit;
+
+/* discrete maximum-likelihood fit (Clauset, Shalizi, Newman) with the
+ * continuous approximation of the normalization, xmin is the candidate
+ * with the smallest KS distance. The candidates are scanned on
+ * thread_count threads (0 uses every online core). */
+int PowerLawFitDegrees(const DegreeHistogram* histogram,
+                       uint32_t thread_count, PowerLawFit* fit);
+
+#endif  // ANALYSIS_H_
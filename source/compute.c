@@ -1,2 +1,870 @@
 
 #include "compute.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "graphics.h"
+#include "mem.h"
+#include "pipeline.h"
+
+#define COMPUTE_MAX_SETS 16u
+#define COMPUTE_MAX_STORAGE_BUFFERS 64u
+#define COMPUTE_MAX_BINDINGS 8u
+#define COMPUTE_WORKGROUP_SIZE 256u
+
+/* largest group count every device supports in x */
+#define COMPUTE_MAX_GROUP_COUNT 65535u
+
+/* finest layout grid, 4^levels cells, aiming for a handful of nodes per
+ * cell */
+#define LAYOUT_MAX_LEVELS 10u
+#define LAYOUT_NODES_PER_CELL 4u
+
+/* generator passes recorded per submit before checking for pending slots */
+#define GENERATE_PASSES_PER_SUBMIT 8u
+#define GENERATE_MAX_PASSES 4096u
+
+extern VkDevice device;
+extern VkPhysicalDevice physical_device;
+extern uint32_t queue_family_index;
+extern VkQueue graphics_queue;
+extern uint32_t compute_queue_family_index;
+extern VkQueue compute_queue;
+extern bool shader_int64_enabled;
+
+/* compute work is submitted to the compute queue, which is the graphics
+ * queue unless the device has a compute family without graphics */
+static VkCommandPool compute_command_pool = VK_NULL_HANDLE;
+/* acquires by the graphics family of what the compute queue initialized,
+ * only with a compute family of its own */
+static VkCommandPool graphics_command_pool = VK_NULL_HANDLE;
+static VkDescriptorPool compute_descriptor_pool = VK_NULL_HANDLE;
+static VkFence compute_fence = VK_NULL_HANDLE;
+
+/* push constants of ba_generate.comp */
+typedef struct {
+  uint64_t seed;
+  uint32_t seed_edges;
+  uint32_t seed_nodes;
+  uint32_t new_edges;
+  uint32_t m;
+  uint32_t pass;
+  uint32_t padding;
+} GenerateParams;
+
+/* passes and push constants of layout.comp */
+enum {
+  LAYOUT_PASS_BOUNDS = 0,
+  LAYOUT_PASS_COUNT,
+  LAYOUT_PASS_SCAN,
+  LAYOUT_PASS_SCATTER,
+  LAYOUT_PASS_LEAF,
+  LAYOUT_PASS_REDUCE,
+  LAYOUT_PASS_FORCE,
+  LAYOUT_PASS_SPEED,
+  LAYOUT_PASS_MOVE,
+};
+
+typedef struct {
+  uint32_t node_count;
+  uint32_t pass;
+  uint32_t level;
+  uint32_t levels;
+  float scaling;
+  float gravity;
+  float tolerance;
+  uint32_t group_count;
+} LayoutParams;
+
+/* layout.comp's State buffer up to the per-group partials */
+typedef struct {
+  uint32_t bounds[4];
+  float view[4];
+  float speed;
+  float speed_efficiency;
+  uint32_t padding[2];
+} LayoutState;
+
+int CreateCompute(void) {
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+                    VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex = compute_queue_family_index;
+  if (VK_SUCCESS != vkCreateCommandPool(device, &pool_info, VK_NULL_HANDLE,
+                                        &compute_command_pool)) {
+    fprintf(stderr, "Failed to create compute command pool\n");
+    return -1;
+  }
+  pool_info.queueFamilyIndex = queue_family_index;
+  if (compute_queue_family_index != queue_family_index &&
+      VK_SUCCESS != vkCreateCommandPool(device, &pool_info, VK_NULL_HANDLE,
+                                        &graphics_command_pool)) {
+    fprintf(stderr, "Failed to create compute command pool\n");
+    return -1;
+  }
+
+  VkDescriptorPoolSize pool_size = {
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+      .descriptorCount = COMPUTE_MAX_STORAGE_BUFFERS};
+  VkDescriptorPoolCreateInfo descriptor_pool_info = {};
+  descriptor_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  descriptor_pool_info.flags =
+      VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+  descriptor_pool_info.maxSets = COMPUTE_MAX_SETS;
+  descriptor_pool_info.poolSizeCount = 1;
+  descriptor_pool_info.pPoolSizes = &pool_size;
+  if (VK_SUCCESS != vkCreateDescriptorPool(device, &descriptor_pool_info,
+                                           VK_NULL_HANDLE,
+                                           &compute_descriptor_pool)) {
+    fprintf(stderr, "Failed to create compute descriptor pool\n");
+    return -1;
+  }
+
+  VkFenceCreateInfo fence_info = {};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  if (VK_SUCCESS !=
+      vkCreateFence(device, &fence_info, VK_NULL_HANDLE, &compute_fence)) {
+    fprintf(stderr, "Failed to create compute fence\n");
+    return -1;
+  }
+
+  return 0;
+}
+
+void DestroyCompute(void) {
+  if (compute_fence != VK_NULL_HANDLE) {
+    vkDestroyFence(device, compute_fence, VK_NULL_HANDLE);
+    compute_fence = VK_NULL_HANDLE;
+  }
+  if (compute_descriptor_pool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(device, compute_descriptor_pool, VK_NULL_HANDLE);
+    compute_descriptor_pool = VK_NULL_HANDLE;
+  }
+  if (compute_command_pool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device, compute_command_pool, VK_NULL_HANDLE);
+    compute_command_pool = VK_NULL_HANDLE;
+  }
+  if (graphics_command_pool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device, graphics_command_pool, VK_NULL_HANDLE);
+    graphics_command_pool = VK_NULL_HANDLE;
+  }
+}
+
+int ComputeCreatePipeline(const char* shader_name,
+                          uint32_t storage_buffer_count,
+                          uint32_t push_constant_size,
+                          ComputePipeline* pipeline) {
+  memset(pipeline, 0, sizeof(ComputePipeline));
+  if (storage_buffer_count > COMPUTE_MAX_BINDINGS) {
+    return -1;
+  }
+
+  VkDescriptorSetLayoutBinding bindings[COMPUTE_MAX_BINDINGS] = {};
+  for (uint32_t i = 0; i < storage_buffer_count; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+  }
+
+  VkDescriptorSetLayoutCreateInfo set_layout_info = {};
+  set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  set_layout_info.bindingCount = storage_buffer_count;
+  set_layout_info.pBindings = bindings;
+  if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &set_layout_info,
+                                                VK_NULL_HANDLE,
+                                                &pipeline->set_layout)) {
+    fprintf(stderr, "Failed to create compute set layout\n");
+    return -1;
+  }
+
+  VkPushConstantRange push_range = {
+      .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+      .offset = 0,
+      .size = push_constant_size};
+  VkPipelineLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_info.setLayoutCount = 1;
+  layout_info.pSetLayouts = &pipeline->set_layout;
+  layout_info.pushConstantRangeCount = push_constant_size > 0 ? 1 : 0;
+  layout_info.pPushConstantRanges = &push_range;
+  if (VK_SUCCESS != vkCreatePipelineLayout(device, &layout_info,
+                                           VK_NULL_HANDLE, &pipeline->layout)) {
+    fprintf(stderr, "Failed to create compute pipeline layout\n");
+    ComputeDestroyPipeline(pipeline);
+    return -1;
+  }
+
+  pipeline->pipeline = PipelineCreateCompute(shader_name, pipeline->layout);
+  if (pipeline->pipeline == VK_NULL_HANDLE) {
+    ComputeDestroyPipeline(pipeline);
+    return -1;
+  }
+
+  return 0;
+}
+
+void ComputeDestroyPipeline(ComputePipeline* pipeline) {
+  if (pipeline->pipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, pipeline->pipeline, VK_NULL_HANDLE);
+  }
+  if (pipeline->layout != VK_NULL_HANDLE) {
+    vkDestroyPipelineLayout(device, pipeline->layout, VK_NULL_HANDLE);
+  }
+  if (pipeline->set_layout != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(device, pipeline->set_layout, VK_NULL_HANDLE);
+  }
+  memset(pipeline, 0, sizeof(ComputePipeline));
+}
+
+int ComputeCreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                        VkMemoryPropertyFlags property_flags,
+                        ComputeBuffer* buffer) {
+  memset(buffer, 0, sizeof(ComputeBuffer));
+  buffer->size = size;
+
+  VkBufferCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+  create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  create_info.size = size;
+  create_info.usage = usage;
+  if (VK_SUCCESS !=
+      vkCreateBuffer(device, &create_info, VK_NULL_HANDLE, &buffer->buffer)) {
+    fprintf(stderr, "failed to create compute buffer of %llu bytes\n",
+            (unsigned long long)size);
+    return -1;
+  }
+
+  if (0 != AllocateBufferMemory(buffer->buffer, property_flags,
+                                &buffer->memory)) {
+    fprintf(stderr, "failed to allocate compute buffer of %llu bytes\n",
+            (unsigned long long)size);
+    ComputeDestroyBuffer(buffer);
+    return -1;
+  }
+  return 0;
+}
+
+void ComputeDestroyBuffer(ComputeBuffer* buffer) {
+  if (buffer->buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, buffer->buffer, VK_NULL_HANDLE);
+  }
+  FreeMemory(&buffer->memory);
+  memset(buffer, 0, sizeof(ComputeBuffer));
+}
+
+int ComputeAllocateDescriptorSet(const ComputePipeline* pipeline,
+                                 const ComputeBuffer* buffers, uint32_t count,
+                                 VkDescriptorSet* set) {
+  if (count > COMPUTE_MAX_BINDINGS) {
+    return -1;
+  }
+
+  VkDescriptorSetAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  alloc_info.descriptorPool = compute_descriptor_pool;
+  alloc_info.descriptorSetCount = 1;
+  alloc_info.pSetLayouts = &pipeline->set_layout;
+  if (VK_SUCCESS != vkAllocateDescriptorSets(device, &alloc_info, set)) {
+    fprintf(stderr, "Failed to allocate compute descriptor set\n");
+    return -1;
+  }
+
+  VkDescriptorBufferInfo buffer_infos[COMPUTE_MAX_BINDINGS] = {};
+  VkWriteDescriptorSet writes[COMPUTE_MAX_BINDINGS] = {};
+  for (uint32_t i = 0; i < count; i++) {
+    buffer_infos[i].buffer = buffers[i].buffer;
+    buffer_infos[i].offset = 0;
+    buffer_infos[i].range = VK_WHOLE_SIZE;
+
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = *set;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = &buffer_infos[i];
+  }
+  vkUpdateDescriptorSets(device, count, writes, 0, NULL);
+
+  return 0;
+}
+
+static VkCommandBuffer BeginCommands(VkCommandPool pool) {
+  VkCommandBufferAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  alloc_info.commandPool = pool;
+  alloc_info.commandBufferCount = 1;
+
+  VkCommandBuffer cmd = VK_NULL_HANDLE;
+  if (VK_SUCCESS != vkAllocateCommandBuffers(device, &alloc_info, &cmd)) {
+    return VK_NULL_HANDLE;
+  }
+
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (VK_SUCCESS != vkBeginCommandBuffer(cmd, &begin_info)) {
+    vkFreeCommandBuffers(device, pool, 1, &cmd);
+    return VK_NULL_HANDLE;
+  }
+
+  return cmd;
+}
+
+static int SubmitAndWait(VkQueue queue, VkCommandPool pool,
+                         VkCommandBuffer cmd) {
+  vkEndCommandBuffer(cmd);
+
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cmd;
+
+  int result = 0;
+  vkResetFences(device, 1, &compute_fence);
+  if (VK_SUCCESS != vkQueueSubmit(queue, 1, &submit_info, compute_fence) ||
+      VK_SUCCESS !=
+          vkWaitForFences(device, 1, &compute_fence, VK_TRUE, UINT64_MAX)) {
+    fprintf(stderr, "compute submission failed\n");
+    result = -1;
+  }
+
+  vkFreeCommandBuffers(device, pool, 1, &cmd);
+  return result;
+}
+
+VkCommandBuffer ComputeBeginCommands(void) {
+  return BeginCommands(compute_command_pool);
+}
+
+int ComputeSubmitAndWait(VkCommandBuffer cmd) {
+  return SubmitAndWait(compute_queue, compute_command_pool, cmd);
+}
+
+/* move buffers used by the compute queue to the graphics family, which
+ * records the layout steps into the frame */
+static int HandOffToGraphics(const ComputeBuffer* buffers, uint32_t count) {
+  if (compute_queue_family_index == queue_family_index) {
+    return 0;
+  }
+  const VkPipelineStageFlags stages =
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+  const VkAccessFlags writes =
+      VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  VkCommandBuffer cmd = ComputeBeginCommands();
+  if (cmd == VK_NULL_HANDLE) {
+    return -1;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    VulkanReleaseBuffer(cmd, buffers[i].buffer, compute_queue_family_index,
+                        queue_family_index, stages, writes);
+  }
+  if (0 != ComputeSubmitAndWait(cmd)) {
+    return -1;
+  }
+  cmd = BeginCommands(graphics_command_pool);
+  if (cmd == VK_NULL_HANDLE) {
+    return -1;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    VulkanAcquireBuffer(cmd, buffers[i].buffer, compute_queue_family_index,
+                        queue_family_index, stages,
+                        VK_ACCESS_SHADER_READ_BIT | writes);
+  }
+  return SubmitAndWait(graphics_queue, graphics_command_pool, cmd);
+}
+
+void ComputeDispatch(VkCommandBuffer cmd, const ComputePipeline* pipeline,
+                     VkDescriptorSet set, const void* push_constants,
+                     uint32_t push_constant_size, uint32_t invocations) {
+  vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline->pipeline);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                          pipeline->layout, 0, 1, &set, 0, NULL);
+  if (push_constant_size > 0) {
+    vkCmdPushConstants(cmd, pipeline->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       push_constant_size, push_constants);
+  }
+  uint32_t group_count =
+      (invocations + COMPUTE_WORKGROUP_SIZE - 1) / COMPUTE_WORKGROUP_SIZE;
+  vkCmdDispatch(cmd, group_count, 1, 1);
+}
+
+void ComputeBarrier(VkCommandBuffer cmd) {
+  VkPipelineStageFlags stages =
+      VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask =
+      VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask =
+      VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT |
+      VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmd, stages, stages, 0, 1, &barrier, 0, NULL, 0, NULL);
+}
+
+static int CreateStagingBuffer(VkDeviceSize size, ComputeBuffer* staging,
+                               void** mapped) {
+  if (0 != ComputeCreateBuffer(size,
+                               VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               staging)) {
+    return -1;
+  }
+  *mapped = staging->memory.mapped;
+  return 0;
+}
+
+int ComputeUploadBuffer(const ComputeBuffer* buffer, VkDeviceSize offset,
+                        const void* data, VkDeviceSize size) {
+  ComputeBuffer staging;
+  void* mapped = NULL;
+  if (0 != CreateStagingBuffer(size, &staging, &mapped)) {
+    return -1;
+  }
+  memcpy(mapped, data, size);
+
+  VkCommandBuffer cmd = ComputeBeginCommands();
+  if (cmd == VK_NULL_HANDLE) {
+    ComputeDestroyBuffer(&staging);
+    return -1;
+  }
+  VkBufferCopy region = {.srcOffset = 0, .dstOffset = offset, .size = size};
+  vkCmdCopyBuffer(cmd, staging.buffer, buffer->buffer, 1, &region);
+  int result = ComputeSubmitAndWait(cmd);
+
+  ComputeDestroyBuffer(&staging);
+  return result;
+}
+
+int ComputeReadBuffer(const ComputeBuffer* buffer, VkDeviceSize offset,
+                      void* data, VkDeviceSize size) {
+  ComputeBuffer staging;
+  void* mapped = NULL;
+  if (0 != CreateStagingBuffer(size, &staging, &mapped)) {
+    return -1;
+  }
+
+  VkCommandBuffer cmd = ComputeBeginCommands();
+  if (cmd == VK_NULL_HANDLE) {
+    ComputeDestroyBuffer(&staging);
+    return -1;
+  }
+  VkBufferCopy region = {.srcOffset = offset, .dstOffset = 0, .size = size};
+  vkCmdCopyBuffer(cmd, buffer->buffer, staging.buffer, 1, &region);
+  int result = ComputeSubmitAndWait(cmd);
+
+  if (result == 0) {
+    memcpy(data, mapped, size);
+  }
+  ComputeDestroyBuffer(&staging);
+  return result;
+}
+
+/* the generator and layout passes loop over their items, so the group
+ * count can stay below the device limit for any graph */
+static uint32_t LoopInvocations(uint64_t items) {
+  const uint64_t max_invocations =
+      (uint64_t)COMPUTE_MAX_GROUP_COUNT * COMPUTE_WORKGROUP_SIZE;
+  if (items == 0) {
+    return 1;
+  }
+  return (uint32_t)(items < max_invocations ? items : max_invocations);
+}
+
+static int UploadSeedEdges(const Graph* seed_graph,
+                           const ComputeBuffer* endpoints) {
+  /* seed edges go first, in the same order the CPU modes use */
+  uint32_t* seed_pairs =
+      (uint32_t*)malloc(sizeof(uint32_t) * 2 * seed_graph->edge_count);
+  if (seed_pairs == NULL) {
+    return -1;
+  }
+  uint64_t pair_count = 0;
+  for (uint32_t i = 0; i < seed_graph->node_count; i++) {
+    uint32_t count = 0;
+    const uint32_t* neighbors = GraphNeighbors(seed_graph, i, &count);
+    for (uint32_t k = 0; k < count; k++) {
+      if (i < neighbors[k]) {
+        seed_pairs[pair_count++] = i;
+        seed_pairs[pair_count++] = neighbors[k];
+      }
+    }
+  }
+  int result = ComputeUploadBuffer(endpoints, 0, seed_pairs,
+                                   sizeof(uint32_t) * pair_count);
+  free(seed_pairs);
+  return result;
+}
+
+static int RunGeneratePasses(const ComputePipeline* pipeline,
+                             VkDescriptorSet set, const ComputeBuffer* status,
+                             GenerateParams params) {
+  void* status_mapped = status->memory.mapped;
+
+  /* pass 0 initializes the slots, every later pass resolves the slots whose
+   * drawn endpoint and earlier siblings are final and counts the rest */
+  int result = -1;
+  for (uint32_t pass = 0; pass < GENERATE_MAX_PASSES && result != 0;) {
+    VkCommandBuffer cmd = ComputeBeginCommands();
+    if (cmd == VK_NULL_HANDLE) {
+      fprintf(stderr, "ComputeGenerateEdges: failed to begin commands\n");
+      return -1;
+    }
+    for (uint32_t i = 0; i < GENERATE_PASSES_PER_SUBMIT; i++, pass++) {
+      vkCmdFillBuffer(cmd, status->buffer, 0, sizeof(uint32_t), 0);
+      ComputeBarrier(cmd);
+      params.pass = pass;
+      ComputeDispatch(cmd, pipeline, set, &params, sizeof(params),
+                      LoopInvocations(params.new_edges));
+      ComputeBarrier(cmd);
+    }
+    /* make the pending counter visible to the host */
+    VkMemoryBarrier host_barrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT};
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0,
+                         NULL, 0, NULL);
+    if (0 != ComputeSubmitAndWait(cmd)) {
+      break;
+    }
+    if (*(volatile uint32_t*)status_mapped == 0) {
+      result = 0;
+    }
+  }
+
+  if (result != 0) {
+    fprintf(stderr, "ComputeGenerateEdges: slots still pending after %u "
+                    "passes\n", GENERATE_MAX_PASSES);
+  }
+  return result;
+}
+
+int ComputeGenerateEdges(const Graph* seed_graph, uint32_t node_capacity,
+                         uint32_t m, uint64_t seed, ComputeBuffer* edges,
+                         uint64_t* edge_count) {
+  uint64_t seed_edges = seed_graph->edge_count;
+  uint64_t new_edges = (uint64_t)m * (node_capacity - seed_graph->node_count);
+  uint64_t total_edges = seed_edges + new_edges;
+  if (m == 0 || m > seed_graph->node_count || seed_edges == 0 ||
+      seed_graph->frozen || new_edges == 0) {
+    fprintf(stderr, "ComputeGenerateEdges: invalid seed graph\n");
+    return -1;
+  }
+  if (!shader_int64_enabled) {
+    fprintf(stderr, "ComputeGenerateEdges: the device has no 64-bit "
+                    "integers in shaders, which ba_generate.comp needs\n");
+    return -1;
+  }
+  /* slots are 32-bit on the GPU */
+  if (2 * total_edges >= UINT32_MAX) {
+    fprintf(stderr, "ComputeGenerateEdges: %llu edges do not fit\n",
+            (unsigned long long)total_edges);
+    return -1;
+  }
+
+  ComputePipeline pipeline;
+  if (0 != ComputeCreatePipeline("ba_generate.comp.spv", 3,
+                                 sizeof(GenerateParams), &pipeline)) {
+    return -1;
+  }
+
+  /* 0: endpoints, 1: per new edge (attempt, drawn slot), 2: pending count */
+  ComputeBuffer buffers[3] = {};
+  VkDescriptorSet set = VK_NULL_HANDLE;
+  int result = -1;
+
+  if (0 == ComputeCreateBuffer(sizeof(uint32_t) * 2 * total_edges,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               &buffers[0]) &&
+      0 == ComputeCreateBuffer(sizeof(uint32_t) * 2 * new_edges,
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               &buffers[1]) &&
+      0 == ComputeCreateBuffer(sizeof(uint32_t),
+                               VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                   VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                   VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                               &buffers[2]) &&
+      0 == ComputeAllocateDescriptorSet(&pipeline, buffers, 3, &set) &&
+      0 == UploadSeedEdges(seed_graph, &buffers[0])) {
+    GenerateParams params = {.seed = seed,
+                             .seed_edges = (uint32_t)seed_edges,
+                             .seed_nodes = seed_graph->node_count,
+                             .new_edges = (uint32_t)new_edges,
+                             .m = m,
+                             .pass = 0};
+    result = RunGeneratePasses(&pipeline, set, &buffers[2], params);
+  }
+
+  if (set != VK_NULL_HANDLE) {
+    vkFreeDescriptorSets(device, compute_descriptor_pool, 1, &set);
+  }
+  ComputeDestroyBuffer(&buffers[1]);
+  ComputeDestroyBuffer(&buffers[2]);
+  ComputeDestroyPipeline(&pipeline);
+
+  if (result == 0) {
+    *edges = buffers[0];
+    *edge_count = total_edges;
+  } else {
+    ComputeDestroyBuffer(&buffers[0]);
+  }
+  return result;
+}
+
+static uint32_t LayoutGroupCount(uint64_t items) {
+  return (LoopInvocations(items) + COMPUTE_WORKGROUP_SIZE - 1) /
+         COMPUTE_WORKGROUP_SIZE;
+}
+
+/* CSR offsets narrowed to 32 bits, followed by the neighbors */
+static int UploadLayoutTopology(const Graph* graph,
+                                const ComputeBuffer* topology) {
+  uint64_t node_count = graph->node_count;
+  uint64_t words = node_count + 1 + 2 * graph->edge_count;
+  uint32_t* data = (uint32_t*)malloc(sizeof(uint32_t) * words);
+  if (data == NULL) {
+    fprintf(stderr, "failed to allocate the layout topology\n");
+    return -1;
+  }
+  for (uint64_t i = 0; i <= node_count; i++) {
+    data[i] = (uint32_t)graph->offsets[i];
+  }
+  memcpy(data + node_count + 1, graph->neighbors,
+         sizeof(uint32_t) * 2 * graph->edge_count);
+  int result =
+      ComputeUploadBuffer(topology, 0, data, sizeof(uint32_t) * words);
+  free(data);
+  return result;
+}
+
+static int InitializeLayoutState(const ComputeLayout* layout) {
+  LayoutState state = {.speed = 1.f, .speed_efficiency = 1.f};
+  if (0 != ComputeUploadBuffer(&layout->state, 0, &state, sizeof(state))) {
+    return -1;
+  }
+  VkCommandBuffer cmd = ComputeBeginCommands();
+  if (cmd == VK_NULL_HANDLE) {
+    return -1;
+  }
+  vkCmdFillBuffer(cmd, layout->motion.buffer, 0, VK_WHOLE_SIZE, 0);
+  return ComputeSubmitAndWait(cmd);
+}
+
+int ComputeCreateLayout(const Graph* graph, VkBuffer positions,
+                        const LayoutOptions* options, ComputeLayout* layout) {
+  memset(layout, 0, sizeof(ComputeLayout));
+  uint64_t n = graph->node_count;
+  if (!graph->frozen || n < 2) {
+    fprintf(stderr, "ComputeCreateLayout: need a frozen graph\n");
+    return -1;
+  }
+
+  layout->node_count = (uint32_t)n;
+  layout->options = *options;
+  layout->levels = 1;
+  while (layout->levels < LAYOUT_MAX_LEVELS &&
+         (1ull << (2 * layout->levels)) * LAYOUT_NODES_PER_CELL < n) {
+    layout->levels++;
+  }
+  uint64_t cells = 1ull << (2 * layout->levels);
+  uint64_t pyramid_cells = ((cells << 2) - 1) / 3;
+
+  VkDeviceSize topology_size =
+      sizeof(uint32_t) * (n + 1 + 2 * graph->edge_count);
+  VkDeviceSize bins_size = sizeof(uint32_t) * (2 * cells + 2 * n);
+  VkDeviceSize pyramid_size = sizeof(float) * 4 * pyramid_cells;
+  VkDeviceSize motion_size = sizeof(float) * 4 * n;
+  VkDeviceSize state_size = sizeof(LayoutState) +
+                            sizeof(float) * 2 * LayoutGroupCount(n);
+
+  /* every buffer is indexed with 32-bit uints in the shader */
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  VkDeviceSize max_range = properties.limits.maxStorageBufferRange;
+  VkDeviceSize sizes[] = {topology_size, bins_size, pyramid_size,
+                          motion_size};
+  for (uint32_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    if (sizes[i] > max_range) {
+      fprintf(stderr, "ComputeCreateLayout: a %llu byte buffer exceeds "
+                      "the %llu byte storage buffer limit\n",
+              (unsigned long long)sizes[i], (unsigned long long)max_range);
+      return -1;
+    }
+  }
+
+  layout->positions.buffer = positions;
+  layout->positions.size = sizeof(float) * 2 * n;
+  const VkBufferUsageFlags usage =
+      VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  if (0 != ComputeCreateBuffer(motion_size, usage,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               &layout->motion) ||
+      0 != ComputeCreateBuffer(topology_size, usage,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               &layout->topology) ||
+      0 != ComputeCreateBuffer(bins_size, usage,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               &layout->bins) ||
+      0 != ComputeCreateBuffer(pyramid_size, usage,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               &layout->pyramid) ||
+      /* the graph renderer reads the view box as a vertex attribute */
+      0 != ComputeCreateBuffer(state_size,
+                               usage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               &layout->state) ||
+      0 != ComputeCreatePipeline("layout.comp.spv", 6, sizeof(LayoutParams),
+                                 &layout->pipeline)) {
+    ComputeDestroyLayout(layout);
+    return -1;
+  }
+
+  ComputeBuffer buffers[6] = {layout->positions, layout->motion,
+                              layout->topology,  layout->bins,
+                              layout->pyramid,   layout->state};
+  if (0 != ComputeAllocateDescriptorSet(&layout->pipeline, buffers, 6,
+                                        &layout->set) ||
+      0 != UploadLayoutTopology(graph, &layout->topology) ||
+      0 != InitializeLayoutState(layout) ||
+      0 != HandOffToGraphics(&buffers[1], 5)) {
+    ComputeDestroyLayout(layout);
+    return -1;
+  }
+  return 0;
+}
+
+void ComputeDestroyLayout(ComputeLayout* layout) {
+  if (layout->set != VK_NULL_HANDLE) {
+    vkFreeDescriptorSets(device, compute_descriptor_pool, 1, &layout->set);
+  }
+  ComputeDestroyPipeline(&layout->pipeline);
+  ComputeDestroyBuffer(&layout->motion);
+  ComputeDestroyBuffer(&layout->topology);
+  ComputeDestroyBuffer(&layout->bins);
+  ComputeDestroyBuffer(&layout->pyramid);
+  ComputeDestroyBuffer(&layout->state);
+  memset(layout, 0, sizeof(ComputeLayout));
+}
+
+static void RecordLayoutPass(VkCommandBuffer cmd,
+                             const ComputeLayout* layout,
+                             LayoutParams* params, uint32_t pass,
+                             uint64_t items) {
+  params->pass = pass;
+  ComputeDispatch(cmd, &layout->pipeline, layout->set, params,
+                  sizeof(LayoutParams), LoopInvocations(items));
+  ComputeBarrier(cmd);
+}
+
+void ComputeRecordLayout(VkCommandBuffer cmd, const ComputeLayout* layout) {
+  /* the previous frame's draws and any upload of the positions have
+   * to finish before they are rewritten */
+  VkMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+  barrier.srcAccessMask =
+      VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT |
+                          VK_ACCESS_SHADER_WRITE_BIT |
+                          VK_ACCESS_TRANSFER_WRITE_BIT;
+  vkCmdPipelineBarrier(cmd,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+                           VK_PIPELINE_STAGE_TRANSFER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT |
+                           VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       0, 1, &barrier, 0, NULL, 0, NULL);
+
+  /* empty cells, and bounds that any position replaces */
+  uint64_t cells = 1ull << (2 * layout->levels);
+  vkCmdFillBuffer(cmd, layout->bins.buffer, 0, sizeof(uint32_t) * cells, 0);
+  vkCmdFillBuffer(cmd, layout->state.buffer, 0, sizeof(uint32_t) * 2,
+                  0xffffffffu);
+  vkCmdFillBuffer(cmd, layout->state.buffer, sizeof(uint32_t) * 2,
+                  sizeof(uint32_t) * 2, 0);
+  ComputeBarrier(cmd);
+
+  uint32_t n = layout->node_count;
+  LayoutParams params = {.node_count = n,
+                         .levels = layout->levels,
+                         .scaling = layout->options.scaling,
+                         .gravity = layout->options.gravity,
+                         .tolerance = layout->options.tolerance,
+                         .group_count = LayoutGroupCount(n)};
+  RecordLayoutPass(cmd, layout, &params, LAYOUT_PASS_BOUNDS, n);
+  RecordLayoutPass(cmd, layout, &params, LAYOUT_PASS_COUNT, n);
+  /* a single workgroup */
+  RecordLayoutPass(cmd, layout, &params, LAYOUT_PASS_SCAN,
+                   COMPUTE_WORKGROUP_SIZE);
+  RecordLayoutPass(cmd, layout, &params, LAYOUT_PASS_SCATTER, n);
+  RecordLayoutPass(cmd, layout, &params, LAYOUT_PASS_LEAF, cells);
+  for (uint32_t level = layout->levels; level-- > 0;) {
+    params.level = level;
+    RecordLayoutPass(cmd, layout, &params, LAYOUT_PASS_REDUCE,
+                     1ull << (2 * level));
+  }
+  RecordLayoutPass(cmd, layout, &params, LAYOUT_PASS_FORCE, n);
+  RecordLayoutPass(cmd, layout, &params, LAYOUT_PASS_SPEED,
+                   COMPUTE_WORKGROUP_SIZE);
+  params.pass = LAYOUT_PASS_MOVE;
+  ComputeDispatch(cmd, &layout->pipeline, layout->set, &params,
+                  sizeof(LayoutParams), LoopInvocations(n));
+}
+
+int ComputeRunLayout(const ComputeLayout* layout, float* positions,
+                     uint32_t iterations) {
+  /* the layout's buffers belong to the graphics family */
+  VkCommandPool pool = graphics_command_pool != VK_NULL_HANDLE
+                           ? graphics_command_pool
+                           : compute_command_pool;
+  VkQueue queue = graphics_command_pool != VK_NULL_HANDLE ? graphics_queue
+                                                          : compute_queue;
+  VkDeviceSize size = layout->positions.size;
+  ComputeBuffer staging;
+  void* mapped = NULL;
+  if (0 != CreateStagingBuffer(size, &staging, &mapped)) {
+    return -1;
+  }
+  memcpy(mapped, positions, size);
+
+  VkCommandBuffer cmd = BeginCommands(pool);
+  if (cmd == VK_NULL_HANDLE) {
+    fprintf(stderr, "ComputeRunLayout: failed to begin commands\n");
+    ComputeDestroyBuffer(&staging);
+    return -1;
+  }
+  VkBufferCopy region = {.srcOffset = 0, .dstOffset = 0, .size = size};
+  vkCmdCopyBuffer(cmd, staging.buffer, layout->positions.buffer, 1, &region);
+  for (uint32_t i = 0; i < iterations; i++) {
+    ComputeRecordLayout(cmd, layout);
+    ComputeBarrier(cmd);
+  }
+  vkCmdCopyBuffer(cmd, layout->positions.buffer, staging.buffer, 1, &region);
+  VkMemoryBarrier host_barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_HOST_READ_BIT};
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0,
+                       NULL, 0, NULL);
+  int result = SubmitAndWait(queue, pool, cmd);
+
+  if (result == 0) {
+    memcpy(positions, mapped, size);
+  }
+  ComputeDestroyBuffer(&staging);
+  return result;
+}
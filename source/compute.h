@@ -1,4 +1,119 @@
 #ifndef COMPUTE_H_
 #define COMPUTE_H_
 
+#include <vulkan/vulkan.h>
+
+#include "graph.h"
+#include "layout.h"
+#include "mem.h"
+
+typedef struct {
+  VkDescriptorSetLayout set_layout;
+  VkPipelineLayout layout;
+  VkPipeline pipeline;
+} ComputePipeline;
+
+typedef struct {
+  VkBuffer buffer;
+  MemAllocation memory;
+  VkDeviceSize size;
+} ComputeBuffer;
+
+/* create the command pool, descriptor pool and fence used by compute work */
+int CreateCompute(void);
+
+void DestroyCompute(void);
+
+/* compute pipeline whose set 0 holds storage_buffer_count storage buffers at
+ * bindings 0..n-1, plus push_constant_size bytes of push constants */
+int ComputeCreatePipeline(const char* shader_name,
+                          uint32_t storage_buffer_count,
+                          uint32_t push_constant_size,
+                          ComputePipeline* pipeline);
+
+void ComputeDestroyPipeline(ComputePipeline* pipeline);
+
+int ComputeCreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                        VkMemoryPropertyFlags property_flags,
+                        ComputeBuffer* buffer);
+
+void ComputeDestroyBuffer(ComputeBuffer* buffer);
+
+/* allocate a set for the pipeline and point its bindings at the buffers */
+int ComputeAllocateDescriptorSet(const ComputePipeline* pipeline,
+                                 const ComputeBuffer* buffers, uint32_t count,
+                                 VkDescriptorSet* set);
+
+/* a primary command buffer in the recording state, VK_NULL_HANDLE on
+ * failure */
+VkCommandBuffer ComputeBeginCommands(void);
+
+/* submit to the compute queue and block until the work has finished */
+int ComputeSubmitAndWait(VkCommandBuffer cmd);
+
+void ComputeDispatch(VkCommandBuffer cmd, const ComputePipeline* pipeline,
+                     VkDescriptorSet set, const void* push_constants,
+                     uint32_t push_constant_size, uint32_t invocations);
+
+/* make shader and transfer writes visible to the following commands */
+void ComputeBarrier(VkCommandBuffer cmd);
+
+int ComputeUploadBuffer(const ComputeBuffer* buffer, VkDeviceSize offset,
+                        const void* data, VkDeviceSize size);
+int ComputeReadBuffer(const ComputeBuffer* buffer, VkDeviceSize offset,
+                      void* data, VkDeviceSize size);
+
+/* GPU preferential attachment, on devices with shaderInt64: grow the
+ * unfrozen seed graph to node_capacity nodes and write the edge list (pairs
+ * of endpoints, the same layout GraphFreezeEdges takes) into a device-local
+ * buffer. Uses the slot resolution of GENERATE_MODE_PARALLEL, so the edges
+ * are identical to the CPU parallel mode for the same seed. */
+int ComputeGenerateEdges(const Graph* seed_graph, uint32_t node_capacity,
+                         uint32_t m, uint64_t seed, ComputeBuffer* edges,
+                         uint64_t* edge_count);
+
+/* byte offset of the float bounding box (min x, min y, max x, max y) of the
+ * positions in the layout state buffer, updated by every step */
+#define COMPUTE_LAYOUT_VIEW_OFFSET 16u
+
+/* ForceAtlas2 layout on the GPU, see layout.comp. The positions live in a
+ * buffer owned by someone else (the graph renderer's node buffer) and are
+ * integrated in place. */
+typedef struct {
+  ComputePipeline pipeline;
+  VkDescriptorSet set;
+  /* borrowed, only the handle and size are set */
+  ComputeBuffer positions;
+  ComputeBuffer motion;
+  ComputeBuffer topology;
+  ComputeBuffer bins;
+  ComputeBuffer pyramid;
+  ComputeBuffer state;
+  uint32_t node_count;
+  /* the finest grid has 2^levels cells per side */
+  uint32_t levels;
+  LayoutOptions options;
+} ComputeLayout;
+
+/* upload the topology of a frozen graph and create the layout state for
+ * the node_count * 2 floats in positions, which must have storage buffer
+ * usage. theta and thread_count of the options are not used. The buffers
+ * are initialized on the compute queue and handed to the graphics queue
+ * family, which records the steps. */
+int ComputeCreateLayout(const Graph* graph, VkBuffer positions,
+                        const LayoutOptions* options, ComputeLayout* layout);
+
+void ComputeDestroyLayout(ComputeLayout* layout);
+
+/* record one layout step. The positions are read and written by compute
+ * shaders, the caller makes the writes visible to whoever reads them. */
+void ComputeRecordLayout(VkCommandBuffer cmd, const ComputeLayout* layout);
+
+/* upload positions, run iterations steps on the graphics queue and read
+ * the positions back into positions. Blocks until the GPU is done, for
+ * checking the shader against LayoutStep() rather than for frames. The
+ * positions buffer needs transfer source and destination usage. */
+int ComputeRunLayout(const ComputeLayout* layout, float* positions,
+                     uint32_t iterations);
+
 #endif  // COMPUTE_H_
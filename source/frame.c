@@ -0,0 +1,137 @@
+#include "frame.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "renderer.h"
+
+extern VkDevice device;
+extern uint32_t queue_family_index;
+extern uint32_t swapchain_current_frame;
+
+static uint32_t frames_in_flight = FRAME_DEFAULT_IN_FLIGHT;
+static FrameContext frames[FRAME_MAX_IN_FLIGHT];
+static uint32_t frame_count = 0;
+
+int FrameSetInFlight(uint32_t count) {
+  if (count < FRAME_MIN_IN_FLIGHT || count > FRAME_MAX_IN_FLIGHT) {
+    fprintf(stderr, "frames in flight must be between %u and %u\n",
+            FRAME_MIN_IN_FLIGHT, FRAME_MAX_IN_FLIGHT);
+    return -1;
+  }
+  frames_in_flight = count;
+  return 0;
+}
+
+uint32_t FrameInFlight(void) { return frames_in_flight; }
+
+static int CreateFrame(FrameContext* frame) {
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  /* reset as a whole when the frame is recycled */
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex = queue_family_index;
+  if (VK_SUCCESS != vkCreateCommandPool(device, &pool_info, VK_NULL_HANDLE,
+                                        &frame->command_pool)) {
+    return -1;
+  }
+
+  VkCommandBufferAllocateInfo allocate_info = {};
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandPool = frame->command_pool;
+  allocate_info.commandBufferCount = 1;
+  if (VK_SUCCESS !=
+      vkAllocateCommandBuffers(device, &allocate_info, &frame->cmd)) {
+    return -1;
+  }
+
+  VkSemaphoreCreateInfo semaphore_info = {};
+  semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+  VkFenceCreateInfo fence_info = {};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+  if (VK_SUCCESS != vkCreateSemaphore(device, &semaphore_info, VK_NULL_HANDLE,
+                                      &frame->image_available) ||
+      VK_SUCCESS != vkCreateFence(device, &fence_info, VK_NULL_HANDLE,
+                                  &frame->in_flight)) {
+    return -1;
+  }
+
+  frame->transient_buffer =
+      CreateBuffer(FRAME_TRANSIENT_BYTES,
+                   VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
+                       VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                       VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT |
+                       VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+  if (frame->transient_buffer == VK_NULL_HANDLE ||
+      0 != AllocateBufferMemory(frame->transient_buffer,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                &frame->transient_memory)) {
+    return -1;
+  }
+  frame->transient_used = 0;
+  return 0;
+}
+
+int CreateFrames(void) {
+  memset(frames, 0, sizeof(frames));
+  frame_count = frames_in_flight;
+  for (uint32_t i = 0; i < frame_count; i++) {
+    if (0 != CreateFrame(&frames[i])) {
+      fprintf(stderr, "Failed to create frame context %u\n", i);
+      DestroyFrames();
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void DestroyFrames(void) {
+  for (uint32_t i = 0; i < frame_count; i++) {
+    FrameContext* frame = &frames[i];
+    if (frame->transient_buffer != VK_NULL_HANDLE) {
+      vkDestroyBuffer(device, frame->transient_buffer, VK_NULL_HANDLE);
+    }
+    FreeMemory(&frame->transient_memory);
+    if (frame->in_flight != VK_NULL_HANDLE) {
+      vkDestroyFence(device, frame->in_flight, VK_NULL_HANDLE);
+    }
+    if (frame->image_available != VK_NULL_HANDLE) {
+      vkDestroySemaphore(device, frame->image_available, VK_NULL_HANDLE);
+    }
+    /* frees the command buffer as well */
+    if (frame->command_pool != VK_NULL_HANDLE) {
+      vkDestroyCommandPool(device, frame->command_pool, VK_NULL_HANDLE);
+    }
+  }
+  memset(frames, 0, sizeof(frames));
+  frame_count = 0;
+}
+
+FrameContext* FrameCurrent(void) { return &frames[FrameIndex()]; }
+
+uint32_t FrameIndex(void) { return swapchain_current_frame % frame_count; }
+
+void FrameWait(void) {
+  FrameContext* frame = FrameCurrent();
+  vkWaitForFences(device, 1, &frame->in_flight, VK_TRUE, UINT64_MAX);
+  vkResetCommandPool(device, frame->command_pool, 0);
+  frame->transient_used = 0;
+}
+
+void* FrameTransientAlloc(VkDeviceSize size, VkDeviceSize alignment,
+                          VkBuffer* buffer, VkDeviceSize* offset) {
+  FrameContext* frame = FrameCurrent();
+  VkDeviceSize start =
+      (frame->transient_used + alignment - 1) / alignment * alignment;
+  if (frame->transient_memory.mapped == NULL ||
+      start + size > FRAME_TRANSIENT_BYTES) {
+    return NULL;
+  }
+  frame->transient_used = start + size;
+  *buffer = frame->transient_buffer;
+  *offset = start;
+  return (uint8_t*)frame->transient_memory.mapped + start;
+}
@@ -0,0 +1,64 @@
+#ifndef FRAME_H_
+#define FRAME_H_
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "mem.h"
+
+/* frames the host may record ahead of the GPU, more of them overlap more
+ * work at the cost of latency */
+#define FRAME_MIN_IN_FLIGHT 1u
+#define FRAME_MAX_IN_FLIGHT 4u
+#define FRAME_DEFAULT_IN_FLIGHT 2u
+
+/* host-visible bytes per frame for data the GPU reads in place */
+#define FRAME_TRANSIENT_BYTES (64u << 10)
+
+/* what one frame in flight records and submits with. Everything in it is
+ * recycled once the fence of its previous submission has signaled. Copies
+ * the frame records go through the staging ring, which frees them with
+ * the same fence */
+typedef struct {
+  VkCommandPool command_pool;
+  VkCommandBuffer cmd;
+  /* signaled by the frame's submission */
+  VkFence in_flight;
+  /* signaled once the acquired swapchain image can be rendered to */
+  VkSemaphore image_available;
+  /* bump allocated, persistently mapped */
+  VkBuffer transient_buffer;
+  MemAllocation transient_memory;
+  VkDeviceSize transient_used;
+} FrameContext;
+
+/* the number of contexts CreateFrames() makes, -1 outside
+ * FRAME_MIN_IN_FLIGHT..FRAME_MAX_IN_FLIGHT. Call before the swapchain or
+ * the offscreen images are created */
+int FrameSetInFlight(uint32_t count);
+
+uint32_t FrameInFlight(void);
+
+int CreateFrames(void);
+
+/* the contexts must be idle */
+void DestroyFrames(void);
+
+/* the context of swapchain_current_frame */
+FrameContext* FrameCurrent(void);
+
+/* the index of FrameCurrent(), for state kept per context elsewhere */
+uint32_t FrameIndex(void);
+
+/* block until the current context's previous submission has finished and
+ * recycle it. The fence is left signaled, it is reset right before the
+ * context is submitted again */
+void FrameWait(void);
+
+/* size bytes of the current frame's transient buffer at a multiple of
+ * alignment, valid until the context is recycled. NULL when the frame has
+ * used up FRAME_TRANSIENT_BYTES */
+void* FrameTransientAlloc(VkDeviceSize size, VkDeviceSize alignment,
+                          VkBuffer* buffer, VkDeviceSize* offset);
+
+#endif  // FRAME_H_
@@ -0,0 +1,626 @@
+
+#include "graph.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "graph_file.h"
+#include "rng.h"
+#include "trace.h"
+
+#define GRAPH_ROW_INITIAL_CAPACITY 4u
+
+/* nodes handed to a worker at a time in the parallel mode, small enough that
+ * all workers stay close to the same frontier and mostly hit resolved slots */
+#define GENERATE_CHUNK_NODES 1024u
+#define GENERATE_UNRESOLVED UINT32_MAX
+
+int GraphCreate(Graph* graph, uint32_t node_capacity) {
+  memset(graph, 0, sizeof(Graph));
+  graph->node_capacity = node_capacity;
+
+  graph->degree = (uint32_t*)calloc(node_capacity, sizeof(uint32_t));
+  graph->rows = (GraphRow*)calloc(node_capacity, sizeof(GraphRow));
+  if (graph->degree == NULL || graph->rows == NULL) {
+    fprintf(stderr, "failed to allocate graph for %u nodes\n", node_capacity);
+    GraphDestroy(graph);
+    return -1;
+  }
+
+  return 0;
+}
+
+int64_t GraphAddNode(Graph* graph) {
+  if (graph->frozen || graph->node_count == graph->node_capacity) {
+    return -1;
+  }
+  return graph->node_count++;
+}
+
+static int GraphRowPush(GraphRow* row, uint32_t value) {
+  if (row->count == row->capacity) {
+    uint32_t capacity = row->capacity == 0 ? GRAPH_ROW_INITIAL_CAPACITY
+                                           : row->capacity * 2u;
+    uint32_t* neighbors =
+        (uint32_t*)realloc(row->neighbors, sizeof(uint32_t) * capacity);
+    if (neighbors == NULL) {
+      return -1;
+    }
+    row->neighbors = neighbors;
+    row->capacity = capacity;
+  }
+  row->neighbors[row->count++] = value;
+  return 0;
+}
+
+int GraphAddEdge(Graph* graph, uint32_t i, uint32_t j) {
+  if (graph->frozen || i >= graph->node_count || j >= graph->node_count) {
+    return -1;
+  }
+  if (0 != GraphRowPush(&graph->rows[i], j) ||
+      0 != GraphRowPush(&graph->rows[j], i)) {
+    fprintf(stderr, "failed to grow adjacency of edge (%u, %u)\n", i, j);
+    return -1;
+  }
+
+  graph->degree[i]++;
+  graph->degree[j]++;
+  graph->total_degree += 2;
+  graph->edge_count++;
+  return 0;
+}
+
+const uint32_t* GraphNeighbors(const Graph* graph, uint32_t i,
+                               uint32_t* count) {
+  if (graph->frozen) {
+    *count = (uint32_t)(graph->offsets[i + 1] - graph->offsets[i]);
+    return graph->neighbors + graph->offsets[i];
+  }
+  *count = graph->rows[i].count;
+  return graph->rows[i].neighbors;
+}
+
+bool GraphHasEdge(const Graph* graph, uint32_t i, uint32_t j) {
+  /* scan the shorter of the two rows */
+  if (graph->degree[j] < graph->degree[i]) {
+    uint32_t t = i;
+    i = j;
+    j = t;
+  }
+  uint32_t count = 0;
+  const uint32_t* neighbors = GraphNeighbors(graph, i, &count);
+  for (uint32_t k = 0; k < count; k++) {
+    if (neighbors[k] == j) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void GraphFreeRows(Graph* graph) {
+  if (graph->rows != NULL) {
+    for (uint32_t i = 0; i < graph->node_count; i++) {
+      free(graph->rows[i].neighbors);
+    }
+    free(graph->rows);
+    graph->rows = NULL;
+  }
+}
+
+int GraphFreeze(Graph* graph) {
+  if (graph->frozen) {
+    return 0;
+  }
+
+  graph->offsets =
+      (uint64_t*)malloc(sizeof(uint64_t) * ((size_t)graph->node_count + 1));
+  graph->neighbors =
+      (uint32_t*)malloc(sizeof(uint32_t) * (graph->total_degree + 1));
+  if (graph->offsets == NULL || graph->neighbors == NULL) {
+    fprintf(stderr, "failed to allocate CSR arrays for %llu edges\n",
+            (unsigned long long)graph->edge_count);
+    free(graph->offsets);
+    free(graph->neighbors);
+    graph->offsets = NULL;
+    graph->neighbors = NULL;
+    return -1;
+  }
+
+  uint64_t offset = 0;
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    GraphRow* row = &graph->rows[i];
+    graph->offsets[i] = offset;
+    memcpy(graph->neighbors + offset, row->neighbors,
+           sizeof(uint32_t) * row->count);
+    offset += row->count;
+  }
+  graph->offsets[graph->node_count] = offset;
+
+  GraphFreeRows(graph);
+  graph->frozen = true;
+
+  return 0;
+}
+
+int GraphFreezeEdges(Graph* graph, const uint32_t* edges, uint64_t edge_count) {
+  uint64_t* offsets =
+      (uint64_t*)malloc(sizeof(uint64_t) * ((size_t)graph->node_count + 1));
+  uint32_t* neighbors =
+      (uint32_t*)malloc(sizeof(uint32_t) * (2 * edge_count + 1));
+  if (offsets == NULL || neighbors == NULL) {
+    fprintf(stderr, "failed to allocate CSR arrays for %llu edges\n",
+            (unsigned long long)edge_count);
+    free(offsets);
+    free(neighbors);
+    return -1;
+  }
+
+  memset(graph->degree, 0, sizeof(uint32_t) * graph->node_count);
+  for (uint64_t e = 0; e < 2 * edge_count; e++) {
+    graph->degree[edges[e]]++;
+  }
+
+  /* offsets double as the scatter cursors and are shifted back afterwards */
+  uint64_t offset = 0;
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    offsets[i] = offset;
+    offset += graph->degree[i];
+  }
+  offsets[graph->node_count] = offset;
+
+  for (uint64_t e = 0; e < edge_count; e++) {
+    uint32_t u = edges[2 * e];
+    uint32_t v = edges[2 * e + 1];
+    neighbors[offsets[u]++] = v;
+    neighbors[offsets[v]++] = u;
+  }
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    offsets[i] -= graph->degree[i];
+  }
+
+  GraphFreeRows(graph);
+  free(graph->offsets);
+  free(graph->neighbors);
+  graph->offsets = offsets;
+  graph->neighbors = neighbors;
+  graph->edge_count = edge_count;
+  graph->total_degree = 2 * edge_count;
+  graph->frozen = true;
+
+  return 0;
+}
+
+void GraphDestroy(Graph* graph) {
+  if (graph->mapping != NULL) {
+    /* the arrays belong to the file mapping */
+    munmap(graph->mapping, graph->mapping_size);
+  } else {
+    GraphFreeRows(graph);
+    free(graph->degree);
+    free(graph->offsets);
+    free(graph->neighbors);
+  }
+  memset(graph, 0, sizeof(Graph));
+}
+
+int init(Graph* graph, uint32_t n, uint32_t m0) {
+  if (m0 > n || 0 != GraphCreate(graph, n)) {
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < m0; i++) {
+    GraphAddNode(graph);
+  }
+  for (uint32_t i = 0; i < m0; i++) {
+    for (uint32_t j = i + 1; j < m0; j++) {
+      if (0 != add_node(graph, i, j)) {
+        return -1;
+      }
+    }
+  }
+
+  return 0;
+}
+
+int add_node(Graph* graph, uint32_t i, uint32_t j) {
+  return GraphAddEdge(graph, i, j);
+}
+
+/* hand the seed edges to the writer in the order every mode emits them */
+static int GenerateWriteSeedEdges(const Graph* graph, GraphWriter* writer) {
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    uint32_t count = 0;
+    const uint32_t* neighbors = GraphNeighbors(graph, i, &count);
+    for (uint32_t k = 0; k < count; k++) {
+      uint32_t pair[2] = {i, neighbors[k]};
+      if (i < neighbors[k] && 0 != GraphWriterAddEdges(writer, pair, 1)) {
+        return -1;
+      }
+    }
+  }
+  return 0;
+}
+
+static int GenerateLinearScan(Graph* graph, uint32_t m, uint64_t seed,
+                              GraphWriter* writer) {
+  Rng rng;
+  RngSeed(&rng, seed);
+  if (writer != NULL && 0 != GenerateWriteSeedEdges(graph, writer)) {
+    return -1;
+  }
+
+  while (graph->node_count < graph->node_capacity) {
+    uint32_t i = (uint32_t)GraphAddNode(graph);
+    uint32_t edges_added = 0;
+    while (edges_added < m) {
+      double p = RngUniformDouble(&rng);
+      double cumulative = 0.0;
+      for (uint32_t j = 0; j < i; j++) {
+        cumulative += (double)graph->degree[j] / graph->total_degree;
+        if (p < cumulative) {
+          if (!GraphHasEdge(graph, j, i)) {
+            if (0 != add_node(graph, j, i)) {
+              return -1;
+            }
+            uint32_t pair[2] = {j, i};
+            if (writer != NULL && 0 != GraphWriterAddEdges(writer, pair, 1)) {
+              return -1;
+            }
+            edges_added++;
+            break;
+          }
+        }
+      }
+    }
+  }
+
+  return GraphFreeze(graph);
+}
+
+/* pass the endpoint pairs added since the last flush on to the writer */
+static int GenerateFlushEdges(GraphWriter* writer, const uint32_t* endpoints,
+                              uint64_t endpoint_count, uint64_t* flushed) {
+  if (writer == NULL || *flushed == endpoint_count) {
+    return 0;
+  }
+  int result = GraphWriterAddEdges(writer, endpoints + *flushed,
+                                   (endpoint_count - *flushed) / 2);
+  *flushed = endpoint_count;
+  return result;
+}
+
+int GenerateBegin(GraphGrowth* growth, Graph* graph,
+                  const GenerateOptions* options) {
+  memset(growth, 0, sizeof(GraphGrowth));
+  if (options->m == 0 || options->m > graph->node_count || graph->frozen ||
+      graph->edge_count == 0) {
+    fprintf(stderr, "GenerateBegin: invalid seed graph\n");
+    return -1;
+  }
+  growth->graph = graph;
+  growth->m = options->m;
+  growth->writer = options->writer;
+
+  /* the endpoint array is the edge list: every edge contributes both of its
+   * endpoints, so node j appears degree[j] times and a uniform slot is a
+   * degree-proportional draw */
+  uint64_t remaining = graph->node_capacity - graph->node_count;
+  uint64_t edge_capacity = graph->edge_count + (uint64_t)growth->m * remaining;
+  growth->endpoints =
+      (uint32_t*)malloc(sizeof(uint32_t) * (2 * edge_capacity + 1));
+  growth->targets = (uint32_t*)malloc(sizeof(uint32_t) * growth->m);
+  if (growth->endpoints == NULL || growth->targets == NULL) {
+    fprintf(stderr, "failed to allocate %llu endpoints\n",
+            (unsigned long long)(2 * edge_capacity));
+    free(growth->endpoints);
+    free(growth->targets);
+    memset(growth, 0, sizeof(GraphGrowth));
+    return -1;
+  }
+
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    uint32_t count = 0;
+    const uint32_t* neighbors = GraphNeighbors(graph, i, &count);
+    for (uint32_t k = 0; k < count; k++) {
+      if (i < neighbors[k]) {
+        growth->endpoints[growth->endpoint_count++] = i;
+        growth->endpoints[growth->endpoint_count++] = neighbors[k];
+      }
+    }
+  }
+
+  RngBatchSeed(&growth->rng, options->seed, 0);
+  growth->draw_cursor = GENERATE_DRAW_BATCH;
+  return 0;
+}
+
+int64_t GenerateStep(GraphGrowth* growth, uint32_t node_count) {
+  Graph* graph = growth->graph;
+  uint32_t m = growth->m;
+  uint32_t* endpoints = growth->endpoints;
+  uint32_t* targets = growth->targets;
+  uint32_t added = 0;
+
+  while (added < node_count && graph->node_count < graph->node_capacity) {
+    uint32_t i = (uint32_t)GraphAddNode(graph);
+    /* draw from the endpoints that existed before node i was added */
+    uint64_t draw_count = growth->endpoint_count;
+    uint32_t edges_added = 0;
+    while (edges_added < m) {
+      if (growth->draw_cursor == GENERATE_DRAW_BATCH) {
+        RngBatchFill(&growth->rng, growth->draws, GENERATE_DRAW_BATCH);
+        growth->draw_cursor = 0;
+      }
+      uint64_t draw = growth->draws[growth->draw_cursor++];
+      uint32_t j = endpoints[RngBounded(draw, draw_count)];
+      /* node i only has the edges picked in this round, so the duplicate
+       * check is a scan over at most m targets */
+      bool duplicate = false;
+      for (uint32_t k = 0; k < edges_added; k++) {
+        if (targets[k] == j) {
+          duplicate = true;
+          break;
+        }
+      }
+      if (!duplicate) {
+        targets[edges_added++] = j;
+      }
+    }
+
+    for (uint32_t k = 0; k < m; k++) {
+      endpoints[growth->endpoint_count++] = targets[k];
+      endpoints[growth->endpoint_count++] = i;
+    }
+    added++;
+    if (graph->node_count % GENERATE_CHUNK_NODES == 0 &&
+        0 != GenerateFlushEdges(growth->writer, endpoints,
+                                growth->endpoint_count, &growth->flushed)) {
+      return -1;
+    }
+  }
+
+  return added;
+}
+
+int GenerateEnd(GraphGrowth* growth) {
+  if (growth->graph == NULL) {
+    return -1;
+  }
+  int result = GenerateFlushEdges(growth->writer, growth->endpoints,
+                                  growth->endpoint_count, &growth->flushed);
+  /* the rows never saw the new edges, build the CSR from the pairs instead */
+  if (result == 0) {
+    result = GraphFreezeEdges(growth->graph, growth->endpoints,
+                              growth->endpoint_count / 2);
+  }
+
+  free(growth->endpoints);
+  free(growth->targets);
+  memset(growth, 0, sizeof(GraphGrowth));
+  return result;
+}
+
+static int GenerateRepeatedEndpoints(Graph* graph,
+                                     const GenerateOptions* options) {
+  GraphGrowth growth;
+  if (0 != GenerateBegin(&growth, graph, options)) {
+    return -1;
+  }
+  if (0 > GenerateStep(&growth, graph->node_capacity - graph->node_count)) {
+    GenerateEnd(&growth);
+    return -1;
+  }
+  return GenerateEnd(&growth);
+}
+
+/* Sanders–Schulz style parallel BA: edge e of the new node u is stored as
+ * the pair (u, target) at slots 2e and 2e + 1. A target draws a uniform slot
+ * among the endpoints that existed before u, even slots are known source
+ * nodes and odd slots are resolved recursively, so every slot only depends
+ * on the seed and on lower slots. Resolved targets are memoized in place. */
+typedef struct {
+  uint32_t* endpoints;
+  uint64_t seed_edges;
+  uint32_t seed_nodes;
+  uint32_t node_capacity;
+  uint32_t m;
+  uint64_t seed;
+  uint32_t next_chunk;
+} ParallelGenerator;
+
+static uint64_t SlotDraw(const ParallelGenerator* gen, uint64_t slot,
+                         uint32_t attempt, uint64_t count) {
+  uint64_t key = gen->seed + attempt * 0xd1b54a32d192ed03ull;
+  return RngBounded(RngCounter(key, slot), count);
+}
+
+static uint32_t ResolveTarget(const ParallelGenerator* gen, uint64_t slot);
+
+static uint32_t EndpointAt(const ParallelGenerator* gen, uint64_t slot) {
+  if (slot < 2 * gen->seed_edges) {
+    return gen->endpoints[slot];
+  }
+  if ((slot & 1) == 0) {
+    return gen->seed_nodes + (uint32_t)((slot / 2 - gen->seed_edges) / gen->m);
+  }
+  uint32_t value = __atomic_load_n(&gen->endpoints[slot], __ATOMIC_RELAXED);
+  if (value != GENERATE_UNRESOLVED) {
+    return value;
+  }
+  return ResolveTarget(gen, slot);
+}
+
+static uint32_t ResolveTarget(const ParallelGenerator* gen, uint64_t slot) {
+  uint64_t local = slot / 2 - gen->seed_edges;
+  uint64_t first_edge = slot / 2 - local % gen->m;
+  uint64_t draw_count = 2 * first_edge;
+
+  /* redraw until the target differs from the node's earlier targets, the
+   * attempt counter keeps the redraws deterministic as well */
+  uint32_t target = 0;
+  for (uint32_t attempt = 0;; attempt++) {
+    target = EndpointAt(gen, SlotDraw(gen, slot, attempt, draw_count));
+    bool duplicate = false;
+    for (uint64_t e = first_edge; e < slot / 2; e++) {
+      if (EndpointAt(gen, 2 * e + 1) == target) {
+        duplicate = true;
+        break;
+      }
+    }
+    if (!duplicate) {
+      break;
+    }
+  }
+
+  __atomic_store_n(&gen->endpoints[slot], target, __ATOMIC_RELAXED);
+  return target;
+}
+
+static void* ParallelGenerateWorker(void* arg) {
+  ParallelGenerator* gen = (ParallelGenerator*)arg;
+  uint32_t new_nodes = gen->node_capacity - gen->seed_nodes;
+
+  TRACE_BEGIN("generate_worker");
+  for (;;) {
+    uint32_t chunk =
+        __atomic_fetch_add(&gen->next_chunk, 1u, __ATOMIC_RELAXED);
+    uint64_t begin = (uint64_t)chunk * GENERATE_CHUNK_NODES;
+    if (begin >= new_nodes) {
+      break;
+    }
+    uint64_t end = begin + GENERATE_CHUNK_NODES;
+    if (end > new_nodes) {
+      end = new_nodes;
+    }
+
+    for (uint64_t local = begin * gen->m; local < end * gen->m; local++) {
+      uint64_t slot = 2 * (gen->seed_edges + local);
+      gen->endpoints[slot] = gen->seed_nodes + (uint32_t)(local / gen->m);
+      if (__atomic_load_n(&gen->endpoints[slot + 1], __ATOMIC_RELAXED) ==
+          GENERATE_UNRESOLVED) {
+        ResolveTarget(gen, slot + 1);
+      }
+    }
+  }
+  TRACE_END("generate_worker");
+
+  return NULL;
+}
+
+static int GenerateParallel(Graph* graph, uint32_t m, uint64_t seed,
+                            uint32_t thread_count, GraphWriter* writer) {
+  uint64_t remaining = graph->node_capacity - graph->node_count;
+  uint64_t edge_capacity = graph->edge_count + (uint64_t)m * remaining;
+
+  ParallelGenerator gen = {};
+  gen.seed_edges = graph->edge_count;
+  gen.seed_nodes = graph->node_count;
+  gen.node_capacity = graph->node_capacity;
+  gen.m = m;
+  gen.seed = seed;
+  gen.endpoints = (uint32_t*)malloc(sizeof(uint32_t) * (2 * edge_capacity + 1));
+  if (gen.endpoints == NULL) {
+    fprintf(stderr, "failed to allocate %llu endpoints\n",
+            (unsigned long long)(2 * edge_capacity));
+    return -1;
+  }
+
+  uint64_t endpoint_count = 0;
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    uint32_t count = 0;
+    const uint32_t* neighbors = GraphNeighbors(graph, i, &count);
+    for (uint32_t k = 0; k < count; k++) {
+      if (i < neighbors[k]) {
+        gen.endpoints[endpoint_count++] = i;
+        gen.endpoints[endpoint_count++] = neighbors[k];
+      }
+    }
+  }
+  memset(gen.endpoints + endpoint_count, 0xff,
+         sizeof(uint32_t) * (2 * edge_capacity - endpoint_count));
+
+  if (thread_count == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = online > 0 ? (uint32_t)online : 1u;
+  }
+
+  /* the calling thread is one of the workers */
+  pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * thread_count);
+  uint32_t started = 0;
+  if (threads != NULL) {
+    for (; started + 1 < thread_count; started++) {
+      if (0 != pthread_create(&threads[started], NULL, ParallelGenerateWorker,
+                              &gen)) {
+        break;
+      }
+    }
+  }
+  /* a failed thread creation only costs speed, the result does not depend
+   * on who resolves a slot */
+  ParallelGenerateWorker(&gen);
+  for (uint32_t i = 0; i < started; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+
+  graph->node_count = graph->node_capacity;
+  /* slots finish out of order, so the writer gets the edges once all of
+   * them are resolved */
+  int result = 0;
+  if (writer != NULL) {
+    result = GraphWriterAddEdges(writer, gen.endpoints, edge_capacity);
+  }
+  if (result == 0) {
+    result = GraphFreezeEdges(graph, gen.endpoints, edge_capacity);
+  }
+
+  free(gen.endpoints);
+  return result;
+}
+
+int generate(Graph* graph, const GenerateOptions* options) {
+  uint32_t m = options->m;
+  if (m == 0 || m > graph->node_count) {
+    fprintf(stderr, "generate: need at least m=%u seed nodes, have %u\n", m,
+            graph->node_count);
+    return -1;
+  }
+  if (graph->frozen) {
+    fprintf(stderr, "generate: the graph is already frozen\n");
+    return -1;
+  }
+  /* with no endpoints to draw from, every sampler would index an empty
+   * array, which is what a seed of m0 < 2 gives */
+  if (graph->edge_count == 0) {
+    fprintf(stderr, "generate: the seed graph needs at least one edge\n");
+    return -1;
+  }
+
+  switch (options->mode) {
+    case GENERATE_MODE_LINEAR_SCAN:
+      return GenerateLinearScan(graph, m, options->seed, options->writer);
+    case GENERATE_MODE_REPEATED_ENDPOINTS:
+      return GenerateRepeatedEndpoints(graph, options);
+    case GENERATE_MODE_PARALLEL:
+      return GenerateParallel(graph, m, options->seed, options->thread_count,
+                              options->writer);
+  }
+
+  return -1;
+}
+
+void print_graph(const Graph* graph) {
+  for (uint32_t i = 0; i < graph->node_count; i++) {
+    uint32_t count = 0;
+    const uint32_t* neighbors = GraphNeighbors(graph, i, &count);
+    printf("%u:", i);
+    for (uint32_t k = 0; k < count; k++) {
+      printf(" %u", neighbors[k]);
+    }
+    printf("\n");
+  }
+}
@@ -0,0 +1,143 @@
+#ifndef GRAPH_H_
+#define GRAPH_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "rng.h"
+
+/* growable adjacency row, used while the graph is still being generated */
+typedef struct {
+  uint32_t* neighbors;
+  uint32_t count;
+  uint32_t capacity;
+} GraphRow;
+
+/* undirected graph store: per-node growable rows during generation, frozen
+ * into a CSR layout (offsets + neighbors) once generation is finished */
+typedef struct {
+  uint32_t node_count;
+  uint32_t node_capacity;
+  uint64_t edge_count;
+  uint64_t total_degree;
+
+  /* degree of every node, valid in both layouts */
+  uint32_t* degree;
+
+  /* generation layout */
+  GraphRow* rows;
+
+  /* CSR layout, valid once GraphFreeze() has been called */
+  bool frozen;
+  uint64_t* offsets;
+  uint32_t* neighbors;
+
+  /* set when the arrays point into a file mapped by GraphMapFile(), the
+   * graph is read-only then */
+  void* mapping;
+  uint64_t mapping_size;
+} Graph;
+
+/* allocate an empty graph that can hold up to node_capacity nodes */
+int GraphCreate(Graph* graph, uint32_t node_capacity);
+
+/* append a node without edges, returns its index or -1 when full */
+int64_t GraphAddNode(Graph* graph);
+
+/* add the undirected edge (i, j), does not check for duplicates */
+int GraphAddEdge(Graph* graph, uint32_t i, uint32_t j);
+
+bool GraphHasEdge(const Graph* graph, uint32_t i, uint32_t j);
+
+/* neighbors of node i in either layout */
+const uint32_t* GraphNeighbors(const Graph* graph, uint32_t i,
+                               uint32_t* count);
+
+/* pack the rows into the CSR arrays and release the rows */
+int GraphFreeze(Graph* graph);
+
+/* replace the topology with the edge list (pairs of endpoints) and build the
+ * CSR arrays directly from it, node_count must already cover all endpoints */
+int GraphFreezeEdges(Graph* graph, const uint32_t* edges,
+                     uint64_t edge_count);
+
+void GraphDestroy(Graph* graph);
+
+/* Barabási–Albert model */
+
+/* graph_file.h */
+typedef struct GraphWriter GraphWriter;
+
+typedef enum {
+  /* Batagelj–Brandes: sample a uniform slot of the repeated-endpoint array,
+   * O(1) expected per edge */
+  GENERATE_MODE_REPEATED_ENDPOINTS = 0,
+  /* reference mode: cumulative-probability scan over all earlier nodes,
+   * O(N) per edge, kept for validating the fast sampler */
+  GENERATE_MODE_LINEAR_SCAN,
+  /* copy-model resolution of the endpoint array on all cores, every slot is
+   * a pure function of (seed, slot) so the graph does not depend on the
+   * thread count */
+  GENERATE_MODE_PARALLEL,
+} GenerateMode;
+
+typedef struct {
+  /* edges attached to every new node */
+  uint32_t m;
+  GenerateMode mode;
+  /* seed of the rng streams, the same seed reproduces the same graph */
+  uint64_t seed;
+  /* worker threads of the parallel mode, 0 uses every online core */
+  uint32_t thread_count;
+  /* optional, receives the edges while they are generated */
+  GraphWriter* writer;
+} GenerateOptions;
+
+/* create the graph and connect the m0 seed nodes as a clique */
+int init(Graph* graph, uint32_t n, uint32_t m0);
+
+/* connect node i and node j */
+int add_node(Graph* graph, uint32_t i, uint32_t j);
+
+/* grow the graph to its capacity, attaching every new node with m edges,
+ * the graph is frozen afterwards. The seed needs at least one edge (m0 of
+ * init() at least 2), the samplers draw from the existing endpoints */
+int generate(Graph* graph, const GenerateOptions* options);
+
+/* raw draws fetched per batch by the repeated-endpoint sampler */
+#define GENERATE_DRAW_BATCH 1024u
+
+/* Incremental generation with the repeated-endpoint sampler, for growing
+ * the graph a few nodes at a time (e.g. per frame). The endpoint pairs are
+ * the edge list in insertion order and are only ever appended to. Gives the
+ * same graph as generate() in GENERATE_MODE_REPEATED_ENDPOINTS. */
+typedef struct {
+  Graph* graph;
+  uint32_t m;
+  GraphWriter* writer;
+
+  uint32_t* endpoints;
+  uint64_t endpoint_count;
+
+  /* targets of the node being added */
+  uint32_t* targets;
+
+  RngBatch rng;
+  uint64_t draws[GENERATE_DRAW_BATCH];
+  uint32_t draw_cursor;
+  /* endpoints already handed to the writer */
+  uint64_t flushed;
+} GraphGrowth;
+
+int GenerateBegin(GraphGrowth* growth, Graph* graph,
+                  const GenerateOptions* options);
+
+/* add up to node_count nodes, returns how many were added or -1 */
+int64_t GenerateStep(GraphGrowth* growth, uint32_t node_count);
+
+/* freeze the graph and release the growth state */
+int GenerateEnd(GraphGrowth* growth);
+
+void print_graph(const Graph* graph);
+
+#endif  // GRAPH_H_
@@ -0,0 +1,309 @@
+
+#include "graph_file.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static uint64_t AlignSection(uint64_t offset) {
+  uint64_t mask = GRAPH_FILE_ALIGNMENT - 1;
+  return (offset + mask) & ~mask;
+}
+
+/* fill the header and section offsets for a graph of the given size */
+static void GraphFileLayout(GraphFileHeader* header, uint64_t node_count,
+                            uint64_t edge_count,
+                            const GenerateOptions* options) {
+  memset(header, 0, sizeof(GraphFileHeader));
+  memcpy(header->magic, GRAPH_FILE_MAGIC, sizeof(header->magic));
+  header->version = GRAPH_FILE_VERSION;
+  header->header_size = sizeof(GraphFileHeader);
+  header->node_count = node_count;
+  header->edge_count = edge_count;
+  if (options != NULL) {
+    header->seed = options->seed;
+    header->m = options->m;
+    header->mode = (uint32_t)options->mode;
+  }
+  header->degree_offset = AlignSection(sizeof(GraphFileHeader));
+  header->offsets_offset =
+      AlignSection(header->degree_offset + sizeof(uint32_t) * node_count);
+  header->neighbors_offset = AlignSection(
+      header->offsets_offset + sizeof(uint64_t) * (node_count + 1));
+  header->file_size =
+      header->neighbors_offset + sizeof(uint32_t) * 2 * edge_count;
+}
+
+static void GraphWriterRelease(GraphWriter* writer) {
+  if (writer->map != NULL) {
+    munmap(writer->map, writer->map_size);
+  }
+  if (writer->fd >= 0) {
+    close(writer->fd);
+  }
+  memset(writer, 0, sizeof(GraphWriter));
+  writer->fd = -1;
+}
+
+int GraphWriterOpen(GraphWriter* writer, const char* path,
+                    uint32_t node_capacity, uint64_t edge_capacity,
+                    const GenerateOptions* options) {
+  memset(writer, 0, sizeof(GraphWriter));
+  writer->node_capacity = node_capacity;
+  writer->edge_capacity = edge_capacity;
+
+  /* the CSR sections are sized for the capacity, the scratch edge list
+   * follows them and is cut off when the writer is closed */
+  GraphFileLayout(&writer->header, node_capacity, edge_capacity, options);
+  writer->scratch_offset = AlignSection(writer->header.file_size);
+  writer->map_size =
+      writer->scratch_offset + sizeof(uint32_t) * 2 * edge_capacity;
+
+  writer->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (writer->fd < 0) {
+    fprintf(stderr, "failed to create graph file %s\n", path);
+    return -1;
+  }
+  if (0 != ftruncate(writer->fd, (off_t)writer->map_size)) {
+    fprintf(stderr, "failed to size graph file %s to %llu bytes\n", path,
+            (unsigned long long)writer->map_size);
+    GraphWriterRelease(writer);
+    return -1;
+  }
+  void* map = mmap(NULL, writer->map_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED, writer->fd, 0);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "failed to map graph file %s\n", path);
+    GraphWriterRelease(writer);
+    return -1;
+  }
+  writer->map = (uint8_t*)map;
+
+  return 0;
+}
+
+int GraphWriterAddEdges(GraphWriter* writer, const uint32_t* edges,
+                        uint64_t edge_count) {
+  if (edge_count > writer->edge_capacity - writer->edge_count) {
+    fprintf(stderr, "graph writer is full at %llu edges\n",
+            (unsigned long long)writer->edge_capacity);
+    return -1;
+  }
+
+  uint32_t* degree =
+      (uint32_t*)(writer->map + writer->header.degree_offset);
+  for (uint64_t e = 0; e < 2 * edge_count; e++) {
+    if (edges[e] >= writer->node_capacity) {
+      fprintf(stderr, "graph writer: endpoint %u out of range\n", edges[e]);
+      return -1;
+    }
+    degree[edges[e]]++;
+  }
+
+  uint32_t* scratch = (uint32_t*)(writer->map + writer->scratch_offset);
+  memcpy(scratch + 2 * writer->edge_count, edges,
+         sizeof(uint32_t) * 2 * edge_count);
+  writer->edge_count += edge_count;
+  return 0;
+}
+
+int GraphWriterClose(GraphWriter* writer) {
+  if (writer->map == NULL) {
+    return -1;
+  }
+
+  GraphFileHeader* header = &writer->header;
+  uint64_t node_count = header->node_count;
+  const uint32_t* degree =
+      (const uint32_t*)(writer->map + header->degree_offset);
+  uint64_t* offsets = (uint64_t*)(writer->map + header->offsets_offset);
+  uint32_t* neighbors = (uint32_t*)(writer->map + header->neighbors_offset);
+  const uint32_t* edges =
+      (const uint32_t*)(writer->map + writer->scratch_offset);
+
+  /* same counting scatter as GraphFreezeEdges(), the offsets are the
+   * cursors and are shifted back afterwards */
+  uint64_t offset = 0;
+  for (uint64_t i = 0; i < node_count; i++) {
+    offsets[i] = offset;
+    offset += degree[i];
+  }
+  offsets[node_count] = offset;
+
+  for (uint64_t e = 0; e < writer->edge_count; e++) {
+    uint32_t u = edges[2 * e];
+    uint32_t v = edges[2 * e + 1];
+    neighbors[offsets[u]++] = v;
+    neighbors[offsets[v]++] = u;
+  }
+  for (uint64_t i = 0; i < node_count; i++) {
+    offsets[i] -= degree[i];
+  }
+
+  /* the header goes in last, a file cut short never looks valid */
+  header->edge_count = writer->edge_count;
+  header->file_size =
+      header->neighbors_offset + sizeof(uint32_t) * 2 * writer->edge_count;
+  memcpy(writer->map, header, sizeof(GraphFileHeader));
+
+  /* the page cache already holds the data, dropping the mapping and the
+   * scratch tail is enough for readers to see the finished file */
+  int result = 0;
+  munmap(writer->map, writer->map_size);
+  writer->map = NULL;
+  if (0 != ftruncate(writer->fd, (off_t)header->file_size)) {
+    fprintf(stderr, "failed to truncate graph file\n");
+    result = -1;
+  }
+
+  GraphWriterRelease(writer);
+  return result;
+}
+
+static int WriteSection(FILE* file, uint64_t offset, const void* data,
+                        uint64_t size) {
+  if (0 != fseeko(file, (off_t)offset, SEEK_SET)) {
+    return -1;
+  }
+  return fwrite(data, 1, size, file) == size ? 0 : -1;
+}
+
+int GraphWriteFile(const char* path, const Graph* graph,
+                   const GenerateOptions* options) {
+  if (!graph->frozen) {
+    fprintf(stderr, "GraphWriteFile: the graph has to be frozen\n");
+    return -1;
+  }
+
+  GraphFileHeader header;
+  GraphFileLayout(&header, graph->node_count, graph->edge_count, options);
+
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    fprintf(stderr, "failed to create graph file %s\n", path);
+    return -1;
+  }
+  int result = 0;
+  if (0 != WriteSection(file, 0, &header, sizeof(header)) ||
+      0 != WriteSection(file, header.degree_offset, graph->degree,
+                        sizeof(uint32_t) * graph->node_count) ||
+      0 != WriteSection(file, header.offsets_offset, graph->offsets,
+                        sizeof(uint64_t) * (graph->node_count + 1)) ||
+      0 != WriteSection(file, header.neighbors_offset, graph->neighbors,
+                        sizeof(uint32_t) * 2 * graph->edge_count)) {
+    fprintf(stderr, "failed to write graph file %s\n", path);
+    result = -1;
+  }
+  if (0 != fclose(file)) {
+    result = -1;
+  }
+  return result;
+}
+
+static bool SectionFits(uint64_t offset, uint64_t size, uint64_t alignment,
+                        uint64_t file_size) {
+  return offset % alignment == 0 && offset <= file_size &&
+         size <= file_size - offset;
+}
+
+/* offsets start at 0, never decrease, end at total_degree and agree with
+ * every degree, so no neighbor range reaches outside the neighbors, and
+ * every neighbor is a node of the graph */
+static bool AdjacencyConsistent(const uint32_t* degree,
+                                const uint64_t* offsets,
+                                const uint32_t* neighbors, uint64_t n,
+                                uint64_t total_degree) {
+  if (offsets[0] != 0 || offsets[n] != total_degree) {
+    return false;
+  }
+  for (uint64_t i = 0; i < n; i++) {
+    if (offsets[i + 1] < offsets[i] || offsets[i + 1] > total_degree ||
+        offsets[i + 1] - offsets[i] != degree[i]) {
+      return false;
+    }
+  }
+  /* one sequential pass, a bad index would otherwise only show up where
+   * a layout or shader reads through it */
+  for (uint64_t k = 0; k < total_degree; k++) {
+    if (neighbors[k] >= n) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int GraphMapFile(Graph* graph, const char* path, GraphFileHeader* header) {
+  memset(graph, 0, sizeof(Graph));
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "failed to open graph file %s\n", path);
+    return -1;
+  }
+  struct stat st;
+  if (0 != fstat(fd, &st) || (uint64_t)st.st_size < sizeof(GraphFileHeader)) {
+    fprintf(stderr, "%s is not a graph file\n", path);
+    close(fd);
+    return -1;
+  }
+  uint64_t size = (uint64_t)st.st_size;
+  void* map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  /* the mapping keeps the file alive */
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "failed to map graph file %s\n", path);
+    return -1;
+  }
+
+  const GraphFileHeader* file_header = (const GraphFileHeader*)map;
+  uint64_t n = file_header->node_count;
+  uint64_t e = file_header->edge_count;
+  bool valid =
+      0 == memcmp(file_header->magic, GRAPH_FILE_MAGIC,
+                  sizeof(file_header->magic)) &&
+      file_header->version == GRAPH_FILE_VERSION &&
+      file_header->header_size == sizeof(GraphFileHeader) &&
+      file_header->file_size == size && n <= UINT32_MAX &&
+      /* the neighbors' byte size below must not wrap */
+      e <= UINT64_MAX / (2 * sizeof(uint32_t)) &&
+      SectionFits(file_header->degree_offset, sizeof(uint32_t) * n,
+                  sizeof(uint32_t), size) &&
+      SectionFits(file_header->offsets_offset, sizeof(uint64_t) * (n + 1),
+                  sizeof(uint64_t), size) &&
+      SectionFits(file_header->neighbors_offset, sizeof(uint32_t) * 2 * e,
+                  sizeof(uint32_t), size);
+  const uint8_t* bytes = (const uint8_t*)map;
+  if (!valid ||
+      !AdjacencyConsistent(
+          (const uint32_t*)(bytes + file_header->degree_offset),
+          (const uint64_t*)(bytes + file_header->offsets_offset),
+          (const uint32_t*)(bytes + file_header->neighbors_offset), n,
+          2 * e)) {
+    fprintf(stderr, "%s is not a valid version %u graph file\n", path,
+            GRAPH_FILE_VERSION);
+    munmap(map, size);
+    return -1;
+  }
+
+  /* the arrays stay in the page cache, the graph only borrows them */
+  uint8_t* base = (uint8_t*)map;
+  graph->node_count = (uint32_t)n;
+  graph->node_capacity = (uint32_t)n;
+  graph->edge_count = e;
+  graph->total_degree = 2 * e;
+  graph->degree = (uint32_t*)(base + file_header->degree_offset);
+  graph->offsets = (uint64_t*)(base + file_header->offsets_offset);
+  graph->neighbors = (uint32_t*)(base + file_header->neighbors_offset);
+  graph->frozen = true;
+  graph->mapping = map;
+  graph->mapping_size = size;
+
+  if (header != NULL) {
+    memcpy(header, file_header, sizeof(GraphFileHeader));
+  }
+  return 0;
+}
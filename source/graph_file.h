@@ -0,0 +1,77 @@
+#ifndef GRAPH_FILE_H_
+#define GRAPH_FILE_H_
+
+#include <stdint.h>
+
+#include "graph.h"
+
+/* Binary graph file, native (little-endian) byte order:
+ *
+ *   header | degree[node_count] | offsets[node_count + 1] |
+ *   neighbors[2 * edge_count]
+ *
+ * Every section starts on a GRAPH_FILE_ALIGNMENT boundary and has the same
+ * layout as the frozen Graph arrays, so a loaded graph points straight into
+ * the mapping. */
+
+#define GRAPH_FILE_MAGIC "BAGRAPH"
+#define GRAPH_FILE_VERSION 1u
+#define GRAPH_FILE_ALIGNMENT 4096u
+
+typedef struct {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint64_t node_count;
+  uint64_t edge_count;
+  /* generation parameters, m is 0 when they are unknown */
+  uint64_t seed;
+  uint32_t m;
+  uint32_t mode;
+  /* byte offsets of the sections from the start of the file */
+  uint64_t degree_offset;
+  uint64_t offsets_offset;
+  uint64_t neighbors_offset;
+  uint64_t file_size;
+} GraphFileHeader;
+
+/* Streaming writer: edges are appended to a scratch section of the mapped
+ * file while they are generated, GraphWriterClose() scatters them into the
+ * CSR sections and truncates the scratch away. Only the file mapping holds
+ * the edges, so the graph can be larger than what fits in memory twice. */
+struct GraphWriter {
+  int fd;
+  uint8_t* map;
+  uint64_t map_size;
+  GraphFileHeader header;
+  uint32_t node_capacity;
+  uint64_t edge_capacity;
+  uint64_t edge_count;
+  uint64_t scratch_offset;
+};
+
+/* create the file at path for up to node_capacity nodes and edge_capacity
+ * edges, options only fill the header and may be NULL */
+int GraphWriterOpen(GraphWriter* writer, const char* path,
+                    uint32_t node_capacity, uint64_t edge_capacity,
+                    const GenerateOptions* options);
+
+/* append edge_count edges given as pairs of endpoints */
+int GraphWriterAddEdges(GraphWriter* writer, const uint32_t* edges,
+                        uint64_t edge_count);
+
+/* build the CSR sections and finish the file, the writer is closed even
+ * when this fails */
+int GraphWriterClose(GraphWriter* writer);
+
+/* write a frozen graph in one go */
+int GraphWriteFile(const char* path, const Graph* graph,
+                   const GenerateOptions* options);
+
+/* map the file read-only and point a frozen graph at it. One sequential
+ * pass checks that the offsets agree with the degrees and that every
+ * neighbor is below the node count, so the whole file is read once. header
+ * may be NULL. GraphDestroy() unmaps the file. */
+int GraphMapFile(Graph* graph, const char* path, GraphFileHeader* header);
+
+#endif  // GRAPH_FILE_H_
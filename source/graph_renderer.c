@@ -0,0 +1,556 @@
+
+#include "graph_renderer.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "compute.h"
+#include "frame.h"
+#include "mem.h"
+#include "pipeline.h"
+#include "record.h"
+#include "renderer.h"
+#include "staging.h"
+
+extern VkDevice device;
+extern VkPhysicalDevice physical_device;
+extern VkExtent2D swapchain_size;
+extern VkFormat swapchain_image_format;
+
+/* push constants of graph_node.vert, graph_edge.vert and graph.frag */
+typedef struct {
+  float color[4];
+  float scale[2];
+  float offset[2];
+  /* size of a pixel in clip space */
+  float pixel[2];
+  float point_size;
+} GraphView;
+
+static VkBuffer node_buffer = VK_NULL_HANDLE;
+static MemAllocation node_buffer_memory;
+static VkBuffer edge_buffer = VK_NULL_HANDLE;
+static MemAllocation edge_buffer_memory;
+
+/* the box the view is fitted to is read by graph.vert as an instance
+ * attribute, from the frame's transient buffer for the bounds set by the
+ * host or from the state buffer of a GPU layout */
+static const ComputeLayout* gpu_layout = NULL;
+
+/* the vertex shaders pull positions and edges from the buffers above */
+static VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+static VkDescriptorPool descriptor_pool = VK_NULL_HANDLE;
+static VkDescriptorSet descriptor_set = VK_NULL_HANDLE;
+
+static VkPipelineLayout pipeline_layout = VK_NULL_HANDLE;
+static VkPipeline edge_pipeline = VK_NULL_HANDLE;
+static VkPipeline node_pipeline = VK_NULL_HANDLE;
+
+/* building the pipelines above ahead of CreateGraphRenderer() */
+static pthread_t pipeline_thread;
+static bool pipeline_thread_running = false;
+static int pipeline_thread_result = -1;
+
+static uint32_t node_capacity = 0;
+static uint64_t edge_capacity = 0;
+
+/* what the caller has, and what already lives on the GPU */
+static const float* source_positions = NULL;
+static uint32_t source_node_count = 0;
+static const uint32_t* source_edges = NULL;
+static uint64_t source_edge_count = 0;
+static uint32_t uploaded_node_count = 0;
+static uint64_t uploaded_edge_count = 0;
+/* nodes whose current position is on the GPU, the positions of the other
+ * uploaded nodes are stale after GraphRendererRefreshPositions() */
+static uint32_t refreshed_node_count = 0;
+
+/* world-space box that fills the window */
+static float view_box[4] = {-1.f, -1.f, 1.f, 1.f};
+
+static int CreateDeviceBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
+                              VkMemoryPropertyFlags property_flags,
+                              VkBuffer* buffer, MemAllocation* memory) {
+  *buffer = CreateBuffer(size, usage);
+  if (*buffer == VK_NULL_HANDLE) {
+    return -1;
+  }
+  if (0 != AllocateBufferMemory(*buffer, property_flags, memory)) {
+    fprintf(stderr, "failed to allocate graph buffer of %llu bytes\n",
+            (unsigned long long)size);
+    return -1;
+  }
+  return 0;
+}
+
+static VkPipeline CreateGraphPipeline(const char* vertex_shader,
+                                      VkPrimitiveTopology topology) {
+  /* the view box is the only vertex attribute, a stride of 0 gives every
+   * vertex and instance the same one */
+  VkVertexInputBindingDescription binding = {
+      .binding = 0, .stride = 0, .inputRate = VK_VERTEX_INPUT_RATE_INSTANCE};
+  VkVertexInputAttributeDescription attribute = {
+      .location = 0,
+      .binding = 0,
+      .format = VK_FORMAT_R32G32B32A32_SFLOAT,
+      .offset = 0};
+
+  /* dense regions should brighten instead of saturating at once. The
+   * formats match the attachments Render() begins rendering with */
+  PipelineGraphicsDesc desc = {.vertex_shader = vertex_shader,
+                               .fragment_shader = "graph.frag.spv",
+                               .layout = pipeline_layout,
+                               .topology = topology,
+                               .bindings = &binding,
+                               .binding_count = 1,
+                               .attributes = &attribute,
+                               .attribute_count = 1,
+                               .alpha_blend = true,
+                               .color_format = swapchain_image_format,
+                               .depth_format = VK_FORMAT_D32_SFLOAT};
+  return PipelineCreateGraphics(&desc);
+}
+
+static int CreatePipelines(void) {
+  VkDescriptorSetLayoutBinding bindings[2] = {};
+  for (uint32_t i = 0; i < 2; i++) {
+    bindings[i].binding = i;
+    bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    bindings[i].descriptorCount = 1;
+    bindings[i].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  }
+  VkDescriptorSetLayoutCreateInfo set_layout_info = {};
+  set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+  set_layout_info.bindingCount = 2;
+  set_layout_info.pBindings = bindings;
+  if (VK_SUCCESS != vkCreateDescriptorSetLayout(device, &set_layout_info,
+                                                VK_NULL_HANDLE,
+                                                &set_layout)) {
+    fprintf(stderr, "Failed to create graph descriptor set layout\n");
+    return -1;
+  }
+
+  VkPushConstantRange push_range = {
+      .stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT,
+      .offset = 0,
+      .size = sizeof(GraphView)};
+  VkPipelineLayoutCreateInfo layout_info = {};
+  layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+  layout_info.setLayoutCount = 1;
+  layout_info.pSetLayouts = &set_layout;
+  layout_info.pushConstantRangeCount = 1;
+  layout_info.pPushConstantRanges = &push_range;
+  if (VK_SUCCESS != vkCreatePipelineLayout(device, &layout_info,
+                                           VK_NULL_HANDLE, &pipeline_layout)) {
+    fprintf(stderr, "Failed to create graph pipeline layout\n");
+    return -1;
+  }
+
+  edge_pipeline = CreateGraphPipeline("graph_edge.vert.spv",
+                                      VK_PRIMITIVE_TOPOLOGY_LINE_LIST);
+  node_pipeline = CreateGraphPipeline("graph_node.vert.spv",
+                                      VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP);
+  if (edge_pipeline == VK_NULL_HANDLE || node_pipeline == VK_NULL_HANDLE) {
+    return -1;
+  }
+  return 0;
+}
+
+static void* BuildPipelinesMain(void* arg) {
+  (void)arg;
+  pipeline_thread_result = CreatePipelines();
+  return NULL;
+}
+
+void GraphRendererBuildPipelines(void) {
+  if (pipeline_thread_running || pipeline_layout != VK_NULL_HANDLE) {
+    return;
+  }
+  /* without the thread CreateGraphRenderer() builds them itself */
+  pipeline_thread_running =
+      0 == pthread_create(&pipeline_thread, NULL, BuildPipelinesMain, NULL);
+}
+
+/* the pipelines GraphRendererBuildPipelines() started, or build them now */
+static int WaitForPipelines(void) {
+  if (!pipeline_thread_running) {
+    return CreatePipelines();
+  }
+  pthread_join(pipeline_thread, NULL);
+  pipeline_thread_running = false;
+  return pipeline_thread_result;
+}
+
+static int CreateDescriptorSet(void) {
+  VkDescriptorPoolSize pool_size = {
+      .type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, .descriptorCount = 2};
+  VkDescriptorPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+  pool_info.maxSets = 1;
+  pool_info.poolSizeCount = 1;
+  pool_info.pPoolSizes = &pool_size;
+  if (VK_SUCCESS != vkCreateDescriptorPool(device, &pool_info, VK_NULL_HANDLE,
+                                           &descriptor_pool)) {
+    fprintf(stderr, "Failed to create graph descriptor pool\n");
+    return -1;
+  }
+
+  VkDescriptorSetAllocateInfo allocate_info = {};
+  allocate_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+  allocate_info.descriptorPool = descriptor_pool;
+  allocate_info.descriptorSetCount = 1;
+  allocate_info.pSetLayouts = &set_layout;
+  if (VK_SUCCESS !=
+      vkAllocateDescriptorSets(device, &allocate_info, &descriptor_set)) {
+    fprintf(stderr, "Failed to allocate graph descriptor set\n");
+    return -1;
+  }
+
+  VkDescriptorBufferInfo buffer_infos[2] = {
+      {.buffer = node_buffer, .offset = 0, .range = VK_WHOLE_SIZE},
+      {.buffer = edge_buffer, .offset = 0, .range = VK_WHOLE_SIZE}};
+  VkWriteDescriptorSet writes[2] = {};
+  for (uint32_t i = 0; i < 2; i++) {
+    writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[i].dstSet = descriptor_set;
+    writes[i].dstBinding = i;
+    writes[i].descriptorCount = 1;
+    writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[i].pBufferInfo = &buffer_infos[i];
+  }
+  vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+  return 0;
+}
+
+int CreateGraphRenderer(uint32_t nodes, uint64_t edges) {
+  node_capacity = nodes;
+  edge_capacity = edges;
+  uploaded_node_count = 0;
+  uploaded_edge_count = 0;
+  refreshed_node_count = 0;
+  gpu_layout = NULL;
+
+  /* the shaders see each buffer through a single storage buffer binding,
+   * empty graphs still get a valid buffer */
+  VkDeviceSize node_size =
+      sizeof(float) * 2 * (VkDeviceSize)(nodes > 0 ? nodes : 1);
+  VkDeviceSize edge_size =
+      sizeof(uint32_t) * 2 * (VkDeviceSize)(edges > 0 ? edges : 1);
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  VkDeviceSize max_range = properties.limits.maxStorageBufferRange;
+  if (node_size > max_range || edge_size > max_range) {
+    fprintf(stderr, "graph buffers of %llu and %llu bytes exceed the %llu "
+                    "byte storage buffer limit\n",
+            (unsigned long long)node_size, (unsigned long long)edge_size,
+            (unsigned long long)max_range);
+    return -1;
+  }
+
+  if (0 != CreateDeviceBuffer(node_size,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              &node_buffer, &node_buffer_memory) ||
+      0 != CreateDeviceBuffer(edge_size,
+                              VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                                  VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                              VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                              &edge_buffer, &edge_buffer_memory)) {
+    DestroyGraphRenderer();
+    return -1;
+  }
+
+  if (0 != WaitForPipelines() || 0 != CreateDescriptorSet()) {
+    DestroyGraphRenderer();
+    return -1;
+  }
+  return 0;
+}
+
+void DestroyGraphRenderer(void) {
+  if (pipeline_thread_running) {
+    pthread_join(pipeline_thread, NULL);
+    pipeline_thread_running = false;
+  }
+  if (node_pipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, node_pipeline, VK_NULL_HANDLE);
+    node_pipeline = VK_NULL_HANDLE;
+  }
+  if (edge_pipeline != VK_NULL_HANDLE) {
+    vkDestroyPipeline(device, edge_pipeline, VK_NULL_HANDLE);
+    edge_pipeline = VK_NULL_HANDLE;
+  }
+  if (pipeline_layout != VK_NULL_HANDLE) {
+    vkDestroyPipelineLayout(device, pipeline_layout, VK_NULL_HANDLE);
+    pipeline_layout = VK_NULL_HANDLE;
+  }
+  /* frees the set as well */
+  if (descriptor_pool != VK_NULL_HANDLE) {
+    vkDestroyDescriptorPool(device, descriptor_pool, VK_NULL_HANDLE);
+    descriptor_pool = VK_NULL_HANDLE;
+    descriptor_set = VK_NULL_HANDLE;
+  }
+  if (set_layout != VK_NULL_HANDLE) {
+    vkDestroyDescriptorSetLayout(device, set_layout, VK_NULL_HANDLE);
+    set_layout = VK_NULL_HANDLE;
+  }
+  VkBuffer* buffers[] = {&node_buffer, &edge_buffer};
+  MemAllocation* memories[] = {&node_buffer_memory, &edge_buffer_memory};
+  for (uint32_t i = 0; i < 2; i++) {
+    if (*buffers[i] != VK_NULL_HANDLE) {
+      vkDestroyBuffer(device, *buffers[i], VK_NULL_HANDLE);
+      *buffers[i] = VK_NULL_HANDLE;
+    }
+    FreeMemory(memories[i]);
+  }
+
+  source_positions = NULL;
+  source_edges = NULL;
+  source_node_count = 0;
+  source_edge_count = 0;
+  uploaded_node_count = 0;
+  uploaded_edge_count = 0;
+  refreshed_node_count = 0;
+  gpu_layout = NULL;
+}
+
+void GraphRendererUpdate(const float* positions, uint32_t node_count,
+                         const uint32_t* edges, uint64_t edge_count) {
+  source_positions = positions;
+  source_node_count = node_count < node_capacity ? node_count : node_capacity;
+  source_edges = edges;
+  source_edge_count = edge_count < edge_capacity ? edge_count : edge_capacity;
+}
+
+void GraphRendererRefreshPositions(void) { refreshed_node_count = 0; }
+
+void GraphRendererSetBounds(const float min[2], const float max[2]) {
+  view_box[0] = min[0];
+  view_box[1] = min[1];
+  view_box[2] = max[0];
+  view_box[3] = max[1];
+}
+
+VkBuffer GraphRendererNodeBuffer(void) { return node_buffer; }
+
+void GraphRendererSetLayout(const ComputeLayout* layout) {
+  gpu_layout = layout;
+}
+
+/* copy the positions of count nodes starting at first through the staging
+ * ring, -1 when it is full */
+static int StageNodes(VkCommandBuffer cmd, uint32_t first, uint64_t count) {
+  const VkDeviceSize node_size = sizeof(float) * 2;
+  return StagingCopyToBuffer(cmd, node_buffer, node_size * first,
+                             source_positions + 2 * (uint64_t)first,
+                             node_size * count);
+}
+
+void GraphRendererRecordUploads(VkCommandBuffer cmd) {
+  if (node_buffer == VK_NULL_HANDLE) {
+    return;
+  }
+
+  /* whatever does not fit in the ring is left for the next frame */
+  VkDeviceSize budget = GRAPH_RENDERER_UPLOAD_BYTES;
+  VkDeviceSize staged = 0;
+  bool copied = false;
+
+  /* new nodes go first: edges are only uploaded once every node they can
+   * reference is on the GPU */
+  const VkDeviceSize node_size = sizeof(float) * 2;
+  uint64_t nodes = source_node_count - uploaded_node_count;
+  if (nodes > budget / node_size) {
+    nodes = budget / node_size;
+  }
+  if (nodes > 0 && 0 == StageNodes(cmd, uploaded_node_count, nodes)) {
+    staged += node_size * nodes;
+    if (refreshed_node_count == uploaded_node_count) {
+      refreshed_node_count += (uint32_t)nodes;
+    }
+    uploaded_node_count += (uint32_t)nodes;
+    copied = true;
+  }
+
+  const VkDeviceSize edge_size = sizeof(uint32_t) * 2;
+  uint64_t edges = 0;
+  if (uploaded_node_count == source_node_count) {
+    edges = source_edge_count - uploaded_edge_count;
+    if (edges > (budget - staged) / edge_size) {
+      edges = (budget - staged) / edge_size;
+    }
+  }
+  if (edges > 0 &&
+      0 == StagingCopyToBuffer(cmd, edge_buffer,
+                               edge_size * uploaded_edge_count,
+                               source_edges + 2 * uploaded_edge_count,
+                               edge_size * edges)) {
+    uploaded_edge_count += edges;
+    staged += edge_size * edges;
+    copied = true;
+  }
+
+  /* moved nodes get whatever is left, the topology is never held back by
+   * a layout that keeps moving */
+  nodes = uploaded_node_count - refreshed_node_count;
+  if (nodes > (budget - staged) / node_size) {
+    nodes = (budget - staged) / node_size;
+  }
+  if (nodes > 0 && 0 == StageNodes(cmd, refreshed_node_count, nodes)) {
+    refreshed_node_count += (uint32_t)nodes;
+    copied = true;
+  }
+
+  if (copied) {
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, 0, 1, &barrier,
+                         0, NULL, 0, NULL);
+  }
+}
+
+void GraphRendererRecordLayout(VkCommandBuffer cmd) {
+  /* the layout integrates every position, so it waits until the initial
+   * ones are all on the GPU */
+  if (gpu_layout == NULL || uploaded_node_count < gpu_layout->node_count ||
+      refreshed_node_count < uploaded_node_count) {
+    return;
+  }
+  ComputeRecordLayout(cmd, gpu_layout);
+
+  /* positions are pulled by the vertex shaders, the view box is a vertex
+   * attribute */
+  VkBufferMemoryBarrier barriers[2] = {};
+  for (uint32_t i = 0; i < 2; i++) {
+    barriers[i].sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barriers[i].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  }
+  barriers[0].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barriers[0].buffer = node_buffer;
+  barriers[0].offset = 0;
+  barriers[0].size = gpu_layout->positions.size;
+  barriers[1].dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+  barriers[1].buffer = gpu_layout->state.buffer;
+  barriers[1].offset = COMPUTE_LAYOUT_VIEW_OFFSET;
+  barriers[1].size = sizeof(view_box);
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                       VK_PIPELINE_STAGE_VERTEX_INPUT_BIT |
+                           VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                       0, 0, NULL, 2, barriers, 0, NULL);
+}
+
+/* what every slice of a frame's draws records with, filled in on the
+ * calling thread before any slice runs */
+typedef struct {
+  VkBuffer view_source;
+  VkDeviceSize view_offset;
+  GraphView edge_view;
+  GraphView node_view;
+  /* slices [0, edge_slices) draw edges, the rest draw nodes on top */
+  uint32_t edge_slices;
+  uint32_t node_slices;
+} GraphDraw;
+
+/* slices of about GRAPH_RENDERER_SLICE_ITEMS items, at most one per
+ * recording thread */
+static uint32_t SliceCount(uint64_t items) {
+  uint64_t count = (items + GRAPH_RENDERER_SLICE_ITEMS - 1) /
+                   GRAPH_RENDERER_SLICE_ITEMS;
+  if (count > RecordThreads()) {
+    count = RecordThreads();
+  }
+  return count > 0 ? (uint32_t)count : 1u;
+}
+
+static void DrawSlice(VkCommandBuffer cmd, uint32_t slice, void* user) {
+  const GraphDraw* draw = (const GraphDraw*)user;
+
+  /* a secondary inherits none of the primary's state */
+  VkViewport viewport = {.x = 0.f,
+                         .y = 0.f,
+                         .width = (float)swapchain_size.width,
+                         .height = (float)swapchain_size.height,
+                         .minDepth = 0.f,
+                         .maxDepth = 1.f};
+  VkRect2D scissor = {.offset = {0, 0}, .extent = swapchain_size};
+  vkCmdSetViewport(cmd, 0, 1, &viewport);
+  vkCmdSetScissor(cmd, 0, 1, &scissor);
+  vkCmdBindVertexBuffers(cmd, 0, 1, &draw->view_source, &draw->view_offset);
+  vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                          pipeline_layout, 0, 1, &descriptor_set, 0, NULL);
+  VkShaderStageFlags stages =
+      VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+  /* the shaders pull what they need from the buffers, a slice only moves
+   * the first vertex or instance: gl_VertexIndex and gl_InstanceIndex
+   * include it */
+  if (slice < draw->edge_slices) {
+    uint64_t begin = uploaded_edge_count * slice / draw->edge_slices;
+    uint64_t end = uploaded_edge_count * (slice + 1) / draw->edge_slices;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, edge_pipeline);
+    vkCmdPushConstants(cmd, pipeline_layout, stages, 0, sizeof(GraphView),
+                       &draw->edge_view);
+    vkCmdDraw(cmd, (uint32_t)(2 * (end - begin)), 1, (uint32_t)(2 * begin),
+              0);
+  } else {
+    slice -= draw->edge_slices;
+    uint64_t begin = (uint64_t)uploaded_node_count * slice / draw->node_slices;
+    uint64_t end =
+        (uint64_t)uploaded_node_count * (slice + 1) / draw->node_slices;
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, node_pipeline);
+    vkCmdPushConstants(cmd, pipeline_layout, stages, 0, sizeof(GraphView),
+                       &draw->node_view);
+    vkCmdDraw(cmd, 4, (uint32_t)(end - begin), 0, (uint32_t)begin);
+  }
+}
+
+void GraphRendererDraw(
+    VkCommandBuffer cmd,
+    const VkCommandBufferInheritanceRenderingInfo* rendering) {
+  if (node_pipeline == VK_NULL_HANDLE || uploaded_node_count == 0) {
+    return;
+  }
+
+  /* graph.vert maps the view box to [-1, 1], this fits that square into
+   * the window whatever its aspect ratio */
+  float aspect = (float)swapchain_size.height / (float)swapchain_size.width;
+  GraphDraw draw = {};
+  draw.edge_view = (GraphView){.color = {0.2f, 0.4f, 0.9f, 0.15f},
+                               .scale = {0.95f * aspect, 0.95f},
+                               .offset = {0.f, 0.f},
+                               .pixel = {2.f / (float)swapchain_size.width,
+                                         2.f / (float)swapchain_size.height},
+                               .point_size = 2.f};
+  draw.node_view = draw.edge_view;
+  draw.node_view.color[0] = 1.f;
+  draw.node_view.color[1] = 0.9f;
+  draw.node_view.color[2] = 0.6f;
+  draw.node_view.color[3] = 1.f;
+
+  /* a GPU layout writes its bounds next to its speed, no readback */
+  if (gpu_layout != NULL) {
+    draw.view_source = gpu_layout->state.buffer;
+    draw.view_offset = COMPUTE_LAYOUT_VIEW_OFFSET;
+  } else {
+    void* mapped = FrameTransientAlloc(sizeof(view_box), sizeof(float),
+                                       &draw.view_source, &draw.view_offset);
+    if (mapped == NULL) {
+      return;
+    }
+    memcpy(mapped, view_box, sizeof(view_box));
+  }
+
+  draw.edge_slices =
+      uploaded_edge_count > 0 ? SliceCount(uploaded_edge_count) : 0;
+  draw.node_slices = SliceCount(uploaded_node_count);
+  RecordSecondaries(cmd, rendering, draw.edge_slices + draw.node_slices,
+                    DrawSlice, &draw);
+}
@@ -0,0 +1,64 @@
+#ifndef GRAPH_RENDERER_H_
+#define GRAPH_RENDERER_H_
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+#include "compute.h"
+
+/* staging ring bytes the uploads of one frame may take */
+#define GRAPH_RENDERER_UPLOAD_BYTES (8u << 20)
+/* nodes or edges per secondary command buffer, smaller draws are not worth
+ * handing to another recording thread */
+#define GRAPH_RENDERER_SLICE_ITEMS (1u << 18)
+
+/* start building the pipelines on another thread, they only need the
+ * swapchain format, so the mode can load its graph meanwhile.
+ * CreateGraphRenderer() waits for them, or builds them without this */
+void GraphRendererBuildPipelines(void);
+
+/* create device-local node and edge buffers sized for the final graph, call
+ * after the swapchain exists */
+int CreateGraphRenderer(uint32_t node_capacity, uint64_t edge_capacity);
+
+void DestroyGraphRenderer(void);
+
+/* point the renderer at the current graph: 2 floats per node and one pair
+ * of node indices per edge. Both arrays only ever grow, the renderer keeps
+ * track of what it has already uploaded and only copies the rest, at most
+ * GRAPH_RENDERER_UPLOAD_BYTES per frame. The arrays must stay valid until
+ * the next update. */
+void GraphRendererUpdate(const float* positions, uint32_t node_count,
+                         const uint32_t* edges, uint64_t edge_count);
+
+/* the positions passed to the last update have moved, upload all of them
+ * again. Nodes keep being drawn at their old position until then. */
+void GraphRendererRefreshPositions(void);
+
+/* show the box [min, max] instead of [-1, 1], the aspect ratio is kept */
+void GraphRendererSetBounds(const float min[2], const float max[2]);
+
+/* device-local positions, 2 floats per node, usable as a storage buffer */
+VkBuffer GraphRendererNodeBuffer(void);
+
+/* step a layout running on GraphRendererNodeBuffer() once per frame and
+ * fit the view to its bounds, NULL goes back to GraphRendererSetBounds().
+ * The layout has to outlive the renderer or be unset first. */
+void GraphRendererSetLayout(const ComputeLayout* layout);
+
+/* record this frame's copies, before rendering begins */
+void GraphRendererRecordUploads(VkCommandBuffer cmd);
+
+/* record this frame's layout step, after the uploads and before rendering
+ * begins */
+void GraphRendererRecordLayout(VkCommandBuffer cmd);
+
+/* draw the uploaded part of the graph inside the rendering pass, recorded
+ * in parallel into secondaries that cmd executes. The pass must have begun
+ * with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT and attachments
+ * of the formats in rendering */
+void GraphRendererDraw(
+    VkCommandBuffer cmd,
+    const VkCommandBufferInheritanceRenderingInfo* rendering);
+
+#endif  // GRAPH_RENDERER_H_
@@ -4,10 +4,15 @@
 #include <X11/Xlib.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_wayland.h>
 #include <vulkan/vulkan_xlib.h>
 
+#include "frame.h"
+#include "mem.h"
+#include "trace.h"
+
 VkDevice device = VK_NULL_HANDLE;
 
 VkInstance instance = VK_NULL_HANDLE;
@@ -28,22 +33,76 @@ VkFormat swapchain_image_format = VK_FORMAT_R8G8B8A8_SRGB;
 
 VkExtent2D swapchain_size = {0, 0};
 
-VkSemaphore *image_available_semaphores = NULL,
-            *render_finished_semaphores = NULL;
-VkFence* in_flight_fences = NULL;
+/* one per image, the frame contexts hold the per-frame semaphores and
+ * fences */
+VkSemaphore* render_finished_semaphores = NULL;
 
 uint32_t queue_family_index = 0;
 
+/* queues of their own when the device has a transfer-only family or a
+ * compute family without graphics, otherwise the graphics queue */
+VkQueue transfer_queue = VK_NULL_HANDLE;
+uint32_t transfer_queue_family_index = 0;
+VkQueue compute_queue = VK_NULL_HANDLE;
+uint32_t compute_queue_family_index = 0;
+
 uint32_t swapchain_current_frame = 0;
 uint32_t swapchain_current_image = 0;
 
+/* rendering into offscreen images instead of a swapchain */
+bool vulkan_headless = false;
+
+/* 64-bit integers in shaders, enabled whenever the device has them */
+bool shader_int64_enabled = false;
+
+/* FIFO is the only mode every surface supports */
+static VkPresentModeKHR requested_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+/* acquire or present reported that the swapchain no longer matches the
+ * surface */
+static bool swapchain_out_of_date = false;
+static MemAllocation* offscreen_memory = NULL;
+
 static const char* const instance_extensions[] = {
     VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_XLIB_SURFACE_EXTENSION_NAME};
 static const char* const instance_layers[] = {"VK_LAYER_KHRONOS_validation"};
+/* release builds load no layers unless asked to, they cost startup time
+ * and every call */
+#ifdef NDEBUG
+static bool validation_requested = false;
+#else
+static bool validation_requested = true;
+#endif
+/* requested and installed, the device gets the same layers */
+static bool validation_enabled = false;
 static const char* const device_extensions[] = {
     VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME};
 
+void VulkanSetValidation(bool enabled) { validation_requested = enabled; }
+
+static bool ValidationLayerInstalled(void) {
+  uint32_t layer_count = 0;
+  vkEnumerateInstanceLayerProperties(&layer_count, NULL);
+  VkLayerProperties* layers =
+      (VkLayerProperties*)malloc(sizeof(VkLayerProperties) * layer_count);
+  if (layers == NULL) {
+    return false;
+  }
+  vkEnumerateInstanceLayerProperties(&layer_count, layers);
+  bool installed = false;
+  for (uint32_t i = 0; i < layer_count; i++) {
+    installed |= 0 == strcmp(layers[i].layerName, instance_layers[0]);
+  }
+  free(layers);
+  return installed;
+}
+
 static int InitializeInstance(void) {
+  validation_enabled = validation_requested && ValidationLayerInstalled();
+  if (validation_requested && !validation_enabled) {
+    fprintf(stderr, "%s is not installed, running without validation\n",
+            instance_layers[0]);
+  }
+
   VkApplicationInfo app_info = {};
   app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
   app_info.apiVersion = VK_API_VERSION_1_3;
@@ -55,12 +114,16 @@ static int InitializeInstance(void) {
   VkInstanceCreateInfo create_info = {};
   create_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
   create_info.pApplicationInfo = &app_info;
-  create_info.enabledExtensionCount =
-      sizeof(instance_extensions) / sizeof(instance_extensions[0]);
-  create_info.ppEnabledExtensionNames = instance_extensions;
-  create_info.enabledLayerCount =
-      sizeof(instance_layers) / sizeof(instance_layers[0]);
-  create_info.ppEnabledLayerNames = instance_layers;
+  if (!vulkan_headless) {
+    create_info.enabledExtensionCount =
+        sizeof(instance_extensions) / sizeof(instance_extensions[0]);
+    create_info.ppEnabledExtensionNames = instance_extensions;
+  }
+  if (validation_enabled) {
+    create_info.enabledLayerCount =
+        sizeof(instance_layers) / sizeof(instance_layers[0]);
+    create_info.ppEnabledLayerNames = instance_layers;
+  }
 
   if (vkCreateInstance(&create_info, VK_NULL_HANDLE, &instance) != VK_SUCCESS) {
     fprintf(stderr, "Failed to create Vulkan instance\n");
@@ -70,6 +133,33 @@ static int InitializeInstance(void) {
   return 0;
 }
 
+/* Transfers go to a family with neither graphics nor compute, the copy
+ * engines, and compute to one without graphics, which runs alongside the
+ * graphics queue. Either falls back to the graphics family */
+static void FindDedicatedQueueFamilies(const VkQueueFamilyProperties* families,
+                                       uint32_t count) {
+  transfer_queue_family_index = queue_family_index;
+  compute_queue_family_index = queue_family_index;
+  bool found_transfer = false, found_compute = false;
+  for (uint32_t i = 0; i < count; i++) {
+    VkQueueFlags flags = families[i].queueFlags;
+    if (families[i].queueCount == 0 || (flags & VK_QUEUE_GRAPHICS_BIT)) {
+      continue;
+    }
+    if (!found_compute && (flags & VK_QUEUE_COMPUTE_BIT)) {
+      compute_queue_family_index = i;
+      found_compute = true;
+    } else if (!found_transfer && (flags & VK_QUEUE_TRANSFER_BIT) &&
+               !(flags & VK_QUEUE_COMPUTE_BIT)) {
+      transfer_queue_family_index = i;
+      found_transfer = true;
+    }
+  }
+  printf("Queue families: graphics %u, transfer %u, compute %u\n",
+         queue_family_index, transfer_queue_family_index,
+         compute_queue_family_index);
+}
+
 static int FindCompatiblePhysicalDevice(void) {
   uint32_t device_count = 0;
   vkEnumeratePhysicalDevices(instance, &device_count, VK_NULL_HANDLE);
@@ -102,7 +192,7 @@ static int FindCompatiblePhysicalDevice(void) {
         (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
 
     for (uint32_t j = 0; j < queue_family_count; j++) {
-      if ((queue_families[j].queueFlags & required_flags == required_flags) &&
+      if ((queue_families[j].queueFlags & required_flags) == required_flags &&
           queue_families[j].queueCount > 0) {
         queue_family_index = j;
 
@@ -113,6 +203,9 @@ static int FindCompatiblePhysicalDevice(void) {
         break;
       }
     }
+    if (found_compatible_device) {
+      FindDedicatedQueueFamilies(queue_families, queue_family_count);
+    }
 
     free(queue_families);
   }
@@ -123,33 +216,59 @@ static int FindCompatiblePhysicalDevice(void) {
 }
 
 static int CreateDevice(void) {
-  VkDeviceQueueCreateInfo queue_create_info = {};
-
-  queue_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
-  queue_create_info.queueFamilyIndex = queue_family_index;
+  /* one queue per distinct family */
+  const uint32_t families[] = {queue_family_index,
+                               transfer_queue_family_index,
+                               compute_queue_family_index};
+  VkDeviceQueueCreateInfo queue_create_infos[3] = {};
+  uint32_t queue_create_info_count = 0;
   float queue_priority = 1.0f;
-  queue_create_info.pQueuePriorities = &queue_priority;
-  queue_create_info.queueCount = 1;
+  for (uint32_t i = 0; i < 3; i++) {
+    bool created = false;
+    for (uint32_t j = 0; j < queue_create_info_count; j++) {
+      created |= queue_create_infos[j].queueFamilyIndex == families[i];
+    }
+    if (created) {
+      continue;
+    }
+    VkDeviceQueueCreateInfo* info =
+        &queue_create_infos[queue_create_info_count++];
+    info->sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    info->queueFamilyIndex = families[i];
+    info->pQueuePriorities = &queue_priority;
+    info->queueCount = 1;
+  }
 
   VkDeviceCreateInfo create_info = {};
   create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
   create_info.enabledExtensionCount =
       sizeof(device_extensions) / sizeof(device_extensions[0]);
   create_info.ppEnabledExtensionNames = device_extensions;
+  /* the swapchain extension comes first */
+  if (vulkan_headless) {
+    create_info.enabledExtensionCount--;
+    create_info.ppEnabledExtensionNames++;
+  }
 
-  create_info.enabledLayerCount =
-      sizeof(instance_layers) / sizeof(instance_layers[0]);
-  create_info.ppEnabledLayerNames = instance_layers;
+  if (validation_enabled) {
+    create_info.enabledLayerCount =
+        sizeof(instance_layers) / sizeof(instance_layers[0]);
+    create_info.ppEnabledLayerNames = instance_layers;
+  }
 
-  create_info.queueCreateInfoCount = 1;
-  create_info.pQueueCreateInfos = &queue_create_info;
+  create_info.queueCreateInfoCount = queue_create_info_count;
+  create_info.pQueueCreateInfos = queue_create_infos;
 
   VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering = {};
   dynamic_rendering.dynamicRendering = true;
   dynamic_rendering.sType =
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
 
+  /* the compute generator does its hashing in 64-bit integers */
+  VkPhysicalDeviceFeatures supported_features = {};
+  vkGetPhysicalDeviceFeatures(physical_device, &supported_features);
   VkPhysicalDeviceFeatures device_features = {};
+  device_features.shaderInt64 = supported_features.shaderInt64;
   create_info.pEnabledFeatures = &device_features;
   create_info.pNext = &dynamic_rendering;
 
@@ -157,34 +276,24 @@ static int CreateDevice(void) {
       VK_SUCCESS) {
     return -1;
   }
+  shader_int64_enabled = device_features.shaderInt64;
 
   vkGetDeviceQueue(device, queue_family_index, 0, &graphics_queue);
+  vkGetDeviceQueue(device, transfer_queue_family_index, 0, &transfer_queue);
+  vkGetDeviceQueue(device, compute_queue_family_index, 0, &compute_queue);
 
   return 0;
 }
 
-static int CreateSwapchainSemaphores(void) {
-  image_available_semaphores =
-      (VkSemaphore*)malloc(sizeof(VkSemaphore) * swapchain_frame_count);
+/* one per image, the image count changes with the swapchain */
+static int CreateRenderFinishedSemaphores(void) {
   render_finished_semaphores =
-      (VkSemaphore*)malloc(sizeof(VkSemaphore) * swapchain_image_count);
-
-  in_flight_fences = (VkFence*)malloc(sizeof(VkFence) * swapchain_frame_count);
+      (VkSemaphore*)calloc(swapchain_image_count, sizeof(VkSemaphore));
+  if (render_finished_semaphores == NULL) {
+    return -1;
+  }
   VkSemaphoreCreateInfo create_info = {};
   create_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-  VkFenceCreateInfo fence_create_info = {};
-  fence_create_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-  fence_create_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-  for (uint32_t i = 0; i < swapchain_frame_count; i++) {
-    if (vkCreateSemaphore(device, &create_info, VK_NULL_HANDLE,
-                          &image_available_semaphores[i]) != VK_SUCCESS ||
-        vkCreateFence(device, &fence_create_info, VK_NULL_HANDLE,
-                      &in_flight_fences[i])) {
-      fprintf(stderr, "Failed to create image semaphores %d \n", i);
-      return -1;
-    }
-  }
   for (uint32_t i = 0; i < swapchain_image_count; i++) {
     if (vkCreateSemaphore(device, &create_info, VK_NULL_HANDLE,
                           &render_finished_semaphores[i]) != VK_SUCCESS) {
@@ -192,10 +301,23 @@ static int CreateSwapchainSemaphores(void) {
       return -1;
     }
   }
-
   return 0;
 }
 
+static void DestroyRenderFinishedSemaphores(void) {
+  if (render_finished_semaphores != NULL) {
+    for (uint32_t i = 0; i < swapchain_image_count; i++) {
+      if (render_finished_semaphores[i] != VK_NULL_HANDLE) {
+        vkDestroySemaphore(device, render_finished_semaphores[i],
+                           VK_NULL_HANDLE);
+      }
+    }
+    free(render_finished_semaphores);
+    render_finished_semaphores = NULL;
+  }
+}
+
+
 static int CreateSwapchainImageViews(void) {
   swapchain_image_views =
       (VkImageView*)malloc(sizeof(VkImageView) * swapchain_image_count);
@@ -223,37 +345,6 @@ static int CreateSwapchainImageViews(void) {
   return 0;
 }
 
-static void DestroySwapchainSemaphores(void) {
-  if (image_available_semaphores != NULL) {
-    for (uint32_t i = 0; i < swapchain_frame_count; i++) {
-      if (image_available_semaphores[i] != VK_NULL_HANDLE) {
-        vkDestroySemaphore(device, image_available_semaphores[i],
-                           VK_NULL_HANDLE);
-      }
-    }
-    free(image_available_semaphores);
-    image_available_semaphores = NULL;
-  }
-  if (render_finished_semaphores != NULL) {
-    for (uint32_t i = 0; i < swapchain_image_count; i++) {
-      if (render_finished_semaphores[i] != VK_NULL_HANDLE) {
-        vkDestroySemaphore(device, render_finished_semaphores[i],
-                           VK_NULL_HANDLE);
-      }
-    }
-    free(render_finished_semaphores);
-    render_finished_semaphores = NULL;
-  }
-  if (in_flight_fences != NULL) {
-    for (uint32_t i = 0; i < swapchain_frame_count; i++) {
-      if (in_flight_fences[i] != VK_NULL_HANDLE) {
-        vkDestroyFence(device, in_flight_fences[i], VK_NULL_HANDLE);
-      }
-    }
-    free(in_flight_fences);
-    in_flight_fences = NULL;
-  }
-}
 static void DestroySwapchainImageViews(void) {
   if (swapchain_image_views != NULL) {
     for (uint32_t i = 0; i < swapchain_image_count; i++) {
@@ -267,7 +358,19 @@ static void DestroySwapchainImageViews(void) {
 }
 
 static void DestroySwapchain(void) {
+  /* offscreen images are owned by us, swapchain images by the swapchain */
+  if (offscreen_memory != NULL) {
+    for (uint32_t i = 0; i < swapchain_image_count; i++) {
+      if (swapchain_images != NULL && swapchain_images[i] != VK_NULL_HANDLE) {
+        vkDestroyImage(device, swapchain_images[i], VK_NULL_HANDLE);
+      }
+      FreeMemory(&offscreen_memory[i]);
+    }
+    free(offscreen_memory);
+    offscreen_memory = NULL;
+  }
   free(swapchain_images);
+  swapchain_images = NULL;
   if (swapchain != VK_NULL_HANDLE) {
     vkDestroySwapchainKHR(device, swapchain, VK_NULL_HANDLE);
     swapchain = VK_NULL_HANDLE;
@@ -296,15 +399,17 @@ static void DestroyInstance(void) {
 }
 
 void VulkanCleanup(void) {
-  DestroySwapchainSemaphores();
+  DestroyRenderFinishedSemaphores();
   DestroySwapchainImageViews();
   DestroySwapchain();
   DestroySurface();
+  MemDestroy();
   DestroyDevice();
   DestroyInstance();
 }
 
-int VulkanInitialize(void) {
+int VulkanInitialize(bool headless) {
+  vulkan_headless = headless;
   if (0 != InitializeInstance()) {
     return -1;
   }
@@ -333,7 +438,38 @@ int VulkanCreateSurface(void* window) {
   return 0;
 }
 
-int VulkanCreateSwapchain(uint32_t width, uint32_t height) {
+void VulkanSetPresentMode(VkPresentModeKHR mode) {
+  requested_present_mode = mode;
+}
+
+/* the requested present mode if the surface supports it, FIFO otherwise */
+static VkPresentModeKHR ChoosePresentMode(void) {
+  uint32_t mode_count = 0;
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface,
+                                            &mode_count, NULL);
+  VkPresentModeKHR* modes =
+      (VkPresentModeKHR*)malloc(sizeof(VkPresentModeKHR) * mode_count);
+  if (modes == NULL) {
+    return VK_PRESENT_MODE_FIFO_KHR;
+  }
+  vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device, surface,
+                                            &mode_count, modes);
+  bool supported = false;
+  for (uint32_t i = 0; i < mode_count; i++) {
+    supported |= modes[i] == requested_present_mode;
+  }
+  free(modes);
+  if (!supported) {
+    fprintf(stderr, "present mode %d is not supported, using FIFO\n",
+            requested_present_mode);
+    requested_present_mode = VK_PRESENT_MODE_FIFO_KHR;
+  }
+  return requested_present_mode;
+}
+
+/* the swapchain and its images, replacing the current swapchain if there
+ * is one */
+static int CreateSwapchain(uint32_t width, uint32_t height) {
   VkSwapchainCreateInfoKHR create_info = {};
   create_info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
   create_info.surface = surface;
@@ -350,7 +486,8 @@ int VulkanCreateSwapchain(uint32_t width, uint32_t height) {
   vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device, surface, &format_count,
                                        surface_formats);
 
-  uint32_t required_image_count = 4;
+  /* an image for every frame in flight plus the one being shown */
+  uint32_t required_image_count = SDL_max(4u, swapchain_frame_count + 1);
   if (surface_capabilites.minImageCount > 0) {
     required_image_count =
         SDL_max(required_image_count, surface_capabilites.minImageCount);
@@ -360,8 +497,6 @@ int VulkanCreateSwapchain(uint32_t width, uint32_t height) {
         SDL_min(required_image_count, surface_capabilites.maxImageCount);
   }
 
-  swapchain_frame_count = 2;
-
   bool found_surface_format = false;
   for (uint32_t i = 0; i < format_count; i++) {
     if (surface_formats[i].format == VK_FORMAT_B8G8R8A8_SRGB &&
@@ -382,12 +517,17 @@ int VulkanCreateSwapchain(uint32_t width, uint32_t height) {
 
   create_info.minImageCount = required_image_count;
 
-  create_info.imageExtent.width =
-      SDL_clamp(width, surface_capabilites.minImageExtent.width,
-                surface_capabilites.maxImageExtent.width);
-  create_info.imageExtent.height =
-      SDL_clamp(height, surface_capabilites.minImageExtent.height,
-                surface_capabilites.maxImageExtent.height);
+  /* the surface dictates the size unless it reports the special value */
+  if (surface_capabilites.currentExtent.width != UINT32_MAX) {
+    create_info.imageExtent = surface_capabilites.currentExtent;
+  } else {
+    create_info.imageExtent.width =
+        SDL_clamp(width, surface_capabilites.minImageExtent.width,
+                  surface_capabilites.maxImageExtent.width);
+    create_info.imageExtent.height =
+        SDL_clamp(height, surface_capabilites.minImageExtent.height,
+                  surface_capabilites.maxImageExtent.height);
+  }
 
   swapchain_size = create_info.imageExtent;
 
@@ -396,46 +536,149 @@ int VulkanCreateSwapchain(uint32_t width, uint32_t height) {
 
   create_info.preTransform = surface_capabilites.currentTransform;
   create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-  create_info.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+  create_info.presentMode = ChoosePresentMode();
   create_info.clipped = VK_TRUE;
   create_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  create_info.oldSwapchain = swapchain;
 
-  if (vkCreateSwapchainKHR(device, &create_info, NULL, &swapchain) !=
-      VK_SUCCESS) {
+  VkSwapchainKHR new_swapchain = VK_NULL_HANDLE;
+  VkResult result =
+      vkCreateSwapchainKHR(device, &create_info, NULL, &new_swapchain);
+  /* retired either way */
+  DestroySwapchain();
+  if (result != VK_SUCCESS) {
+    fprintf(stderr, "Failed to create the swapchain %d\n", result);
     return -1;
   }
+  swapchain = new_swapchain;
+  swapchain_out_of_date = false;
 
   vkGetSwapchainImagesKHR(device, swapchain, &swapchain_image_count, NULL);
   swapchain_images = (VkImage*)malloc(sizeof(VkImage) * swapchain_image_count);
   vkGetSwapchainImagesKHR(device, swapchain, &swapchain_image_count,
                           swapchain_images);
+  return 0;
+}
 
-  CreateSwapchainImageViews();
-  CreateSwapchainSemaphores();
+int VulkanCreateSwapchain(uint32_t width, uint32_t height) {
+  swapchain_frame_count = FrameInFlight();
+  if (0 != CreateSwapchain(width, height) ||
+      0 != CreateSwapchainImageViews() ||
+      0 != CreateRenderFinishedSemaphores()) {
+    return -1;
+  }
+  return 0;
+}
 
+int VulkanRecreateSwapchain(uint32_t width, uint32_t height) {
+  /* the old images may still be rendered to or presented */
+  vkDeviceWaitIdle(device);
+  DestroySwapchainImageViews();
+  DestroyRenderFinishedSemaphores();
+  if (0 != CreateSwapchain(width, height) ||
+      0 != CreateSwapchainImageViews() ||
+      0 != CreateRenderFinishedSemaphores()) {
+    return -1;
+  }
+  printf("swapchain recreated at %ux%u\n", swapchain_size.width,
+         swapchain_size.height);
+  return 0;
+}
+
+bool VulkanSwapchainOutOfDate(void) { return swapchain_out_of_date; }
+
+int VulkanCreateOffscreen(uint32_t width, uint32_t height) {
+  swapchain_frame_count = FrameInFlight();
+  swapchain_image_count = swapchain_frame_count;
+  swapchain_image_format = VK_FORMAT_R8G8B8A8_UNORM;
+  swapchain_size.width = width;
+  swapchain_size.height = height;
+
+  swapchain_images =
+      (VkImage*)calloc(swapchain_image_count, sizeof(VkImage));
+  offscreen_memory = (MemAllocation*)calloc(swapchain_image_count,
+                                            sizeof(MemAllocation));
+  if (swapchain_images == NULL || offscreen_memory == NULL) {
+    return -1;
+  }
+  VkImageCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+  create_info.imageType = VK_IMAGE_TYPE_2D;
+  create_info.format = swapchain_image_format;
+  create_info.extent.width = width;
+  create_info.extent.height = height;
+  create_info.extent.depth = 1;
+  create_info.mipLevels = 1;
+  create_info.arrayLayers = 1;
+  create_info.samples = VK_SAMPLE_COUNT_1_BIT;
+  create_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+  /* transfer source so a frame can be read back */
+  create_info.usage =
+      VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  create_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  for (uint32_t i = 0; i < swapchain_image_count; i++) {
+    if (VK_SUCCESS != vkCreateImage(device, &create_info, VK_NULL_HANDLE,
+                                    &swapchain_images[i])) {
+      fprintf(stderr, "Failed to create offscreen image %u\n", i);
+      return -1;
+    }
+  }
+  if (0 != AllocateImagesMemory(swapchain_images, swapchain_image_count,
+                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                offscreen_memory)) {
+    fprintf(stderr, "Failed to allocate offscreen images\n");
+    return -1;
+  }
+
+  if (0 != CreateSwapchainImageViews() ||
+      0 != CreateRenderFinishedSemaphores()) {
+    return -1;
+  }
   return 0;
 }
 
 int VulkanSCAcquireImage(void) {
   /* wait for the previous submission on this frame */
-  vkWaitForFences(device, 1, &in_flight_fences[swapchain_current_frame],
-                  VK_TRUE, UINT64_MAX);
-  vkResetFences(device, 1, &in_flight_fences[swapchain_current_frame]);
-
-  if (VK_SUCCESS !=
-      vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
-                            image_available_semaphores[swapchain_current_frame],
-                            VK_NULL_HANDLE, &swapchain_current_image)) {
+  FrameWait();
+  FrameContext* frame = FrameCurrent();
+
+  /* every frame in flight has its own offscreen image */
+  if (vulkan_headless) {
+    vkResetFences(device, 1, &frame->in_flight);
+    swapchain_current_image = swapchain_current_frame;
+    return swapchain_current_image;
+  }
+
+  VkResult res = vkAcquireNextImageKHR(device, swapchain, UINT64_MAX,
+                                       frame->image_available, VK_NULL_HANDLE,
+                                       &swapchain_current_image);
+  if (VK_ERROR_OUT_OF_DATE_KHR == res) {
+    /* nothing was acquired, the fence stays signaled for the retry */
+    swapchain_out_of_date = true;
+    return VULKAN_SWAPCHAIN_OUT_OF_DATE;
+  }
+  if (VK_SUBOPTIMAL_KHR == res) {
+    /* still presentable, recreated after this frame */
+    swapchain_out_of_date = true;
+  } else if (VK_SUCCESS != res) {
+    fprintf(stderr, "failed to acquire an image %d\n", res);
     return -1;
   }
+  vkResetFences(device, 1, &frame->in_flight);
 
-  printf("ACQUIRE image %d at frame %d \n", swapchain_current_image,
-         swapchain_current_frame);
+  TRACE_INSTANT("acquire_image", swapchain_current_image);
 
   return swapchain_current_image;
 }
 
 int VulkanSCPresent(void) {
+  if (vulkan_headless) {
+    swapchain_current_frame =
+        (swapchain_current_frame + 1) % swapchain_frame_count;
+    return 0;
+  }
+
   VkPresentInfoKHR present_info = {};
   present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
   present_info.pImageIndices = &swapchain_current_image;
@@ -449,8 +692,10 @@ int VulkanSCPresent(void) {
 
   VkResult res = vkQueuePresentKHR(graphics_queue, &present_info);
   if (VK_SUCCESS != res) {
-    if (VK_SUBOPTIMAL_KHR == res) {
-      fprintf(stderr, "suboptimal present %d \n", res);
+    if (VK_SUBOPTIMAL_KHR == res || VK_ERROR_OUT_OF_DATE_KHR == res) {
+      /* the semaphore wait still happens, only the image is not shown */
+      TRACE_INSTANT("present_out_of_date", res);
+      swapchain_out_of_date = true;
     } else {
       fprintf(stderr, "failed to present %d \n", res);
       return -1;
@@ -462,3 +707,86 @@ int VulkanSCPresent(void) {
 
   return 0;
 }
+
+/* the barrier of both halves of an ownership transfer, which have to agree
+ * on the families and, for images, the layouts */
+static void RecordOwnershipBarrier(VkCommandBuffer cmd, VkBuffer buffer,
+                                   VkImage image, VkImageLayout old_layout,
+                                   VkImageLayout new_layout,
+                                   uint32_t src_family, uint32_t dst_family,
+                                   bool acquire, VkPipelineStageFlags stage,
+                                   VkAccessFlags access) {
+  if (src_family == dst_family) {
+    return;
+  }
+  /* the release makes the writes available, the acquire visible */
+  VkPipelineStageFlags src_stage =
+      acquire ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT : stage;
+  VkPipelineStageFlags dst_stage =
+      acquire ? stage : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+  if (buffer != VK_NULL_HANDLE) {
+    VkBufferMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = acquire ? 0 : access;
+    barrier.dstAccessMask = acquire ? access : 0;
+    barrier.srcQueueFamilyIndex = src_family;
+    barrier.dstQueueFamilyIndex = dst_family;
+    barrier.buffer = buffer;
+    barrier.size = VK_WHOLE_SIZE;
+    vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, NULL, 1, &barrier,
+                         0, NULL);
+    return;
+  }
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = acquire ? 0 : access;
+  barrier.dstAccessMask = acquire ? access : 0;
+  barrier.oldLayout = old_layout;
+  barrier.newLayout = new_layout;
+  barrier.srcQueueFamilyIndex = src_family;
+  barrier.dstQueueFamilyIndex = dst_family;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, NULL, 0, NULL, 1,
+                       &barrier);
+}
+
+void VulkanReleaseBuffer(VkCommandBuffer cmd, VkBuffer buffer,
+                         uint32_t src_family, uint32_t dst_family,
+                         VkPipelineStageFlags src_stage,
+                         VkAccessFlags src_access) {
+  RecordOwnershipBarrier(cmd, buffer, VK_NULL_HANDLE,
+                         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+                         src_family, dst_family, false, src_stage,
+                         src_access);
+}
+
+void VulkanAcquireBuffer(VkCommandBuffer cmd, VkBuffer buffer,
+                         uint32_t src_family, uint32_t dst_family,
+                         VkPipelineStageFlags dst_stage,
+                         VkAccessFlags dst_access) {
+  RecordOwnershipBarrier(cmd, buffer, VK_NULL_HANDLE,
+                         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+                         src_family, dst_family, true, dst_stage, dst_access);
+}
+
+void VulkanReleaseImage(VkCommandBuffer cmd, VkImage image,
+                        VkImageLayout old_layout, VkImageLayout new_layout,
+                        uint32_t src_family, uint32_t dst_family,
+                        VkPipelineStageFlags src_stage,
+                        VkAccessFlags src_access) {
+  RecordOwnershipBarrier(cmd, VK_NULL_HANDLE, image, old_layout, new_layout,
+                         src_family, dst_family, false, src_stage,
+                         src_access);
+}
+
+void VulkanAcquireImage(VkCommandBuffer cmd, VkImage image,
+                        VkImageLayout old_layout, VkImageLayout new_layout,
+                        uint32_t src_family, uint32_t dst_family,
+                        VkPipelineStageFlags dst_stage,
+                        VkAccessFlags dst_access) {
+  RecordOwnershipBarrier(cmd, VK_NULL_HANDLE, image, old_layout, new_layout,
+                         src_family, dst_family, true, dst_stage, dst_access);
+}
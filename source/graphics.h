@@ -2,17 +2,70 @@
 #ifndef GRAPHICS_H_
 #define GRAPHICS_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 #include <vulkan/vulkan.h>
-/* Initialize Vulkan instance, device, and so on */
-int VulkanInitialize(void);
+/* Initialize Vulkan instance, device, and so on. A headless device enables
+ * no surface or swapchain extensions, so it also works on ICDs without a
+ * display */
+int VulkanInitialize(bool headless);
+
+/* whether VulkanInitialize() loads the validation layer, by default only
+ * in builds without NDEBUG. Without the layer installed it runs without */
+void VulkanSetValidation(bool enabled);
+
+/* VulkanSCAcquireImage() could not acquire an image, the swapchain has to
+ * be recreated first */
+#define VULKAN_SWAPCHAIN_OUT_OF_DATE -2
 
 int VulkanCreateSurface(void* window);
+
+/* the present mode of the swapchains created from now on, MAILBOX,
+ * IMMEDIATE or FIFO_RELAXED trade tearing or dropped frames for latency.
+ * Falls back to FIFO when the surface does not support it */
+void VulkanSetPresentMode(VkPresentModeKHR mode);
+
 int VulkanCreateSwapchain(uint32_t width, uint32_t height);
 
+/* replace the swapchain after a resize or once it is out of date, waits
+ * for the device to be idle. Everything sized like the swapchain has to be
+ * recreated as well */
+int VulkanRecreateSwapchain(uint32_t width, uint32_t height);
+
+/* acquire or present found the swapchain no longer matches the surface */
+bool VulkanSwapchainOutOfDate(void);
+
+/* headless stand-in for the swapchain: one color image per frame in
+ * flight that is rendered to and never presented */
+int VulkanCreateOffscreen(uint32_t width, uint32_t height);
+
 int VulkanSCAcquireImage(void);
 int VulkanSCPresent(void);
 
 void VulkanCleanup(void);
 
+/* Queue family ownership transfer of a resource with exclusive sharing:
+ * the release is recorded on the source family, the acquire with the same
+ * families (and layouts) on the destination family once the release has
+ * executed. Images are single-level color images. Nothing is recorded when
+ * the families are the same */
+void VulkanReleaseBuffer(VkCommandBuffer cmd, VkBuffer buffer,
+                         uint32_t src_family, uint32_t dst_family,
+                         VkPipelineStageFlags src_stage,
+                         VkAccessFlags src_access);
+void VulkanAcquireBuffer(VkCommandBuffer cmd, VkBuffer buffer,
+                         uint32_t src_family, uint32_t dst_family,
+                         VkPipelineStageFlags dst_stage,
+                         VkAccessFlags dst_access);
+void VulkanReleaseImage(VkCommandBuffer cmd, VkImage image,
+                        VkImageLayout old_layout, VkImageLayout new_layout,
+                        uint32_t src_family, uint32_t dst_family,
+                        VkPipelineStageFlags src_stage,
+                        VkAccessFlags src_access);
+void VulkanAcquireImage(VkCommandBuffer cmd, VkImage image,
+                        VkImageLayout old_layout, VkImageLayout new_layout,
+                        uint32_t src_family, uint32_t dst_family,
+                        VkPipelineStageFlags dst_stage,
+                        VkAccessFlags dst_access);
+
 #endif  // GRAPHICS_H_
@@ -0,0 +1,694 @@
+
+#include "layout.h"
+
+#include <float.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "rng.h"
+#include "trace.h"
+
+/* bodies per leaf, the leaf loop is a straight pass over sorted arrays */
+#define LAYOUT_LEAF_SIZE 8u
+/* 16 bits per axis in the Morton code */
+#define LAYOUT_MAX_LEVEL 16u
+/* up to 3 siblings stay pushed per level while the 4th is opened */
+#define LAYOUT_STACK_SIZE (4u * (LAYOUT_MAX_LEVEL + 1))
+/* nodes a worker takes from the shared counter at a time */
+#define LAYOUT_CHUNK 4096u
+
+/* per-worker reductions, on separate cache lines */
+typedef struct {
+  _Alignas(64) float min[2];
+  float max[2];
+  double swing;
+  double traction;
+  double movement;
+} LayoutTotals;
+
+typedef void (*LayoutPhase)(Layout* layout, uint32_t begin, uint32_t end,
+                            LayoutTotals* totals);
+
+typedef struct {
+  LayoutWorkers* workers;
+  uint32_t index;
+} LayoutWorker;
+
+/* pool of threads that stays alive for the whole layout, every phase of a
+ * step hands out chunks of nodes from a shared counter */
+struct LayoutWorkers {
+  Layout* layout;
+  pthread_mutex_t mutex;
+  pthread_cond_t start;
+  pthread_cond_t done;
+  pthread_t* threads;
+  LayoutWorker* args;
+  uint32_t thread_count;
+  uint64_t generation;
+  uint32_t running;
+  bool quit;
+
+  LayoutPhase phase;
+  uint32_t item_count;
+  uint32_t next_chunk;
+  /* one per pool thread plus the caller */
+  LayoutTotals* totals;
+
+  /* maps positions onto the 16 bit Morton grid */
+  float origin[2];
+  float grid_scale;
+};
+
+static void LayoutRunChunks(LayoutWorkers* workers, LayoutTotals* totals) {
+  TRACE_BEGIN("layout_chunks");
+  for (;;) {
+    uint32_t chunk =
+        __atomic_fetch_add(&workers->next_chunk, 1u, __ATOMIC_RELAXED);
+    uint64_t begin = (uint64_t)chunk * LAYOUT_CHUNK;
+    if (begin >= workers->item_count) {
+      break;
+    }
+    uint64_t end = begin + LAYOUT_CHUNK;
+    if (end > workers->item_count) {
+      end = workers->item_count;
+    }
+    workers->phase(workers->layout, (uint32_t)begin, (uint32_t)end, totals);
+  }
+  TRACE_END("layout_chunks");
+}
+
+static void* LayoutWorkerMain(void* arg) {
+  LayoutWorker* worker = (LayoutWorker*)arg;
+  LayoutWorkers* workers = worker->workers;
+  uint64_t seen = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&workers->mutex);
+    while (workers->generation == seen && !workers->quit) {
+      pthread_cond_wait(&workers->start, &workers->mutex);
+    }
+    if (workers->quit) {
+      pthread_mutex_unlock(&workers->mutex);
+      break;
+    }
+    seen = workers->generation;
+    pthread_mutex_unlock(&workers->mutex);
+
+    LayoutRunChunks(workers, &workers->totals[worker->index]);
+
+    pthread_mutex_lock(&workers->mutex);
+    if (--workers->running == 0) {
+      pthread_cond_signal(&workers->done);
+    }
+    pthread_mutex_unlock(&workers->mutex);
+  }
+  return NULL;
+}
+
+/* run phase over item_count items on the pool and the calling thread */
+static void LayoutDispatch(Layout* layout, LayoutPhase phase,
+                           uint32_t item_count) {
+  LayoutWorkers* workers = layout->workers;
+  for (uint32_t i = 0; i <= workers->thread_count; i++) {
+    LayoutTotals* totals = &workers->totals[i];
+    totals->min[0] = totals->min[1] = FLT_MAX;
+    totals->max[0] = totals->max[1] = -FLT_MAX;
+    totals->swing = 0.0;
+    totals->traction = 0.0;
+    totals->movement = 0.0;
+  }
+
+  pthread_mutex_lock(&workers->mutex);
+  workers->phase = phase;
+  workers->item_count = item_count;
+  workers->next_chunk = 0;
+  workers->running = workers->thread_count;
+  workers->generation++;
+  pthread_cond_broadcast(&workers->start);
+  pthread_mutex_unlock(&workers->mutex);
+
+  LayoutRunChunks(workers, &workers->totals[workers->thread_count]);
+
+  pthread_mutex_lock(&workers->mutex);
+  while (workers->running != 0) {
+    pthread_cond_wait(&workers->done, &workers->mutex);
+  }
+  pthread_mutex_unlock(&workers->mutex);
+}
+
+static int LayoutStartWorkers(Layout* layout, uint32_t thread_count) {
+  LayoutWorkers* workers =
+      (LayoutWorkers*)calloc(1, sizeof(LayoutWorkers));
+  if (workers == NULL) {
+    return -1;
+  }
+  layout->workers = workers;
+  workers->layout = layout;
+  pthread_mutex_init(&workers->mutex, NULL);
+  pthread_cond_init(&workers->start, NULL);
+  pthread_cond_init(&workers->done, NULL);
+
+  /* the caller is one of the workers */
+  uint32_t pool_size = thread_count - 1;
+  workers->totals = (LayoutTotals*)aligned_alloc(
+      _Alignof(LayoutTotals), sizeof(LayoutTotals) * (pool_size + 1));
+  workers->threads = (pthread_t*)malloc(sizeof(pthread_t) * (pool_size + 1));
+  workers->args =
+      (LayoutWorker*)malloc(sizeof(LayoutWorker) * (pool_size + 1));
+  if (workers->totals == NULL || workers->threads == NULL ||
+      workers->args == NULL) {
+    return -1;
+  }
+  /* a failed thread creation only costs speed, the chunks are handed out
+   * to whoever is running */
+  for (uint32_t i = 0; i < pool_size; i++) {
+    workers->args[i].workers = workers;
+    workers->args[i].index = i;
+    if (0 != pthread_create(&workers->threads[i], NULL, LayoutWorkerMain,
+                            &workers->args[i])) {
+      break;
+    }
+    workers->thread_count++;
+  }
+  return 0;
+}
+
+static void LayoutStopWorkers(Layout* layout) {
+  LayoutWorkers* workers = layout->workers;
+  if (workers == NULL) {
+    return;
+  }
+  pthread_mutex_lock(&workers->mutex);
+  workers->quit = true;
+  pthread_cond_broadcast(&workers->start);
+  pthread_mutex_unlock(&workers->mutex);
+  for (uint32_t i = 0; i < workers->thread_count; i++) {
+    pthread_join(workers->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&workers->done);
+  pthread_cond_destroy(&workers->start);
+  pthread_mutex_destroy(&workers->mutex);
+  free(workers->args);
+  free(workers->threads);
+  free(workers->totals);
+  free(workers);
+  layout->workers = NULL;
+}
+
+void LayoutDefaultOptions(LayoutOptions* options) {
+  options->theta = 1.2f;
+  options->scaling = 2.0f;
+  options->gravity = 1.0f;
+  options->tolerance = 1.0f;
+  options->thread_count = 0;
+  options->seed = 1;
+}
+
+int LayoutCreate(Layout* layout, const Graph* graph,
+                 const LayoutOptions* options) {
+  memset(layout, 0, sizeof(Layout));
+  layout->graph = graph;
+  layout->node_count = graph->node_count;
+  layout->options = *options;
+  layout->speed = 1.0f;
+  layout->speed_efficiency = 1.0f;
+
+  uint32_t n = graph->node_count;
+  layout->positions = (float*)malloc(sizeof(float) * 2 * n);
+  layout->forces = (float*)calloc(2 * (size_t)n, sizeof(float));
+  layout->old_forces = (float*)calloc(2 * (size_t)n, sizeof(float));
+  layout->mass = (float*)malloc(sizeof(float) * n);
+  layout->order = (uint64_t*)malloc(sizeof(uint64_t) * n);
+  layout->order_scratch = (uint64_t*)malloc(sizeof(uint64_t) * n);
+  layout->codes = (uint32_t*)malloc(sizeof(uint32_t) * n);
+  layout->sorted_x = (float*)malloc(sizeof(float) * n);
+  layout->sorted_y = (float*)malloc(sizeof(float) * n);
+  layout->sorted_mass = (float*)malloc(sizeof(float) * n);
+  layout->cell_capacity = 2 * (n / LAYOUT_LEAF_SIZE) + 1024;
+  layout->cells =
+      (LayoutCell*)malloc(sizeof(LayoutCell) * layout->cell_capacity);
+  if (layout->positions == NULL || layout->forces == NULL ||
+      layout->old_forces == NULL || layout->mass == NULL ||
+      layout->order == NULL || layout->order_scratch == NULL ||
+      layout->codes == NULL || layout->sorted_x == NULL ||
+      layout->sorted_y == NULL || layout->sorted_mass == NULL ||
+      layout->cells == NULL) {
+    fprintf(stderr, "failed to allocate the layout of %u nodes\n", n);
+    LayoutDestroy(layout);
+    return -1;
+  }
+
+  uint32_t thread_count = options->thread_count;
+  if (thread_count == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = online > 0 ? (uint32_t)online : 1u;
+  }
+  if (0 != LayoutStartWorkers(layout, thread_count)) {
+    fprintf(stderr, "failed to start the layout workers\n");
+    LayoutDestroy(layout);
+    return -1;
+  }
+
+  /* ForceAtlas2 masses, hubs push harder so leaves do not pile up on
+   * them */
+  LayoutInitialPositions(layout->positions, n, options->seed);
+  for (uint32_t i = 0; i < n; i++) {
+    layout->mass[i] = (float)graph->degree[i] + 1.0f;
+  }
+  return 0;
+}
+
+void LayoutInitialPositions(float* positions, uint32_t node_count,
+                            uint64_t seed) {
+  Rng rng;
+  RngSeed(&rng, seed);
+  float radius = sqrtf((float)node_count);
+  for (uint32_t i = 0; i < node_count; i++) {
+    float x = (float)(2.0 * RngUniformDouble(&rng) - 1.0);
+    float y = (float)(2.0 * RngUniformDouble(&rng) - 1.0);
+    positions[2 * i] = radius * x;
+    positions[2 * i + 1] = radius * y;
+  }
+}
+
+void LayoutDestroy(Layout* layout) {
+  LayoutStopWorkers(layout);
+  free(layout->positions);
+  free(layout->forces);
+  free(layout->old_forces);
+  free(layout->mass);
+  free(layout->order);
+  free(layout->order_scratch);
+  free(layout->codes);
+  free(layout->sorted_x);
+  free(layout->sorted_y);
+  free(layout->sorted_mass);
+  free(layout->cells);
+  memset(layout, 0, sizeof(Layout));
+}
+
+static void LayoutBoundsPhase(Layout* layout, uint32_t begin, uint32_t end,
+                              LayoutTotals* totals) {
+  const float* positions = layout->positions;
+  float min_x = totals->min[0], min_y = totals->min[1];
+  float max_x = totals->max[0], max_y = totals->max[1];
+  for (uint32_t i = begin; i < end; i++) {
+    float x = positions[2 * i];
+    float y = positions[2 * i + 1];
+    min_x = x < min_x ? x : min_x;
+    min_y = y < min_y ? y : min_y;
+    max_x = x > max_x ? x : max_x;
+    max_y = y > max_y ? y : max_y;
+  }
+  totals->min[0] = min_x;
+  totals->min[1] = min_y;
+  totals->max[0] = max_x;
+  totals->max[1] = max_y;
+}
+
+/* spread the low 16 bits to the even bit positions */
+static uint32_t LayoutSpreadBits(uint32_t v) {
+  v &= 0xffffu;
+  v = (v | (v << 8)) & 0x00ff00ffu;
+  v = (v | (v << 4)) & 0x0f0f0f0fu;
+  v = (v | (v << 2)) & 0x33333333u;
+  v = (v | (v << 1)) & 0x55555555u;
+  return v;
+}
+
+static void LayoutCodePhase(Layout* layout, uint32_t begin, uint32_t end,
+                            LayoutTotals* totals) {
+  (void)totals;
+  const LayoutWorkers* workers = layout->workers;
+  const float* positions = layout->positions;
+  for (uint32_t i = begin; i < end; i++) {
+    float gx = (positions[2 * i] - workers->origin[0]) * workers->grid_scale;
+    float gy =
+        (positions[2 * i + 1] - workers->origin[1]) * workers->grid_scale;
+    uint32_t code = LayoutSpreadBits((uint32_t)gx) |
+                    (LayoutSpreadBits((uint32_t)gy) << 1);
+    layout->order[i] = ((uint64_t)code << 32) | i;
+  }
+}
+
+/* LSD radix sort on the code half of the keys, four byte passes leave the
+ * result back in order */
+static void LayoutSortBodies(Layout* layout) {
+  uint64_t* keys = layout->order;
+  uint64_t* scratch = layout->order_scratch;
+  uint32_t n = layout->node_count;
+  for (uint32_t shift = 32; shift < 64; shift += 8) {
+    uint32_t counts[256] = {};
+    for (uint32_t i = 0; i < n; i++) {
+      counts[(keys[i] >> shift) & 0xff]++;
+    }
+    uint32_t offset = 0;
+    for (uint32_t b = 0; b < 256; b++) {
+      uint32_t count = counts[b];
+      counts[b] = offset;
+      offset += count;
+    }
+    for (uint32_t i = 0; i < n; i++) {
+      scratch[counts[(keys[i] >> shift) & 0xff]++] = keys[i];
+    }
+    uint64_t* swap = keys;
+    keys = scratch;
+    scratch = swap;
+  }
+}
+
+static void LayoutGatherPhase(Layout* layout, uint32_t begin, uint32_t end,
+                              LayoutTotals* totals) {
+  (void)totals;
+  for (uint32_t s = begin; s < end; s++) {
+    uint64_t key = layout->order[s];
+    uint32_t node = (uint32_t)key;
+    layout->codes[s] = (uint32_t)(key >> 32);
+    layout->sorted_x[s] = layout->positions[2 * node];
+    layout->sorted_y[s] = layout->positions[2 * node + 1];
+    layout->sorted_mass[s] = layout->mass[node];
+  }
+}
+
+static int64_t LayoutAllocateCells(Layout* layout, uint32_t count) {
+  if (layout->cell_count + count > layout->cell_capacity) {
+    uint32_t capacity = layout->cell_capacity * 2;
+    LayoutCell* cells =
+        (LayoutCell*)realloc(layout->cells, sizeof(LayoutCell) * capacity);
+    if (cells == NULL) {
+      fprintf(stderr, "failed to grow the quadtree to %u cells\n", capacity);
+      return -1;
+    }
+    layout->cells = cells;
+    layout->cell_capacity = capacity;
+  }
+  uint32_t first = layout->cell_count;
+  layout->cell_count += count;
+  return first;
+}
+
+/* first body in [begin, end) whose quadrant digit at shift is >= digit,
+ * the digits are sorted inside a cell */
+static uint32_t LayoutFindQuadrant(const uint32_t* codes, uint32_t begin,
+                                   uint32_t end, uint32_t shift,
+                                   uint32_t digit) {
+  while (begin < end) {
+    uint32_t mid = begin + (end - begin) / 2;
+    if (((codes[mid] >> shift) & 3u) < digit) {
+      begin = mid + 1;
+    } else {
+      end = mid;
+    }
+  }
+  return begin;
+}
+
+/* cell covers the bodies [begin, end), which share the first level digits
+ * of their codes. The cells array may move while children are added, so
+ * cells are only referenced by index. */
+static int LayoutBuildCell(Layout* layout, uint32_t cell, uint32_t begin,
+                           uint32_t end, uint32_t level, float width) {
+  if (end - begin <= LAYOUT_LEAF_SIZE || level == LAYOUT_MAX_LEVEL) {
+    float mass = 0.f, mx = 0.f, my = 0.f;
+    for (uint32_t s = begin; s < end; s++) {
+      mass += layout->sorted_mass[s];
+      mx += layout->sorted_mass[s] * layout->sorted_x[s];
+      my += layout->sorted_mass[s] * layout->sorted_y[s];
+    }
+    LayoutCell* leaf = &layout->cells[cell];
+    leaf->center[0] = mx / mass;
+    leaf->center[1] = my / mass;
+    leaf->mass = mass;
+    leaf->width = width;
+    leaf->first_child = 0;
+    leaf->child_count = 0;
+    leaf->begin = begin;
+    leaf->end = end;
+    return 0;
+  }
+
+  uint32_t shift = 30 - 2 * level;
+  uint32_t bounds[5] = {begin, 0, 0, 0, end};
+  uint32_t child_count = 0;
+  for (uint32_t q = 1; q < 4; q++) {
+    bounds[q] =
+        LayoutFindQuadrant(layout->codes, bounds[q - 1], end, shift, q);
+  }
+  for (uint32_t q = 0; q < 4; q++) {
+    child_count += bounds[q + 1] > bounds[q];
+  }
+  int64_t first = LayoutAllocateCells(layout, child_count);
+  if (first < 0) {
+    return -1;
+  }
+
+  float mass = 0.f, mx = 0.f, my = 0.f;
+  uint32_t child = (uint32_t)first;
+  for (uint32_t q = 0; q < 4; q++) {
+    if (bounds[q + 1] == bounds[q]) {
+      continue;
+    }
+    if (0 != LayoutBuildCell(layout, child, bounds[q], bounds[q + 1],
+                             level + 1, 0.5f * width)) {
+      return -1;
+    }
+    const LayoutCell* built = &layout->cells[child];
+    mass += built->mass;
+    mx += built->mass * built->center[0];
+    my += built->mass * built->center[1];
+    child++;
+  }
+
+  LayoutCell* node = &layout->cells[cell];
+  node->center[0] = mx / mass;
+  node->center[1] = my / mass;
+  node->mass = mass;
+  node->width = width;
+  node->first_child = (uint32_t)first;
+  node->child_count = child_count;
+  node->begin = begin;
+  node->end = end;
+  return 0;
+}
+
+/* repulsion from the quadtree, attraction along the edges and gravity. The
+ * bodies are visited in Morton order so neighbouring bodies walk the same
+ * cells. */
+static void LayoutForcePhase(Layout* layout, uint32_t begin, uint32_t end,
+                             LayoutTotals* totals) {
+  (void)totals;
+  const LayoutCell* cells = layout->cells;
+  const float* sorted_x = layout->sorted_x;
+  const float* sorted_y = layout->sorted_y;
+  const float* sorted_mass = layout->sorted_mass;
+  const float* positions = layout->positions;
+  float theta2 = layout->options.theta * layout->options.theta;
+  float scaling = layout->options.scaling;
+  float gravity = layout->options.gravity;
+  uint32_t stack[LAYOUT_STACK_SIZE];
+
+  for (uint32_t s = begin; s < end; s++) {
+    float x = sorted_x[s];
+    float y = sorted_y[s];
+    float rx = 0.f, ry = 0.f;
+
+    uint32_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+      const LayoutCell* cell = &cells[stack[--top]];
+      if (cell->child_count == 0) {
+        /* the body itself is at distance 0 and contributes nothing */
+        for (uint32_t j = cell->begin; j < cell->end; j++) {
+          float dx = x - sorted_x[j];
+          float dy = y - sorted_y[j];
+          float d2 = dx * dx + dy * dy;
+          float f = d2 > 0.f ? sorted_mass[j] / d2 : 0.f;
+          rx += dx * f;
+          ry += dy * f;
+        }
+        continue;
+      }
+      float dx = x - cell->center[0];
+      float dy = y - cell->center[1];
+      float d2 = dx * dx + dy * dy;
+      if (cell->width * cell->width < theta2 * d2) {
+        float f = cell->mass / d2;
+        rx += dx * f;
+        ry += dy * f;
+      } else {
+        for (uint32_t c = 0; c < cell->child_count; c++) {
+          stack[top++] = cell->first_child + c;
+        }
+      }
+    }
+
+    /* F = scaling * m_i * m_j / d away from the other body */
+    float mass = sorted_mass[s];
+    float fx = scaling * mass * rx;
+    float fy = scaling * mass * ry;
+
+    /* linear springs, F = d towards every neighbor */
+    uint32_t node = (uint32_t)layout->order[s];
+    uint32_t count = 0;
+    const uint32_t* neighbors = GraphNeighbors(layout->graph, node, &count);
+    for (uint32_t k = 0; k < count; k++) {
+      fx += positions[2 * neighbors[k]] - x;
+      fy += positions[2 * neighbors[k] + 1] - y;
+    }
+
+    float distance = sqrtf(x * x + y * y);
+    if (distance > 0.f) {
+      fx -= gravity * mass * x / distance;
+      fy -= gravity * mass * y / distance;
+    }
+
+    layout->forces[2 * node] = fx;
+    layout->forces[2 * node + 1] = fy;
+  }
+}
+
+/* how much every node oscillates (swing) and how consistently it moves
+ * (traction), the global speed is derived from their ratio */
+static void LayoutSwingPhase(Layout* layout, uint32_t begin, uint32_t end,
+                             LayoutTotals* totals) {
+  const float* forces = layout->forces;
+  const float* old_forces = layout->old_forces;
+  double swing = 0.0, traction = 0.0;
+  for (uint32_t i = begin; i < end; i++) {
+    float fx = forces[2 * i], fy = forces[2 * i + 1];
+    float ox = old_forces[2 * i], oy = old_forces[2 * i + 1];
+    float sx = fx - ox, sy = fy - oy;
+    float tx = fx + ox, ty = fy + oy;
+    swing += layout->mass[i] * sqrtf(sx * sx + sy * sy);
+    traction += 0.5f * layout->mass[i] * sqrtf(tx * tx + ty * ty);
+  }
+  totals->swing += swing;
+  totals->traction += traction;
+}
+
+static void LayoutMovePhase(Layout* layout, uint32_t begin, uint32_t end,
+                            LayoutTotals* totals) {
+  float speed = layout->speed;
+  float* positions = layout->positions;
+  float* forces = layout->forces;
+  float* old_forces = layout->old_forces;
+  double movement = 0.0;
+  for (uint32_t i = begin; i < end; i++) {
+    float fx = forces[2 * i], fy = forces[2 * i + 1];
+    float sx = fx - old_forces[2 * i], sy = fy - old_forces[2 * i + 1];
+    float swing = layout->mass[i] * sqrtf(sx * sx + sy * sy);
+    /* nodes that swing slow down on their own */
+    float factor = speed / (1.0f + sqrtf(speed * swing));
+    positions[2 * i] += fx * factor;
+    positions[2 * i + 1] += fy * factor;
+    movement += factor * sqrtf(fx * fx + fy * fy);
+    old_forces[2 * i] = fx;
+    old_forces[2 * i + 1] = fy;
+  }
+  totals->movement += movement;
+}
+
+/* ForceAtlas2 adaptive speed: raise it while the nodes move consistently,
+ * cut it when they start to oscillate */
+static void LayoutAdaptSpeed(Layout* layout, double swing, double traction) {
+  const float min_speed_efficiency = 0.05f;
+  const float max_rise = 0.5f;
+  double n = (double)layout->node_count;
+  double estimated_jitter = 0.05 * sqrt(n);
+  double min_jitter = sqrt(estimated_jitter);
+  double jitter = estimated_jitter * traction / (n * n);
+  jitter = jitter < 10.0 ? jitter : 10.0;
+  jitter = jitter > min_jitter ? jitter : min_jitter;
+  jitter *= layout->options.tolerance;
+
+  if (swing > 0.0 && traction / swing > 2.0) {
+    if (layout->speed_efficiency > min_speed_efficiency) {
+      layout->speed_efficiency *= 0.5f;
+    }
+    if (jitter < layout->options.tolerance) {
+      jitter = layout->options.tolerance;
+    }
+  }
+
+  double target = layout->speed;
+  if (swing > 0.0) {
+    target = jitter * layout->speed_efficiency * traction / swing;
+  }
+  if (swing > jitter * traction) {
+    if (layout->speed_efficiency > min_speed_efficiency) {
+      layout->speed_efficiency *= 0.7f;
+    }
+  } else if (layout->speed < 1000.f) {
+    layout->speed_efficiency *= 1.3f;
+  }
+
+  double rise = target - layout->speed;
+  if (rise > max_rise * layout->speed) {
+    rise = max_rise * layout->speed;
+  }
+  layout->speed += (float)rise;
+}
+
+float LayoutStep(Layout* layout) {
+  uint32_t n = layout->node_count;
+  if (n < 2) {
+    return 0.f;
+  }
+  LayoutWorkers* workers = layout->workers;
+  uint32_t total_count = workers->thread_count + 1;
+
+  LayoutDispatch(layout, LayoutBoundsPhase, n);
+  layout->min[0] = layout->min[1] = FLT_MAX;
+  layout->max[0] = layout->max[1] = -FLT_MAX;
+  for (uint32_t t = 0; t < total_count; t++) {
+    for (uint32_t a = 0; a < 2; a++) {
+      float low = workers->totals[t].min[a];
+      float high = workers->totals[t].max[a];
+      layout->min[a] = low < layout->min[a] ? low : layout->min[a];
+      layout->max[a] = high > layout->max[a] ? high : layout->max[a];
+    }
+  }
+  float extent = layout->max[0] - layout->min[0];
+  if (layout->max[1] - layout->min[1] > extent) {
+    extent = layout->max[1] - layout->min[1];
+  }
+  if (extent < FLT_MIN) {
+    extent = 1.0f;
+  }
+  /* the quadtree works on a square, codes stay below 2^16 per axis */
+  workers->origin[0] = layout->min[0];
+  workers->origin[1] = layout->min[1];
+  workers->grid_scale = 65535.0f / extent;
+
+  LayoutDispatch(layout, LayoutCodePhase, n);
+  LayoutSortBodies(layout);
+  LayoutDispatch(layout, LayoutGatherPhase, n);
+
+  layout->cell_count = 0;
+  if (0 > LayoutAllocateCells(layout, 1) ||
+      0 != LayoutBuildCell(layout, 0, 0, n, 0, extent)) {
+    return -1.f;
+  }
+
+  LayoutDispatch(layout, LayoutForcePhase, n);
+  LayoutDispatch(layout, LayoutSwingPhase, n);
+  double swing = 0.0, traction = 0.0;
+  for (uint32_t t = 0; t < total_count; t++) {
+    swing += workers->totals[t].swing;
+    traction += workers->totals[t].traction;
+  }
+  LayoutAdaptSpeed(layout, swing, traction);
+
+  LayoutDispatch(layout, LayoutMovePhase, n);
+  double movement = 0.0;
+  for (uint32_t t = 0; t < total_count; t++) {
+    movement += workers->totals[t].movement;
+  }
+  layout->iteration++;
+  return (float)(movement / n / extent);
+}
@@ -0,0 +1,96 @@
+#ifndef LAYOUT_H_
+#define LAYOUT_H_
+
+#include <stdint.h>
+
+#include "graph.h"
+
+typedef struct {
+  /* Barnes–Hut opening criterion, a cell is approximated when its width is
+   * below theta times its distance. 0 gives the exact O(n^2) forces */
+  float theta;
+  /* repulsion strength */
+  float scaling;
+  /* pull towards the origin, keeps disconnected parts together */
+  float gravity;
+  /* how much swinging the adaptive speed tolerates, lower is more precise
+   * but slower to converge */
+  float tolerance;
+  /* worker threads including the caller, 0 uses every online core */
+  uint32_t thread_count;
+  /* seed of the initial positions */
+  uint64_t seed;
+} LayoutOptions;
+
+/* one Barnes–Hut quadtree cell, children are stored contiguously */
+typedef struct {
+  float center[2];
+  float mass;
+  float width;
+  uint32_t first_child;
+  uint32_t child_count;
+  /* bodies of the cell, a range of the Morton-sorted arrays */
+  uint32_t begin;
+  uint32_t end;
+} LayoutCell;
+
+typedef struct LayoutWorkers LayoutWorkers;
+
+/* ForceAtlas2-style layout: degree-weighted repulsion approximated with a
+ * Barnes–Hut quadtree, linear attraction along the edges, gravity and the
+ * adaptive global speed of ForceAtlas2. Every per-node attribute is its own
+ * array; the vectors (positions, forces) interleave x and y within it. */
+typedef struct {
+  const Graph* graph;
+  uint32_t node_count;
+  LayoutOptions options;
+
+  /* x, y interleaved per node, in node order: the layout of the GPU node
+   * buffer, so the renderer uploads it as it is */
+  float* positions;
+  float* forces;
+  float* old_forces;
+  float* mass;
+
+  /* bounding box of the positions before the last step */
+  float min[2];
+  float max[2];
+
+  /* bodies sorted by Morton code, (code << 32) | node */
+  uint64_t* order;
+  uint64_t* order_scratch;
+  uint32_t* codes;
+  float* sorted_x;
+  float* sorted_y;
+  float* sorted_mass;
+
+  LayoutCell* cells;
+  uint32_t cell_count;
+  uint32_t cell_capacity;
+
+  float speed;
+  float speed_efficiency;
+  uint32_t iteration;
+
+  LayoutWorkers* workers;
+} Layout;
+
+void LayoutDefaultOptions(LayoutOptions* options);
+
+/* lay out the nodes of graph, which has to stay alive and unchanged while
+ * the layout is used. The nodes start at random positions. */
+int LayoutCreate(Layout* layout, const Graph* graph,
+                 const LayoutOptions* options);
+
+void LayoutDestroy(Layout* layout);
+
+/* uniform random positions in a square whose area grows with the node
+ * count, the start of every layout */
+void LayoutInitialPositions(float* positions, uint32_t node_count,
+                            uint64_t seed);
+
+/* run one iteration, returns the mean node movement relative to the size
+ * of the layout or a negative value on failure */
+float LayoutStep(Layout* layout);
+
+#endif  // LAYOUT_H_
@@ -1,12 +1,32 @@
 
 
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>  // For setenv
+#include <string.h>
+#include <time.h>
 
+#include "analysis.h"
+#include "compute.h"
+#include "frame.h"
+#include "graph.h"
+#include "graph_file.h"
+#include "graph_renderer.h"
 #include "graphics.h"
+#include "layout.h"
+#include "mem.h"
+#include "pipeline.h"
+#include "record.h"
 #include "renderer.h"
+#include "timing.h"
+#include "trace.h"
 #include "window.h"
 
+/* largest distance between a node's positions after --layout-check's
+ * steps on the CPU and GPU, relative to the size of the layout */
+#define LAYOUT_CHECK_TOLERANCE 0.01f
+
 #define CHECK_RESULT(x, msg)   \
   if (0 > x) {                 \
     fprintf(stderr, msg "\n"); \
@@ -14,44 +34,982 @@
     return -1;                 \
   }
 
+/* --grow state, the graph gains nodes_per_frame nodes every frame */
+static Graph grow_graph;
+static GraphGrowth grow_state;
+static float* grow_positions;
+static uint32_t grow_nodes_per_frame;
+
+/* --view state, a graph file that is laid out while it is drawn */
+static Graph view_graph;
+static Layout view_layout;
+static uint32_t* view_edges;
+static uint64_t view_edge_count;
+/* the layout steps on a thread of its own and hands finished positions
+ * over through two buffers: the renderer reads view_positions[view_front],
+ * the thread fills the other one while view_fresh is false. The bounds are
+ * (min x, min y, max x, max y) of the same step */
+static pthread_t view_thread;
+static bool view_thread_running;
+static pthread_mutex_t view_mutex = PTHREAD_MUTEX_INITIALIZER;
+static float* view_positions[2];
+static float view_bounds[2][4];
+static uint32_t view_front;
+static bool view_fresh;
+static bool view_quit;
+static int view_result;
+/* --view-gpu, the same with the layout in a compute shader */
+static ComputeLayout view_gpu_layout;
+static float* view_gpu_positions;
+
+/* wait for the step in progress, at most one */
+static void StopViewLayout(void) {
+  if (!view_thread_running) {
+    return;
+  }
+  pthread_mutex_lock(&view_mutex);
+  view_quit = true;
+  pthread_mutex_unlock(&view_mutex);
+  pthread_join(view_thread, NULL);
+  view_thread_running = false;
+}
+
 static void Cleanup(void) {
+  StopViewLayout();
   DestroyRenderer();
+  DestroyGraphRenderer();
+  ComputeDestroyLayout(&view_gpu_layout);
+  TimingDestroy();
+  free(view_gpu_positions);
+  view_gpu_positions = NULL;
+  if (grow_state.graph != NULL) {
+    GenerateEnd(&grow_state);
+  }
+  GraphDestroy(&grow_graph);
+  free(grow_positions);
+  grow_positions = NULL;
+  LayoutDestroy(&view_layout);
+  GraphDestroy(&view_graph);
+  free(view_edges);
+  view_edges = NULL;
+  for (uint32_t i = 0; i < 2; i++) {
+    free(view_positions[i]);
+    view_positions[i] = NULL;
+  }
+  DestroyCompute();
+  DestroyPipelineCache();
   VulkanCleanup();
   DestroyWindow();
+  /* after every thread that recorded events has been joined */
+  TraceStop();
+}
+
+static double Seconds(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
 }
 
-int main(void) {
+/* --generate-bench <nodes> <m> [seed]: generate the same graph with the CPU
+ * parallel mode and the compute shader, check that both are identical and
+ * print the timings. Needs no window, so it also runs on lavapipe. */
+static int RunGenerateBench(int argc, char** argv) {
+  if (argc < 4) {
+    fprintf(stderr, "usage: %s --generate-bench <nodes> <m> [seed]\n",
+            argv[0]);
+    return -1;
+  }
+  uint32_t node_count = (uint32_t)strtoul(argv[2], NULL, 10);
+  uint32_t m = (uint32_t)strtoul(argv[3], NULL, 10);
+  uint64_t seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+  if (m == 0 || node_count <= m + 1) {
+    fprintf(stderr, "need m > 0 and more than m + 1 nodes\n");
+    return -1;
+  }
+
+  GenerateOptions options = {
+      .m = m, .mode = GENERATE_MODE_PARALLEL, .seed = seed};
+  Graph cpu_graph, gpu_graph;
+  if (0 != init(&cpu_graph, node_count, m + 1) ||
+      0 != init(&gpu_graph, node_count, m + 1)) {
+    return -1;
+  }
+
+  double start = Seconds();
+  int result = generate(&cpu_graph, &options);
+  double cpu_seconds = Seconds() - start;
+
+  ComputeBuffer edges = {};
+  uint64_t edge_count = 0;
+  double gpu_seconds = 0.0;
+  if (result == 0) {
+    start = Seconds();
+    result = ComputeGenerateEdges(&gpu_graph, node_count, m, seed, &edges,
+                                  &edge_count);
+    gpu_seconds = Seconds() - start;
+  }
+
+  uint32_t* pairs = NULL;
+  if (result == 0) {
+    pairs = (uint32_t*)malloc(sizeof(uint32_t) * 2 * edge_count);
+    result = pairs != NULL ? 0 : -1;
+  }
+  if (result == 0) {
+    result = ComputeReadBuffer(&edges, 0, pairs,
+                               sizeof(uint32_t) * 2 * edge_count);
+  }
+  if (result == 0) {
+    while (gpu_graph.node_count < node_count) {
+      GraphAddNode(&gpu_graph);
+    }
+    result = GraphFreezeEdges(&gpu_graph, pairs, edge_count);
+  }
+
+  if (result == 0) {
+    bool match =
+        cpu_graph.edge_count == gpu_graph.edge_count &&
+        0 == memcmp(cpu_graph.offsets, gpu_graph.offsets,
+                    sizeof(uint64_t) * (node_count + 1)) &&
+        0 == memcmp(cpu_graph.neighbors, gpu_graph.neighbors,
+                    sizeof(uint32_t) * 2 * cpu_graph.edge_count);
+    printf("nodes %u m %u edges %llu\n", node_count, m,
+           (unsigned long long)cpu_graph.edge_count);
+    printf("cpu parallel: %.3f s\n", cpu_seconds);
+    printf("gpu compute:  %.3f s\n", gpu_seconds);
+    printf("graphs %s\n", match ? "match" : "DIFFER");
+    result = match ? 0 : -1;
+  }
+
+  free(pairs);
+  ComputeDestroyBuffer(&edges);
+  GraphDestroy(&gpu_graph);
+  GraphDestroy(&cpu_graph);
+  return result;
+}
+
+/* --write-graph <path> <nodes> <m> [seed]: generate a graph and stream it
+ * into a binary graph file */
+static int RunWriteGraph(int argc, char** argv) {
+  if (argc < 5) {
+    fprintf(stderr, "usage: %s --write-graph <path> <nodes> <m> [seed]\n",
+            argv[0]);
+    return -1;
+  }
+  uint32_t node_count = (uint32_t)strtoul(argv[3], NULL, 10);
+  uint32_t m = (uint32_t)strtoul(argv[4], NULL, 10);
+  uint64_t seed = argc > 5 ? strtoull(argv[5], NULL, 10) : 1;
+  if (m == 0 || node_count <= m + 1) {
+    fprintf(stderr, "need m > 0 and more than m + 1 nodes\n");
+    return -1;
+  }
+
+  Graph graph;
+  if (0 != init(&graph, node_count, m + 1)) {
+    return -1;
+  }
+  uint64_t edge_capacity =
+      graph.edge_count + (uint64_t)m * (node_count - graph.node_count);
+
+  GraphWriter writer;
+  GenerateOptions options = {.m = m, .seed = seed, .writer = &writer};
+  if (0 != GraphWriterOpen(&writer, argv[2], node_count, edge_capacity,
+                           &options)) {
+    GraphDestroy(&graph);
+    return -1;
+  }
+
+  double start = Seconds();
+  int result = generate(&graph, &options);
+  if (0 != GraphWriterClose(&writer)) {
+    result = -1;
+  }
+  if (result == 0) {
+    printf("wrote %u nodes, %llu edges to %s in %.3f s\n", node_count,
+           (unsigned long long)graph.edge_count, argv[2], Seconds() - start);
+  }
+  GraphDestroy(&graph);
+  return result;
+}
+
+/* --read-graph <path>: map a binary graph file and report how long it took */
+static int RunReadGraph(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s --read-graph <path>\n", argv[0]);
+    return -1;
+  }
+
+  double start = Seconds();
+  Graph graph;
+  GraphFileHeader header;
+  if (0 != GraphMapFile(&graph, argv[2], &header)) {
+    return -1;
+  }
+  double seconds = Seconds() - start;
+
+  uint32_t max_degree = 0;
+  for (uint32_t i = 0; i < graph.node_count; i++) {
+    if (graph.degree[i] > max_degree) {
+      max_degree = graph.degree[i];
+    }
+  }
+  printf("mapped %u nodes, %llu edges (m %u, seed %llu) in %.3f ms\n",
+         graph.node_count, (unsigned long long)graph.edge_count, header.m,
+         (unsigned long long)header.seed, seconds * 1e3);
+  printf("max degree %u\n", max_degree);
+  GraphDestroy(&graph);
+  return 0;
+}
+
+/* --grow <nodes> <m> [nodes_per_frame] [seed]: set up a graph that is
+ * generated a few nodes per frame while it is drawn */
+static int CreateGrowth(int argc, char** argv) {
+  if (argc < 4) {
+    fprintf(stderr,
+            "usage: %s --grow <nodes> <m> [nodes_per_frame] [seed]\n",
+            argv[0]);
+    return -1;
+  }
+  uint32_t node_count = (uint32_t)strtoul(argv[2], NULL, 10);
+  uint32_t m = (uint32_t)strtoul(argv[3], NULL, 10);
+  grow_nodes_per_frame = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 10) : 64;
+  uint64_t seed = argc > 5 ? strtoull(argv[5], NULL, 10) : 1;
+  if (m == 0 || node_count <= m + 1 || grow_nodes_per_frame == 0) {
+    fprintf(stderr, "need m > 0, more than m + 1 nodes and at least one "
+                    "node per frame\n");
+    return -1;
+  }
+
+  if (0 != init(&grow_graph, node_count, m + 1)) {
+    return -1;
+  }
+  uint32_t remaining = node_count - grow_graph.node_count;
+  uint64_t edge_capacity = grow_graph.edge_count + (uint64_t)m * remaining;
+  GenerateOptions options = {
+      .m = m, .mode = GENERATE_MODE_REPEATED_ENDPOINTS, .seed = seed};
+  if (0 != GenerateBegin(&grow_state, &grow_graph, &options)) {
+    return -1;
+  }
+  grow_positions = (float*)malloc(sizeof(float) * 2 * node_count);
+  if (grow_positions == NULL) {
+    fprintf(stderr, "failed to allocate %u node positions\n", node_count);
+    return -1;
+  }
+  return CreateGraphRenderer(node_count, edge_capacity);
+}
+
+/* add this frame's nodes and hand the grown arrays to the renderer */
+static int UpdateGrowth(void) {
+  uint32_t first = grow_graph.node_count;
+  if (0 > GenerateStep(&grow_state, grow_nodes_per_frame)) {
+    return -1;
+  }
+
+  /* no layout yet, the nodes go on a golden-angle spiral in the order they
+   * were added so the old hubs end up in the middle */
+  float capacity = (float)grow_graph.node_capacity;
+  for (uint32_t i = first; i < grow_graph.node_count; i++) {
+    float r = sqrtf(((float)i + 0.5f) / capacity);
+    float theta = (float)i * 2.39996323f;
+    grow_positions[2 * i] = r * cosf(theta);
+    grow_positions[2 * i + 1] = r * sinf(theta);
+  }
+  GraphRendererUpdate(grow_positions, grow_graph.node_count,
+                      grow_state.endpoints, grow_state.endpoint_count / 2);
+  return 0;
+}
+
+/* --analyze <path> [threads]: degree distribution and power-law fit of a
+ * binary graph file */
+static int RunAnalyze(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s --analyze <path> [threads]\n", argv[0]);
+    return -1;
+  }
+  uint32_t thread_count = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 0;
+
+  Graph graph;
+  if (0 != GraphMapFile(&graph, argv[2], NULL)) {
+    return -1;
+  }
+  double start = Seconds();
+  DegreeHistogram histogram;
+  if (0 != DegreeHistogramFromGraph(&histogram, &graph, thread_count)) {
+    GraphDestroy(&graph);
+    return -1;
+  }
+  double histogram_seconds = Seconds() - start;
+
+  start = Seconds();
+  PowerLawFit fit;
+  int result = PowerLawFitDegrees(&histogram, thread_count, &fit);
+  double fit_seconds = Seconds() - start;
+
+  if (result == 0) {
+    printf("nodes %u edges %llu distinct degrees %u max degree %u\n",
+           graph.node_count, (unsigned long long)graph.edge_count,
+           histogram.distinct_count, histogram.max_degree);
+    printf("alpha %.4f +- %.4f xmin %u tail %llu ks %.5f\n", fit.alpha,
+           fit.sigma, fit.xmin, (unsigned long long)fit.tail_count, fit.ks);
+    printf("histogram %.3f ms, fit %.3f ms\n", histogram_seconds * 1e3,
+           fit_seconds * 1e3);
+
+    LogBin bins[64];
+    uint32_t bin_count = DegreeLogBins(&histogram, 2.0, bins, 64);
+    printf("degree density\n");
+    for (uint32_t i = 0; i < bin_count; i++) {
+      printf("%.1f %.6e\n", bins[i].center, bins[i].density);
+    }
+  }
+
+  DegreeHistogramDestroy(&histogram);
+  GraphDestroy(&graph);
+  return result;
+}
+
+/* --layout-bench <nodes> <m> [iterations] [threads]: time the force
+ * layout on a generated graph */
+static int RunLayoutBench(int argc, char** argv) {
+  if (argc < 4) {
+    fprintf(stderr,
+            "usage: %s --layout-bench <nodes> <m> [iterations] [threads]\n",
+            argv[0]);
+    return -1;
+  }
+  uint32_t node_count = (uint32_t)strtoul(argv[2], NULL, 10);
+  uint32_t m = (uint32_t)strtoul(argv[3], NULL, 10);
+  uint32_t iterations = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 10) : 100;
+  if (m == 0 || node_count <= m + 1) {
+    fprintf(stderr, "need m > 0 and more than m + 1 nodes\n");
+    return -1;
+  }
+
+  Graph graph;
+  GenerateOptions options = {.m = m, .mode = GENERATE_MODE_PARALLEL};
+  if (0 != init(&graph, node_count, m + 1) ||
+      0 != generate(&graph, &options)) {
+    GraphDestroy(&graph);
+    return -1;
+  }
+
+  LayoutOptions layout_options;
+  LayoutDefaultOptions(&layout_options);
+  layout_options.thread_count =
+      argc > 5 ? (uint32_t)strtoul(argv[5], NULL, 10) : 0;
+  Layout layout;
+  if (0 != LayoutCreate(&layout, &graph, &layout_options)) {
+    GraphDestroy(&graph);
+    return -1;
+  }
+
+  int result = 0;
+  double start = Seconds();
+  for (uint32_t i = 0; i < iterations; i++) {
+    float movement = LayoutStep(&layout);
+    if (movement < 0.f) {
+      result = -1;
+      break;
+    }
+    if (i % 10 == 0 || i + 1 == iterations) {
+      printf("iteration %u movement %.6f speed %.3f cells %u %.3f s\n", i,
+             movement, layout.speed, layout.cell_count, Seconds() - start);
+    }
+  }
+  printf("%.2f ms per iteration\n", (Seconds() - start) * 1e3 / iterations);
+
+  LayoutDestroy(&layout);
+  GraphDestroy(&graph);
+  return result;
+}
+
+/* --layout-check <nodes> <m> [iterations]: run the same layout steps with
+ * layout.comp and LayoutStep() from the same positions and compare them.
+ * The CPU side is exact (theta 0) and the shader approximates the far
+ * field, so they agree to within LAYOUT_CHECK_TOLERANCE of the layout's
+ * size. Needs no window, so it also runs on lavapipe. */
+static int RunLayoutCheck(int argc, char** argv) {
+  if (argc < 4) {
+    fprintf(stderr, "usage: %s --layout-check <nodes> <m> [iterations]\n",
+            argv[0]);
+    return -1;
+  }
+  uint32_t node_count = (uint32_t)strtoul(argv[2], NULL, 10);
+  uint32_t m = (uint32_t)strtoul(argv[3], NULL, 10);
+  uint32_t iterations = argc > 4 ? (uint32_t)strtoul(argv[4], NULL, 10) : 5;
+  if (m == 0 || node_count <= m + 1) {
+    fprintf(stderr, "need m > 0 and more than m + 1 nodes\n");
+    return -1;
+  }
+
+  Graph graph;
+  GenerateOptions options = {.m = m, .mode = GENERATE_MODE_PARALLEL};
+  if (0 != init(&graph, node_count, m + 1) ||
+      0 != generate(&graph, &options)) {
+    GraphDestroy(&graph);
+    return -1;
+  }
+
+  LayoutOptions layout_options;
+  LayoutDefaultOptions(&layout_options);
+  layout_options.theta = 0.f;
+  Layout layout;
+  if (0 != LayoutCreate(&layout, &graph, &layout_options)) {
+    GraphDestroy(&graph);
+    return -1;
+  }
+  float* gpu_positions = (float*)malloc(sizeof(float) * 2 * node_count);
+  ComputeBuffer positions = {};
+  ComputeLayout gpu_layout = {};
+  int result = gpu_positions != NULL ? 0 : -1;
+  if (result == 0) {
+    /* LayoutCreate() started from these as well */
+    LayoutInitialPositions(gpu_positions, node_count, layout_options.seed);
+    result = ComputeCreateBuffer(
+        sizeof(float) * 2 * node_count,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &positions);
+  }
+  if (result == 0) {
+    result = ComputeCreateLayout(&graph, positions.buffer, &layout_options,
+                                 &gpu_layout);
+  }
+  if (result == 0) {
+    result = ComputeRunLayout(&gpu_layout, gpu_positions, iterations);
+  }
+  for (uint32_t i = 0; result == 0 && i < iterations; i++) {
+    result = 0.f > LayoutStep(&layout) ? -1 : 0;
+  }
+
+  if (result == 0) {
+    float low[2] = {layout.positions[0], layout.positions[1]};
+    float high[2] = {low[0], low[1]};
+    float deviation = 0.f;
+    for (uint32_t i = 0; i < 2 * node_count; i++) {
+      float p = layout.positions[i];
+      low[i % 2] = p < low[i % 2] ? p : low[i % 2];
+      high[i % 2] = p > high[i % 2] ? p : high[i % 2];
+    }
+    for (uint32_t i = 0; i < node_count; i++) {
+      float dx = gpu_positions[2 * i] - layout.positions[2 * i];
+      float dy = gpu_positions[2 * i + 1] - layout.positions[2 * i + 1];
+      float d = sqrtf(dx * dx + dy * dy);
+      /* NaN fails the check as well */
+      deviation = !(d <= deviation) ? d : deviation;
+    }
+    float extent = high[0] - low[0] > high[1] - low[1] ? high[0] - low[0]
+                                                      : high[1] - low[1];
+    float relative = extent > 0.f ? deviation / extent : deviation;
+    bool match = relative <= LAYOUT_CHECK_TOLERANCE;
+    printf("nodes %u m %u edges %llu levels %u iterations %u\n", node_count,
+           m, (unsigned long long)graph.edge_count, gpu_layout.levels,
+           iterations);
+    printf("largest deviation %.3g of the layout size\n", relative);
+    printf("layouts %s\n", match ? "match" : "DIFFER");
+    result = match ? 0 : -1;
+  }
+
+  ComputeDestroyLayout(&gpu_layout);
+  ComputeDestroyBuffer(&positions);
+  free(gpu_positions);
+  LayoutDestroy(&layout);
+  GraphDestroy(&graph);
+  return result;
+}
+
+/* the index buffer wants every edge of view_graph once, as a pair */
+static int CreateViewEdges(uint64_t* edge_count) {
+  view_edges = (uint32_t*)malloc(sizeof(uint32_t) * 2 * view_graph.edge_count);
+  if (view_edges == NULL) {
+    fprintf(stderr, "failed to allocate %llu edges\n",
+            (unsigned long long)view_graph.edge_count);
+    return -1;
+  }
+  /* GraphMapFile() has checked every neighbor index, but not that the
+   * adjacency is symmetric, so one-sided entries must not overrun */
+  *edge_count = 0;
+  for (uint32_t i = 0; i < view_graph.node_count; i++) {
+    uint32_t count = 0;
+    const uint32_t* neighbors = GraphNeighbors(&view_graph, i, &count);
+    for (uint32_t k = 0; k < count; k++) {
+      if (neighbors[k] >= view_graph.node_count) {
+        fprintf(stderr, "node %u has neighbor %u of only %u nodes\n", i,
+                neighbors[k], view_graph.node_count);
+        return -1;
+      }
+      if (i < neighbors[k]) {
+        if (*edge_count == view_graph.edge_count) {
+          fprintf(stderr, "more than %llu edges, the adjacency is not "
+                          "symmetric\n",
+                  (unsigned long long)view_graph.edge_count);
+          return -1;
+        }
+        view_edges[2 * *edge_count] = i;
+        view_edges[2 * *edge_count + 1] = neighbors[k];
+        (*edge_count)++;
+      }
+    }
+  }
+  if (*edge_count != view_graph.edge_count) {
+    fprintf(stderr, "%llu of %llu edges, the adjacency is not symmetric\n",
+            (unsigned long long)*edge_count,
+            (unsigned long long)view_graph.edge_count);
+    return -1;
+  }
+  return 0;
+}
+
+/* step the layout as fast as it goes, independent of the frame rate. A
+ * step is handed over whenever the main thread has taken the last one */
+static void* ViewLayoutMain(void* arg) {
+  (void)arg;
+  size_t size = sizeof(float) * 2 * (size_t)view_layout.node_count;
+  for (;;) {
+    float movement = LayoutStep(&view_layout);
+
+    pthread_mutex_lock(&view_mutex);
+    if (movement < 0.f) {
+      view_result = -1;
+    }
+    bool stop = view_quit || movement < 0.f;
+    bool hand_over = !view_fresh;
+    uint32_t back = 1 - view_front;
+    pthread_mutex_unlock(&view_mutex);
+    if (stop) {
+      break;
+    }
+
+    /* the main thread only swaps in a fresh buffer, so the back one is
+     * ours until view_fresh is set */
+    if (hand_over) {
+      memcpy(view_positions[back], view_layout.positions, size);
+      view_bounds[back][0] = view_layout.min[0];
+      view_bounds[back][1] = view_layout.min[1];
+      view_bounds[back][2] = view_layout.max[0];
+      view_bounds[back][3] = view_layout.max[1];
+      pthread_mutex_lock(&view_mutex);
+      view_fresh = true;
+      pthread_mutex_unlock(&view_mutex);
+    }
+  }
+  return NULL;
+}
+
+/* --view <path> [threads]: map a graph file and lay it out on a thread of
+ * its own while it is drawn, every frame shows the last finished step */
+static int CreateView(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s --view <path> [threads]\n", argv[0]);
+    return -1;
+  }
+  if (0 != GraphMapFile(&view_graph, argv[2], NULL)) {
+    return -1;
+  }
+  LayoutOptions options;
+  LayoutDefaultOptions(&options);
+  options.thread_count = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : 0;
+  if (0 != LayoutCreate(&view_layout, &view_graph, &options)) {
+    return -1;
+  }
+
+  uint32_t n = view_graph.node_count;
+  for (uint32_t i = 0; i < 2; i++) {
+    view_positions[i] = (float*)malloc(sizeof(float) * 2 * (uint64_t)n);
+    if (view_positions[i] == NULL) {
+      fprintf(stderr, "failed to allocate %u positions\n", n);
+      return -1;
+    }
+  }
+  memcpy(view_positions[0], view_layout.positions,
+         sizeof(float) * 2 * (uint64_t)n);
+  view_front = 0;
+  view_fresh = false;
+  view_quit = false;
+  view_result = 0;
+
+  if (0 != CreateViewEdges(&view_edge_count) ||
+      0 != CreateGraphRenderer(n, view_edge_count)) {
+    return -1;
+  }
+  GraphRendererUpdate(view_positions[0], n, view_edges, view_edge_count);
+
+  if (0 != pthread_create(&view_thread, NULL, ViewLayoutMain, NULL)) {
+    fprintf(stderr, "failed to start the layout thread\n");
+    return -1;
+  }
+  view_thread_running = true;
+  return 0;
+}
+
+/* --view-gpu <path>: like --view, but the layout runs in a compute shader
+ * on the vertex buffer itself, so the positions never come back to the
+ * host */
+static int CreateGpuView(int argc, char** argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s --view-gpu <path>\n", argv[0]);
+    return -1;
+  }
+  if (0 != GraphMapFile(&view_graph, argv[2], NULL)) {
+    return -1;
+  }
+  LayoutOptions options;
+  LayoutDefaultOptions(&options);
+  uint32_t n = view_graph.node_count;
+  view_gpu_positions = (float*)malloc(sizeof(float) * 2 * (uint64_t)n);
+  if (view_gpu_positions == NULL) {
+    fprintf(stderr, "failed to allocate %u positions\n", n);
+    return -1;
+  }
+  LayoutInitialPositions(view_gpu_positions, n, options.seed);
+
+  /* the initial positions go up through the regular node uploads, the
+   * renderer starts stepping the layout once they are all there */
+  uint64_t edge_count = 0;
+  if (0 != CreateViewEdges(&edge_count) ||
+      0 != CreateGraphRenderer(n, edge_count)) {
+    return -1;
+  }
+  GraphRendererUpdate(view_gpu_positions, n, view_edges, edge_count);
+  if (0 != ComputeCreateLayout(&view_graph, GraphRendererNodeBuffer(),
+                               &options, &view_gpu_layout)) {
+    return -1;
+  }
+  GraphRendererSetLayout(&view_gpu_layout);
+  return 0;
+}
+
+/* the present modes --present-mode takes */
+static int ParsePresentMode(const char* name, VkPresentModeKHR* mode) {
+  static const struct {
+    const char* name;
+    VkPresentModeKHR mode;
+  } modes[] = {{"fifo", VK_PRESENT_MODE_FIFO_KHR},
+               {"fifo-relaxed", VK_PRESENT_MODE_FIFO_RELAXED_KHR},
+               {"mailbox", VK_PRESENT_MODE_MAILBOX_KHR},
+               {"immediate", VK_PRESENT_MODE_IMMEDIATE_KHR}};
+  for (uint32_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+    if (0 == strcmp(name, modes[i].name)) {
+      *mode = modes[i].mode;
+      return 0;
+    }
+  }
+  fprintf(stderr, "unknown present mode %s, expected fifo, fifo-relaxed, "
+                  "mailbox or immediate\n", name);
+  return -1;
+}
+
+/* swapchain and depth images at the window's size, false while the window
+ * is minimized and nothing can be drawn */
+static int ResizeSwapchain(bool* drawable) {
+  int width = 0;
+  int height = 0;
+  GetWindowPixelSize(&width, &height);
+  *drawable = width > 0 && height > 0;
+  if (!*drawable) {
+    return 0;
+  }
+  if (0 != VulkanRecreateSwapchain(width, height) || 0 != RendererResize()) {
+    return -1;
+  }
+  return 0;
+}
+
+/* what startup does on its own thread while the main thread creates the
+ * window, nothing in it needs a surface */
+typedef struct {
+  bool headless;
+  int result;
+} DeviceStartup;
+
+/* PIPELINE_CACHE_FILE in the user's preference directory, resolved here
+ * because the device thread that loads the cache must not call SDL */
+static void UseDefaultPipelineCache(void) {
+  char path[1024];
+  if (0 == WindowPrefPath(PIPELINE_CACHE_FILE, path, sizeof(path))) {
+    PipelineSetCachePath(path);
+  }
+}
+
+static void* StartDevice(void* arg) {
+  DeviceStartup* startup = (DeviceStartup*)arg;
+  double start = TimingNow();
+  startup->result = -1;
+  if (0 != VulkanInitialize(startup->headless)) {
+    fprintf(stderr, "Failed to initialize Vulkan instance and device\n");
+    return NULL;
+  }
+  if (0 != CreatePipelineCache()) {
+    fprintf(stderr, "Failed to create the pipeline cache\n");
+    return NULL;
+  }
+  if (0 != CreateCompute()) {
+    fprintf(stderr, "Failed to create the compute resources\n");
+    return NULL;
+  }
+  TimingRecordStartup(TIMING_STARTUP_DEVICE, start);
+  startup->result = 0;
+  return NULL;
+}
+
+/* show the latest step the layout thread has finished, if it is newer
+ * than the one on screen. Never waits for a step */
+static int UpdateView(void) {
+  pthread_mutex_lock(&view_mutex);
+  int result = view_result;
+  bool fresh = view_fresh;
+  if (fresh) {
+    view_front = 1 - view_front;
+    view_fresh = false;
+  }
+  uint32_t front = view_front;
+  pthread_mutex_unlock(&view_mutex);
+
+  /* the renderer copies the positions into the staging ring while it
+   * records, so the old front buffer is no longer read after this */
+  if (fresh) {
+    GraphRendererUpdate(view_positions[front], view_graph.node_count,
+                        view_edges, view_edge_count);
+    GraphRendererSetBounds(view_bounds[front], view_bounds[front] + 2);
+    GraphRendererRefreshPositions();
+  }
+  return result;
+}
+
+int main(int argc, char** argv) {
+  double startup_start = TimingNow();
+  if (argc > 1 && 0 == strcmp(argv[1], "--layout-bench")) {
+    return RunLayoutBench(argc, argv);
+  }
+  if (argc > 1 && 0 == strcmp(argv[1], "--analyze")) {
+    return RunAnalyze(argc, argv);
+  }
+  if (argc > 1 && 0 == strcmp(argv[1], "--write-graph")) {
+    return RunWriteGraph(argc, argv);
+  }
+  if (argc > 1 && 0 == strcmp(argv[1], "--read-graph")) {
+    return RunReadGraph(argc, argv);
+  }
+  bool generate_bench = argc > 1 && 0 == strcmp(argv[1], "--generate-bench");
+  bool layout_check = argc > 1 && 0 == strcmp(argv[1], "--layout-check");
+  if (generate_bench || layout_check) {
+    UseDefaultPipelineCache();
+    CHECK_RESULT(VulkanInitialize(true),
+                 "Failed to initialize Vulkan instance and device");
+    CHECK_RESULT(CreatePipelineCache(), "Failed to create the pipeline cache");
+    CHECK_RESULT(CreateCompute(), "Failed to create the compute resources");
+    int result = generate_bench ? RunGenerateBench(argc, argv)
+                                : RunLayoutCheck(argc, argv);
+    Cleanup();
+    return result;
+  }
+
   int window_width = 800;
   int window_height = 600;
   /* setenv("SDL_VIDEODRIVER", "wayland", 1);
   /* initialize Vulkan */
 
-  CHECK_RESULT(VulkanInitialize(),
-               "Failed to initialize Vulkan instance and device");
-  /* create the main window */
-  CHECK_RESULT(
-      CreateWindow(window_width, window_height, "SDL3 Output Window [Vulkan]"),
-      "Failed to create window");
-  CHECK_RESULT(VulkanCreateSurface(GetWindowHandle()),
-               "Failed to create Vulkan surface");
-  CHECK_RESULT(VulkanCreateSwapchain(window_width, window_height),
-               "Failed to create Vulkan swapchain");
+  /* options in front of the mode, the rest of the command line is parsed
+   * as if they were not there:
+   * --headless <frames>: render a fixed number of frames into offscreen
+   *   images, without a window, and print the frame times
+   * --timing-csv <path>: write the frame times of the last frames there
+   *   on exit
+   * --trace <path>: write a Chrome trace of the run there on exit, needs
+   *   a build with ENABLE_TRACING
+   * --present-mode <fifo|fifo-relaxed|mailbox|immediate>: how the
+   *   swapchain presents, FIFO when the surface lacks the mode
+   * --frames-in-flight <1-4>: frames recorded ahead of the GPU, 2 by
+   *   default
+   * --record-threads <n>: threads recording the draws, 0 for one per
+   *   online core, 1 by default
+   * --pipeline-cache <path>: where compiled pipelines are kept between
+   *   runs, PIPELINE_CACHE_FILE in the user's preference directory by
+   *   default
+   * --validation <on|off>: load the validation layer, on by default only
+   *   in builds without NDEBUG */
+  bool headless = false;
+  uint32_t frame_limit = 0;
+  bool pipeline_cache_set = false;
+  const char* timing_csv = NULL;
+  while (argc > 2 && (0 == strcmp(argv[1], "--headless") ||
+                      0 == strcmp(argv[1], "--timing-csv") ||
+                      0 == strcmp(argv[1], "--trace") ||
+                      0 == strcmp(argv[1], "--present-mode") ||
+                      0 == strcmp(argv[1], "--frames-in-flight") ||
+                      0 == strcmp(argv[1], "--record-threads") ||
+                      0 == strcmp(argv[1], "--pipeline-cache") ||
+                      0 == strcmp(argv[1], "--validation"))) {
+    if (0 == strcmp(argv[1], "--headless")) {
+      headless = true;
+      frame_limit = (uint32_t)strtoul(argv[2], NULL, 10);
+    } else if (0 == strcmp(argv[1], "--timing-csv")) {
+      timing_csv = argv[2];
+    } else if (0 == strcmp(argv[1], "--present-mode")) {
+      VkPresentModeKHR present_mode;
+      if (0 != ParsePresentMode(argv[2], &present_mode)) {
+        return -1;
+      }
+      VulkanSetPresentMode(present_mode);
+    } else if (0 == strcmp(argv[1], "--frames-in-flight")) {
+      if (0 != FrameSetInFlight((uint32_t)strtoul(argv[2], NULL, 10))) {
+        return -1;
+      }
+    } else if (0 == strcmp(argv[1], "--record-threads")) {
+      if (0 != RecordSetThreads((uint32_t)strtoul(argv[2], NULL, 10))) {
+        return -1;
+      }
+    } else if (0 == strcmp(argv[1], "--pipeline-cache")) {
+      PipelineSetCachePath(argv[2]);
+      pipeline_cache_set = true;
+    } else if (0 == strcmp(argv[1], "--validation")) {
+      if (0 != strcmp(argv[2], "on") && 0 != strcmp(argv[2], "off")) {
+        fprintf(stderr, "--validation takes on or off, not %s\n", argv[2]);
+        return -1;
+      }
+      VulkanSetValidation(0 == strcmp(argv[2], "on"));
+    } else if (0 != TraceStart(argv[2])) {
+      fprintf(stderr, "built without ENABLE_TRACING, not tracing\n");
+    }
+    argv[2] = argv[0];
+    argv += 2;
+    argc -= 2;
+  }
+  if (headless && frame_limit == 0) {
+    fprintf(stderr, "usage: %s --headless <frames> [mode ...]\n", argv[0]);
+    return -1;
+  }
+
+  if (!pipeline_cache_set) {
+    UseDefaultPipelineCache();
+  }
+  /* the device and the window do not depend on each other, SDL stays on
+   * the main thread */
+  DeviceStartup device_startup = {.headless = headless, .result = -1};
+  pthread_t device_thread;
+  bool device_threaded =
+      0 == pthread_create(&device_thread, NULL, StartDevice, &device_startup);
+  if (!device_threaded) {
+    StartDevice(&device_startup);
+  }
+  int window_result = 0;
+  if (!headless) {
+    double start = TimingNow();
+    window_result = CreateWindow(window_width, window_height,
+                                 "SDL3 Output Window [Vulkan]");
+    TimingRecordStartup(TIMING_STARTUP_WINDOW, start);
+  }
+  if (device_threaded) {
+    pthread_join(device_thread, NULL);
+  }
+  CHECK_RESULT(device_startup.result, "Failed to start the device");
+  CHECK_RESULT(window_result, "Failed to create window");
+
+  double phase_start = TimingNow();
+  if (headless) {
+    CHECK_RESULT(VulkanCreateOffscreen(window_width, window_height),
+                 "Failed to create the offscreen images");
+  } else {
+    CHECK_RESULT(VulkanCreateSurface(GetWindowHandle()),
+                 "Failed to create Vulkan surface");
+    CHECK_RESULT(VulkanCreateSwapchain(window_width, window_height),
+                 "Failed to create Vulkan swapchain");
+  }
+  TimingRecordStartup(TIMING_STARTUP_SWAPCHAIN, phase_start);
+
+  phase_start = TimingNow();
   CHECK_RESULT(CreateRenderer(), "Failed to create the rendering resources");
+  /* headless runs keep every frame */
+  CHECK_RESULT(TimingCreate(frame_limit), "Failed to create the timers");
+  TimingRecordStartup(TIMING_STARTUP_RENDERER, phase_start);
+
+  phase_start = TimingNow();
+  bool grow = argc > 1 && 0 == strcmp(argv[1], "--grow");
+  bool view = argc > 1 && 0 == strcmp(argv[1], "--view");
+  bool view_gpu = argc > 1 && 0 == strcmp(argv[1], "--view-gpu");
+  if (grow || view || view_gpu) {
+    GraphRendererBuildPipelines();
+  }
+  if (grow) {
+    CHECK_RESULT(CreateGrowth(argc, argv), "Failed to set up graph growth");
+  }
+  if (view) {
+    CHECK_RESULT(CreateView(argc, argv), "Failed to set up the graph view");
+  }
+  if (view_gpu) {
+    CHECK_RESULT(CreateGpuView(argc, argv),
+                 "Failed to set up the GPU graph view");
+  }
+  TimingRecordStartup(TIMING_STARTUP_MODE, phase_start);
 
   /* main loop */
-  for (;;) {
-    if (0 != PollEvents()) {
+  bool resize = false;
+  bool first_frame_done = false;
+  double first_frame_start = TimingNow();
+  for (uint32_t frame = 0; !headless || frame < frame_limit; frame++) {
+    if (!headless && 0 != PollEvents()) {
       break;
     }
+    if (!headless) {
+      resize |= WindowResized() || VulkanSwapchainOutOfDate();
+    }
+    if (resize) {
+      bool drawable = false;
+      CHECK_RESULT(ResizeSwapchain(&drawable),
+                   "Failed to recreate the swapchain");
+      if (!drawable) {
+        continue;
+      }
+      resize = false;
+    }
+    TimingBeginFrame();
 
+    double start = TimingNow();
     int image_index = VulkanSCAcquireImage();
+    if (image_index == VULKAN_SWAPCHAIN_OUT_OF_DATE) {
+      /* recreated before the next frame, nothing was rendered */
+      resize = true;
+      TimingEndFrame();
+      continue;
+    }
     CHECK_RESULT(image_index, "Failed to acquire image");
+    TimingRecord(TIMING_ACQUIRE, start);
+
+    start = TimingNow();
+    if (grow) {
+      CHECK_RESULT(UpdateGrowth(), "Failed to grow the graph");
+    }
+    if (view) {
+      CHECK_RESULT(UpdateView(), "Failed to lay out the graph");
+    }
+
+    TimingRecord(TIMING_UPDATE, start);
 
     /* run the render */
+    start = TimingNow();
     Render();
+    TimingRecord(TIMING_RENDER, start);
 
     /* present the image */
+    start = TimingNow();
     CHECK_RESULT(VulkanSCPresent(), "Failed to present? why?");
+    TimingRecord(TIMING_PRESENT, start);
+    TimingEndFrame();
+
+    if (!first_frame_done) {
+      TimingRecordStartup(TIMING_STARTUP_FIRST_FRAME, first_frame_start);
+      TimingRecordStartup(TIMING_STARTUP_TOTAL, startup_start);
+      TimingPrintStartup(stdout);
+      first_frame_done = true;
+    }
+  }
+
+  TimingFlush();
+  if (headless) {
+    TimingPrint(stdout);
+    MemPrintStats(stdout);
+  }
+  if (timing_csv != NULL) {
+    TimingWriteCsv(timing_csv);
   }
 
   /* cleanup */
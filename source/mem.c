@@ -1,30 +1,83 @@
-
 #include "mem.h"
 
+#include <pthread.h>
 #include <stdlib.h>
+#include <string.h>
 
 extern VkDevice device;
 extern VkPhysicalDevice physical_device;
 
+/* order k ranges are MEM_MIN_ALLOCATION << k bytes, a whole block is the
+ * highest order */
+#define MEM_MAX_ORDERS 19u
+
+/* buffers and linear images never share a block with optimal images, so
+ * neighbours can not break bufferImageGranularity */
+typedef enum {
+  MEM_KIND_LINEAR = 0,
+  MEM_KIND_OPTIMAL,
+  MEM_KIND_COUNT,
+} MemKind;
+
+/* offsets of free ranges of one order, in MEM_MIN_ALLOCATION units */
+typedef struct {
+  uint32_t* offsets;
+  uint32_t count;
+  uint32_t capacity;
+} MemFreeList;
+
+struct MemBlock {
+  struct MemBlock* next;
+  VkDeviceMemory memory;
+  uint8_t* mapped;
+  uint32_t type_index;
+  MemKind kind;
+  uint32_t order_count;
+  VkDeviceSize used;
+  MemFreeList free_lists[MEM_MAX_ORDERS];
+};
+
+typedef struct {
+  uint32_t block_count;
+  VkDeviceSize block_bytes;
+  uint32_t dedicated_count;
+  VkDeviceSize dedicated_bytes;
+  uint32_t allocation_count;
+  /* what the resources asked for, and what they took after rounding */
+  VkDeviceSize requested_bytes;
+  VkDeviceSize used_bytes;
+} MemTypeStats;
+
+static pthread_mutex_t mem_mutex = PTHREAD_MUTEX_INITIALIZER;
+
 static bool memory_properties_retrieved = false;
 static VkPhysicalDeviceMemoryProperties memory_properties;
+static VkDeviceSize buffer_image_granularity = 1;
 
-int FindRequiredMemoryType(VkMemoryPropertyFlags property_flags,
-                           uint32_t type_bits) {
+static struct MemBlock* pools[VK_MAX_MEMORY_TYPES][MEM_KIND_COUNT];
+static MemTypeStats type_stats[VK_MAX_MEMORY_TYPES];
+
+static void RetrieveMemoryProperties(void) {
   /* caching xd */
   if (!memory_properties_retrieved) {
     vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    buffer_image_granularity = properties.limits.bufferImageGranularity;
     memory_properties_retrieved = true;
   }
+}
+
+int FindRequiredMemoryType(VkMemoryPropertyFlags property_flags,
+                           uint32_t type_bits) {
+  RetrieveMemoryProperties();
   uint32_t memory_type_index = 0;
   for (; memory_type_index < memory_properties.memoryTypeCount;
        memory_type_index++) {
-    if (memory_properties.memoryTypes[memory_type_index].propertyFlags &
-            property_flags == property_flags &&
+    if ((memory_properties.memoryTypes[memory_type_index].propertyFlags &
+         property_flags) == property_flags &&
         (type_bits & (1 << memory_type_index)) != 0) {
       /* we found the required memory type */
-      uint32_t heap_index =
-          memory_properties.memoryTypes[memory_type_index].heapIndex;
       return memory_type_index;
     }
   }
@@ -32,89 +85,397 @@ int FindRequiredMemoryType(VkMemoryPropertyFlags property_flags,
   return memory_properties.memoryTypeCount;
 }
 
-int AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags property_flags,
-                         VkDeviceMemory* device_memory) {
-  VkMemoryRequirements req = {};
-  vkGetBufferMemoryRequirements(device, buffer, &req);
+static bool IsHostVisible(uint32_t type_index) {
+  return 0 != (memory_properties.memoryTypes[type_index].propertyFlags &
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+}
 
-  uint32_t memory_type_index =
-      FindRequiredMemoryType(property_flags, req.memoryTypeBits);
+/* an eighth of the heap at most, rounded down to a power of two */
+static VkDeviceSize BlockSize(uint32_t type_index) {
+  uint32_t heap_index = memory_properties.memoryTypes[type_index].heapIndex;
+  VkDeviceSize limit = memory_properties.memoryHeaps[heap_index].size / 8;
+  VkDeviceSize size = MEM_BLOCK_SIZE;
+  while (size > limit && size > MEM_MIN_ALLOCATION) {
+    size /= 2;
+  }
+  return size;
+}
 
-  if (memory_type_index == memory_properties.memoryTypeCount) {
-    return -1;
+static uint32_t OrderOf(VkDeviceSize size) {
+  uint32_t order = 0;
+  while ((MEM_MIN_ALLOCATION << order) < size) {
+    order++;
+  }
+  return order;
+}
+
+static int PushFree(MemFreeList* list, uint32_t offset) {
+  if (list->count == list->capacity) {
+    uint32_t capacity = list->capacity > 0 ? 2 * list->capacity : 8;
+    uint32_t* offsets =
+        (uint32_t*)realloc(list->offsets, sizeof(uint32_t) * capacity);
+    if (offsets == NULL) {
+      return -1;
+    }
+    list->offsets = offsets;
+    list->capacity = capacity;
+  }
+  list->offsets[list->count++] = offset;
+  return 0;
+}
+
+static bool RemoveFree(MemFreeList* list, uint32_t offset) {
+  for (uint32_t i = 0; i < list->count; i++) {
+    if (list->offsets[i] == offset) {
+      list->offsets[i] = list->offsets[--list->count];
+      return true;
+    }
   }
+  return false;
+}
+
+static void DestroyBlock(struct MemBlock* block) {
+  for (uint32_t k = 0; k < MEM_MAX_ORDERS; k++) {
+    free(block->free_lists[k].offsets);
+  }
+  if (block->mapped != NULL) {
+    vkUnmapMemory(device, block->memory);
+  }
+  vkFreeMemory(device, block->memory, VK_NULL_HANDLE);
+  MemTypeStats* stats = &type_stats[block->type_index];
+  stats->block_count--;
+  stats->block_bytes -= MEM_MIN_ALLOCATION << (block->order_count - 1);
+  free(block);
+}
+
+static struct MemBlock* CreateBlock(uint32_t type_index, MemKind kind) {
+  struct MemBlock* block =
+      (struct MemBlock*)calloc(1, sizeof(struct MemBlock));
+  if (block == NULL) {
+    return NULL;
+  }
+  VkDeviceSize size = BlockSize(type_index);
+  block->type_index = type_index;
+  block->kind = kind;
+  block->order_count = OrderOf(size) + 1;
 
   VkMemoryAllocateInfo alloc_info = {};
   alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.allocationSize = req.size;
-  alloc_info.memoryTypeIndex = memory_type_index;
+  alloc_info.allocationSize = size;
+  alloc_info.memoryTypeIndex = type_index;
+  if (VK_SUCCESS != vkAllocateMemory(device, &alloc_info, VK_NULL_HANDLE,
+                                     &block->memory)) {
+    free(block);
+    return NULL;
+  }
+  type_stats[type_index].block_count++;
+  type_stats[type_index].block_bytes += size;
 
-  if (VK_SUCCESS !=
-      vkAllocateMemory(device, &alloc_info, VK_NULL_HANDLE, device_memory)) {
-    return -1;
+  void* mapped = NULL;
+  if (IsHostVisible(type_index) &&
+      VK_SUCCESS != vkMapMemory(device, block->memory, 0, VK_WHOLE_SIZE, 0,
+                                &mapped)) {
+    DestroyBlock(block);
+    return NULL;
   }
+  block->mapped = (uint8_t*)mapped;
+  if (0 != PushFree(&block->free_lists[block->order_count - 1], 0)) {
+    DestroyBlock(block);
+    return NULL;
+  }
+  return block;
+}
 
-  if (VK_SUCCESS != vkBindBufferMemory(device, buffer, *device_memory, 0)) {
+/* take the smallest free range of at least order and split it down */
+static int BlockAllocate(struct MemBlock* block, uint32_t order,
+                         uint32_t* offset) {
+  uint32_t k = order;
+  while (k < block->order_count && block->free_lists[k].count == 0) {
+    k++;
+  }
+  if (k == block->order_count) {
     return -1;
   }
-
+  MemFreeList* list = &block->free_lists[k];
+  uint32_t found = list->offsets[--list->count];
+  while (k > order) {
+    k--;
+    if (0 != PushFree(&block->free_lists[k], found + (1u << k))) {
+      /* give back what is left of the range */
+      PushFree(&block->free_lists[k + 1], found);
+      return -1;
+    }
+  }
+  *offset = found;
+  block->used += MEM_MIN_ALLOCATION << order;
   return 0;
 }
 
-int AllocateImagesMemory(VkImage* images, uint32_t count,
-                         VkMemoryPropertyFlags property_flags,
-                         VkDeviceMemory* device_memory) {
-  VkMemoryRequirements req = {};
-
-  VkDeviceSize* offsets = (VkDeviceSize*)malloc(sizeof(VkDeviceSize) * count);
-  VkDeviceSize required_size = 0;
-  uint32_t required_type_bits = 0;
-
-  offsets[0] = 0;
+/* merge with the free buddy of each order on the way up */
+static void BlockFree(struct MemBlock* block, uint32_t offset,
+                      uint32_t order) {
+  block->used -= MEM_MIN_ALLOCATION << order;
+  while (order + 1 < block->order_count &&
+         RemoveFree(&block->free_lists[order], offset ^ (1u << order))) {
+    offset &= ~(1u << order);
+    order++;
+  }
+  PushFree(&block->free_lists[order], offset);
+}
 
-  for (uint32_t i = 0; i < count; i++) {
-    vkGetImageMemoryRequirements(device, images[i], &req);
-    required_type_bits |= req.memoryTypeBits;
+static int AllocateDedicated(const VkMemoryRequirements* req,
+                             uint32_t type_index, VkBuffer buffer,
+                             VkImage image, MemAllocation* allocation) {
+  VkMemoryDedicatedAllocateInfo dedicated_info = {};
+  dedicated_info.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+  dedicated_info.buffer = buffer;
+  dedicated_info.image = image;
 
-    required_size += req.size;
+  VkMemoryAllocateInfo alloc_info = {};
+  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+  alloc_info.pNext = &dedicated_info;
+  alloc_info.allocationSize = req->size;
+  alloc_info.memoryTypeIndex = type_index;
+  if (VK_SUCCESS != vkAllocateMemory(device, &alloc_info, VK_NULL_HANDLE,
+                                     &allocation->memory)) {
+    allocation->memory = VK_NULL_HANDLE;
+    return -1;
+  }
+  /* nothing is counted yet, so FreeMemory() must not see this handle */
+  if (IsHostVisible(type_index) &&
+      VK_SUCCESS != vkMapMemory(device, allocation->memory, 0, VK_WHOLE_SIZE,
+                                0, &allocation->mapped)) {
+    vkFreeMemory(device, allocation->memory, VK_NULL_HANDLE);
+    allocation->memory = VK_NULL_HANDLE;
+    allocation->mapped = NULL;
+    return -1;
+  }
+  allocation->offset = 0;
+  allocation->block = NULL;
+  type_stats[type_index].dedicated_count++;
+  type_stats[type_index].dedicated_bytes += req->size;
+  return 0;
+}
 
-    if (required_size % req.alignment > 0 && i + 1 < count) {
-      required_size += req.alignment - required_size % req.alignment;
-    }
+static int AllocateFromPool(const VkMemoryRequirements* req,
+                            uint32_t type_index, MemKind kind,
+                            MemAllocation* allocation) {
+  VkDeviceSize size = req->size > req->alignment ? req->size : req->alignment;
+  allocation->order = OrderOf(size);
 
-    if (i + 1 < count) {
-      offsets[i + 1] = required_size;
+  uint32_t offset = 0;
+  struct MemBlock* block = pools[type_index][kind];
+  while (block != NULL &&
+         0 != BlockAllocate(block, allocation->order, &offset)) {
+    block = block->next;
+  }
+  if (block == NULL) {
+    block = CreateBlock(type_index, kind);
+    if (block == NULL ||
+        0 != BlockAllocate(block, allocation->order, &offset)) {
+      if (block != NULL) {
+        DestroyBlock(block);
+      }
+      return -1;
     }
+    block->next = pools[type_index][kind];
+    pools[type_index][kind] = block;
   }
 
-  uint32_t memory_type_index =
-      FindRequiredMemoryType(property_flags, required_type_bits);
+  /* buddy ranges are aligned to their own size */
+  allocation->memory = block->memory;
+  allocation->offset = (VkDeviceSize)offset * MEM_MIN_ALLOCATION;
+  allocation->mapped =
+      block->mapped != NULL ? block->mapped + allocation->offset : NULL;
+  allocation->block = block;
+  type_stats[type_index].used_bytes += MEM_MIN_ALLOCATION
+                                       << allocation->order;
+  return 0;
+}
+
+/* pass the buffer or the image the requirements are for */
+static int Allocate(const VkMemoryRequirements2* req2,
+                    const VkMemoryDedicatedRequirements* dedicated,
+                    VkMemoryPropertyFlags property_flags, MemKind kind,
+                    VkBuffer buffer, VkImage image,
+                    MemAllocation* allocation) {
+  const VkMemoryRequirements* req = &req2->memoryRequirements;
+  memset(allocation, 0, sizeof(MemAllocation));
 
-  if (memory_type_index == memory_properties.memoryTypeCount) {
-    free(offsets);
+  pthread_mutex_lock(&mem_mutex);
+  uint32_t type_index =
+      FindRequiredMemoryType(property_flags, req->memoryTypeBits);
+  if (type_index == memory_properties.memoryTypeCount) {
+    pthread_mutex_unlock(&mem_mutex);
     return -1;
   }
+  if (buffer_image_granularity <= 1) {
+    kind = MEM_KIND_LINEAR;
+  }
+  allocation->type_index = type_index;
+  allocation->size = req->size;
 
-  VkMemoryAllocateInfo alloc_info = {};
-  alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-  alloc_info.allocationSize = required_size;
-  alloc_info.memoryTypeIndex = memory_type_index;
+  int result = -1;
+  if (dedicated->requiresDedicatedAllocation ||
+      dedicated->prefersDedicatedAllocation ||
+      req->size > BlockSize(type_index) / 2) {
+    result = AllocateDedicated(req, type_index, buffer, image, allocation);
+  } else {
+    result = AllocateFromPool(req, type_index, kind, allocation);
+  }
+  if (result == 0) {
+    type_stats[type_index].allocation_count++;
+    type_stats[type_index].requested_bytes += req->size;
+  }
+  pthread_mutex_unlock(&mem_mutex);
+  /* a failed allocation is safe to pass to FreeMemory() */
+  if (result != 0) {
+    memset(allocation, 0, sizeof(MemAllocation));
+  }
+  return result;
+}
+
+int AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags property_flags,
+                         MemAllocation* allocation) {
+  VkBufferMemoryRequirementsInfo2 info = {};
+  info.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+  info.buffer = buffer;
+  VkMemoryDedicatedRequirements dedicated = {};
+  dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+  VkMemoryRequirements2 req = {};
+  req.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+  req.pNext = &dedicated;
+  vkGetBufferMemoryRequirements2(device, &info, &req);
 
-  if (VK_SUCCESS !=
-      vkAllocateMemory(device, &alloc_info, VK_NULL_HANDLE, device_memory)) {
-    free(offsets);
+  if (0 != Allocate(&req, &dedicated, property_flags, MEM_KIND_LINEAR,
+                    buffer, VK_NULL_HANDLE, allocation)) {
     return -1;
   }
 
+  if (VK_SUCCESS != vkBindBufferMemory(device, buffer, allocation->memory,
+                                       allocation->offset)) {
+    FreeMemory(allocation);
+    return -1;
+  }
+
+  return 0;
+}
+
+int AllocateImagesMemory(VkImage* images, uint32_t count,
+                         VkMemoryPropertyFlags property_flags,
+                         MemAllocation* allocations) {
+  memset(allocations, 0, sizeof(MemAllocation) * count);
   for (uint32_t i = 0; i < count; i++) {
-    if (VK_SUCCESS !=
-        vkBindImageMemory(device, images[i], *device_memory, offsets[i])) {
-      free(offsets);
+    VkImageMemoryRequirementsInfo2 info = {};
+    info.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    info.image = images[i];
+    VkMemoryDedicatedRequirements dedicated = {};
+    dedicated.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 req = {};
+    req.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    req.pNext = &dedicated;
+    vkGetImageMemoryRequirements2(device, &info, &req);
+
+    /* every image of the renderer uses optimal tiling */
+    if (0 != Allocate(&req, &dedicated, property_flags, MEM_KIND_OPTIMAL,
+                      VK_NULL_HANDLE, images[i], &allocations[i]) ||
+        VK_SUCCESS != vkBindImageMemory(device, images[i],
+                                        allocations[i].memory,
+                                        allocations[i].offset)) {
+      for (uint32_t j = 0; j <= i; j++) {
+        FreeMemory(&allocations[j]);
+      }
       return -1;
     }
   }
 
-  free(offsets);
-
   return 0;
 }
+
+void FreeMemory(MemAllocation* allocation) {
+  if (allocation->memory == VK_NULL_HANDLE) {
+    return;
+  }
+  pthread_mutex_lock(&mem_mutex);
+  MemTypeStats* stats = &type_stats[allocation->type_index];
+  stats->allocation_count--;
+  stats->requested_bytes -= allocation->size;
+
+  struct MemBlock* block = allocation->block;
+  if (block == NULL) {
+    stats->dedicated_count--;
+    stats->dedicated_bytes -= allocation->size;
+    vkFreeMemory(device, allocation->memory, VK_NULL_HANDLE);
+  } else {
+    stats->used_bytes -= MEM_MIN_ALLOCATION << allocation->order;
+    BlockFree(block,
+              (uint32_t)(allocation->offset / MEM_MIN_ALLOCATION),
+              allocation->order);
+    /* keep one empty block per pool around for the next allocation */
+    struct MemBlock** pool = &pools[block->type_index][block->kind];
+    if (block->used == 0 && (*pool != block || block->next != NULL)) {
+      while (*pool != block) {
+        pool = &(*pool)->next;
+      }
+      *pool = block->next;
+      DestroyBlock(block);
+    }
+  }
+  pthread_mutex_unlock(&mem_mutex);
+  memset(allocation, 0, sizeof(MemAllocation));
+}
+
+void MemDestroy(void) {
+  pthread_mutex_lock(&mem_mutex);
+  for (uint32_t t = 0; t < VK_MAX_MEMORY_TYPES; t++) {
+    if (type_stats[t].allocation_count > 0) {
+      fprintf(stderr, "%u allocations of memory type %u were not freed\n",
+              type_stats[t].allocation_count, t);
+    }
+    for (uint32_t kind = 0; kind < MEM_KIND_COUNT; kind++) {
+      while (pools[t][kind] != NULL) {
+        struct MemBlock* next = pools[t][kind]->next;
+        DestroyBlock(pools[t][kind]);
+        pools[t][kind] = next;
+      }
+    }
+  }
+  memset(type_stats, 0, sizeof(type_stats));
+  memory_properties_retrieved = false;
+  pthread_mutex_unlock(&mem_mutex);
+}
+
+void MemPrintStats(FILE* file) {
+  pthread_mutex_lock(&mem_mutex);
+  RetrieveMemoryProperties();
+  const double mib = 1.0 / (1024.0 * 1024.0);
+  for (uint32_t h = 0; h < memory_properties.memoryHeapCount; h++) {
+    MemTypeStats heap = {};
+    for (uint32_t t = 0; t < memory_properties.memoryTypeCount; t++) {
+      if (memory_properties.memoryTypes[t].heapIndex != h) {
+        continue;
+      }
+      heap.block_count += type_stats[t].block_count;
+      heap.block_bytes += type_stats[t].block_bytes;
+      heap.dedicated_count += type_stats[t].dedicated_count;
+      heap.dedicated_bytes += type_stats[t].dedicated_bytes;
+      heap.allocation_count += type_stats[t].allocation_count;
+      heap.requested_bytes += type_stats[t].requested_bytes;
+      heap.used_bytes += type_stats[t].used_bytes;
+    }
+    const VkMemoryHeap* properties = &memory_properties.memoryHeaps[h];
+    fprintf(file,
+            "heap %u (%s%.0f MiB): %u allocations, %u blocks %.1f MiB "
+            "with %.1f MiB used, %u dedicated %.1f MiB, %.1f MiB "
+            "requested\n",
+            h,
+            (properties->flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+                ? "device local, "
+                : "",
+            properties->size * mib, heap.allocation_count, heap.block_count,
+            heap.block_bytes * mib, heap.used_bytes * mib,
+            heap.dedicated_count, heap.dedicated_bytes * mib,
+            heap.requested_bytes * mib);
+  }
+  pthread_mutex_unlock(&mem_mutex);
+}
@@ -1,15 +1,52 @@
 #ifndef MEM_H_
 #define MEM_H_
 
+#include <stdbool.h>
+#include <stdio.h>
 #include <vulkan/vulkan.h>
 
+/* Device memory is taken from the driver in blocks of MEM_BLOCK_SIZE (less
+ * on small heaps) per memory type and split by a buddy allocator into
+ * power-of-two ranges of at least MEM_MIN_ALLOCATION bytes. Requests over
+ * half a block, or that the driver wants dedicated, get their own
+ * vkAllocateMemory. Host-visible memory stays mapped for its lifetime */
+#define MEM_BLOCK_SIZE (64ull << 20)
+#define MEM_MIN_ALLOCATION 256ull
+
+struct MemBlock;
+
+typedef struct {
+  VkDeviceMemory memory;
+  VkDeviceSize offset;
+  VkDeviceSize size;
+  /* the host address of offset, NULL unless the memory is host visible */
+  void* mapped;
+  /* NULL for a dedicated allocation */
+  struct MemBlock* block;
+  uint32_t type_index;
+  uint32_t order;
+} MemAllocation;
+
 int FindRequiredMemoryType(VkMemoryPropertyFlags property_flags,
                            uint32_t type_bits);
+
+/* allocate and bind memory for buffer */
 int AllocateBufferMemory(VkBuffer buffer, VkMemoryPropertyFlags property_flags,
-                         VkDeviceMemory* device_memory);
+                         MemAllocation* allocation);
 
+/* allocate and bind memory for each image, one allocation per image */
 int AllocateImagesMemory(VkImage* images, uint32_t count,
                          VkMemoryPropertyFlags property_flags,
-                         VkDeviceMemory* device_memory);
+                         MemAllocation* allocations);
+
+/* the resource bound to it must be destroyed or no longer in use, freeing a
+ * zeroed allocation does nothing */
+void FreeMemory(MemAllocation* allocation);
+
+/* release the blocks, every allocation must have been freed */
+void MemDestroy(void);
+
+/* blocks, dedicated allocations and bytes in use for every heap */
+void MemPrintStats(FILE* file);
 
 #endif  // MEM_H_
@@ -0,0 +1,289 @@
+#include "pipeline.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+extern VkDevice device;
+extern VkPhysicalDevice physical_device;
+
+/* generated by the build from the compiled shaders */
+extern const PipelineShader pipeline_shaders[];
+extern const uint32_t pipeline_shader_count;
+
+static VkPipelineCache pipeline_cache = VK_NULL_HANDLE;
+static char cache_path[1024] = "";
+
+void PipelineSetCachePath(const char* path) {
+  snprintf(cache_path, sizeof(cache_path), "%s", path);
+}
+
+/* the file's contents, NULL when it cannot be read */
+static void* ReadCacheFile(size_t* size) {
+  FILE* file = fopen(cache_path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  long length = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  void* data = length > 0 ? malloc((size_t)length) : NULL;
+  if (data != NULL && fread(data, 1, (size_t)length, file) != (size_t)length) {
+    free(data);
+    data = NULL;
+  }
+  fclose(file);
+  *size = (size_t)length;
+  return data;
+}
+
+/* drivers reject data from other devices themselves, but not all of them
+ * gracefully. The header every cache starts with says whose it is */
+static bool CacheMatchesDevice(const void* data, size_t size) {
+  VkPipelineCacheHeaderVersionOne header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  memcpy(&header, data, sizeof(header));
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  return header.headerSize >= sizeof(header) && header.headerSize <= size &&
+         header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == properties.vendorID &&
+         header.deviceID == properties.deviceID &&
+         0 == memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID,
+                     VK_UUID_SIZE);
+}
+
+int CreatePipelineCache(void) {
+  if (cache_path[0] == '\0') {
+    PipelineSetCachePath(PIPELINE_CACHE_FILE);
+  }
+
+  size_t size = 0;
+  void* data = ReadCacheFile(&size);
+  if (data != NULL && !CacheMatchesDevice(data, size)) {
+    fprintf(stderr, "%s is from another device or driver, not using it\n",
+            cache_path);
+    free(data);
+    data = NULL;
+  }
+
+  VkPipelineCacheCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  create_info.initialDataSize = data != NULL ? size : 0;
+  create_info.pInitialData = data;
+  VkResult res = vkCreatePipelineCache(device, &create_info, VK_NULL_HANDLE,
+                                       &pipeline_cache);
+  free(data);
+  if (VK_SUCCESS != res) {
+    fprintf(stderr, "Failed to create the pipeline cache\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* through a temporary file, a run killed while saving leaves the previous
+ * cache intact */
+static void SaveCache(void) {
+  size_t size = 0;
+  if (VK_SUCCESS !=
+          vkGetPipelineCacheData(device, pipeline_cache, &size, NULL) ||
+      size == 0) {
+    return;
+  }
+  void* data = malloc(size);
+  if (data == NULL || VK_SUCCESS != vkGetPipelineCacheData(
+                                        device, pipeline_cache, &size, data)) {
+    free(data);
+    return;
+  }
+
+  char temporary[sizeof(cache_path) + 4];
+  snprintf(temporary, sizeof(temporary), "%s.tmp", cache_path);
+  FILE* file = fopen(temporary, "wb");
+  bool written = file != NULL && fwrite(data, 1, size, file) == size;
+  if (file != NULL && 0 != fclose(file)) {
+    written = false;
+  }
+  free(data);
+  if (!written || 0 != rename(temporary, cache_path)) {
+    fprintf(stderr, "Failed to save the pipeline cache to %s\n", cache_path);
+    remove(temporary);
+  }
+}
+
+void DestroyPipelineCache(void) {
+  if (pipeline_cache == VK_NULL_HANDLE) {
+    return;
+  }
+  SaveCache();
+  vkDestroyPipelineCache(device, pipeline_cache, VK_NULL_HANDLE);
+  pipeline_cache = VK_NULL_HANDLE;
+}
+
+int PipelineLoadShaderModule(const char* name, VkShaderModule* module) {
+  const PipelineShader* shader = NULL;
+  for (uint32_t i = 0; i < pipeline_shader_count; i++) {
+    if (0 == strcmp(pipeline_shaders[i].name, name)) {
+      shader = &pipeline_shaders[i];
+      break;
+    }
+  }
+  if (shader == NULL) {
+    fprintf(stderr, "No embedded shader %s\n", name);
+    return -1;
+  }
+
+  VkShaderModuleCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+  create_info.codeSize = shader->size;
+  create_info.pCode = shader->code;
+  if (VK_SUCCESS !=
+      vkCreateShaderModule(device, &create_info, VK_NULL_HANDLE, module)) {
+    fprintf(stderr, "Failed to create shader module %s\n", name);
+    return -1;
+  }
+  return 0;
+}
+
+VkPipeline PipelineCreateGraphics(const PipelineGraphicsDesc* desc) {
+  VkShaderModule vertex_module = VK_NULL_HANDLE;
+  VkShaderModule fragment_module = VK_NULL_HANDLE;
+  if (0 != PipelineLoadShaderModule(desc->vertex_shader, &vertex_module) ||
+      0 != PipelineLoadShaderModule(desc->fragment_shader, &fragment_module)) {
+    if (vertex_module != VK_NULL_HANDLE) {
+      vkDestroyShaderModule(device, vertex_module, VK_NULL_HANDLE);
+    }
+    return VK_NULL_HANDLE;
+  }
+
+  VkPipelineShaderStageCreateInfo stages[2] = {};
+  stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+  stages[0].module = vertex_module;
+  stages[0].pName = "main";
+  stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+  stages[1].module = fragment_module;
+  stages[1].pName = "main";
+
+  VkPipelineVertexInputStateCreateInfo vertex_input = {};
+  vertex_input.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+  vertex_input.vertexBindingDescriptionCount = desc->binding_count;
+  vertex_input.pVertexBindingDescriptions = desc->bindings;
+  vertex_input.vertexAttributeDescriptionCount = desc->attribute_count;
+  vertex_input.pVertexAttributeDescriptions = desc->attributes;
+
+  VkPipelineInputAssemblyStateCreateInfo input_assembly = {};
+  input_assembly.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+  input_assembly.topology = desc->topology;
+
+  VkPipelineViewportStateCreateInfo viewport_state = {};
+  viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+  viewport_state.viewportCount = 1;
+  viewport_state.scissorCount = 1;
+
+  VkPipelineRasterizationStateCreateInfo rasterization = {};
+  rasterization.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+  rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+  rasterization.cullMode = VK_CULL_MODE_NONE;
+  rasterization.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  rasterization.lineWidth = 1.0f;
+
+  VkPipelineMultisampleStateCreateInfo multisample = {};
+  multisample.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+  multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  VkPipelineDepthStencilStateCreateInfo depth_stencil = {};
+  depth_stencil.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+
+  VkPipelineColorBlendAttachmentState blend_attachment = {};
+  if (desc->alpha_blend) {
+    blend_attachment.blendEnable = VK_TRUE;
+    blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+    blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+    blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+    blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+    blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+    blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+  }
+  blend_attachment.colorWriteMask =
+      VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+      VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+  VkPipelineColorBlendStateCreateInfo color_blend = {};
+  color_blend.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+  color_blend.attachmentCount = 1;
+  color_blend.pAttachments = &blend_attachment;
+
+  VkDynamicState dynamic_states[] = {VK_DYNAMIC_STATE_VIEWPORT,
+                                     VK_DYNAMIC_STATE_SCISSOR};
+  VkPipelineDynamicStateCreateInfo dynamic_state = {};
+  dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+  dynamic_state.dynamicStateCount = 2;
+  dynamic_state.pDynamicStates = dynamic_states;
+
+  VkPipelineRenderingCreateInfo rendering = {};
+  rendering.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+  rendering.colorAttachmentCount = 1;
+  rendering.pColorAttachmentFormats = &desc->color_format;
+  rendering.depthAttachmentFormat = desc->depth_format;
+
+  VkGraphicsPipelineCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  create_info.pNext = &rendering;
+  create_info.stageCount = 2;
+  create_info.pStages = stages;
+  create_info.pVertexInputState = &vertex_input;
+  create_info.pInputAssemblyState = &input_assembly;
+  create_info.pViewportState = &viewport_state;
+  create_info.pRasterizationState = &rasterization;
+  create_info.pMultisampleState = &multisample;
+  create_info.pDepthStencilState = &depth_stencil;
+  create_info.pColorBlendState = &color_blend;
+  create_info.pDynamicState = &dynamic_state;
+  create_info.layout = desc->layout;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult res = vkCreateGraphicsPipelines(device, pipeline_cache, 1,
+                                           &create_info, VK_NULL_HANDLE,
+                                           &pipeline);
+  vkDestroyShaderModule(device, vertex_module, VK_NULL_HANDLE);
+  vkDestroyShaderModule(device, fragment_module, VK_NULL_HANDLE);
+  if (VK_SUCCESS != res) {
+    fprintf(stderr, "Failed to create pipeline %s, %s\n", desc->vertex_shader,
+            desc->fragment_shader);
+    return VK_NULL_HANDLE;
+  }
+  return pipeline;
+}
+
+VkPipeline PipelineCreateCompute(const char* shader, VkPipelineLayout layout) {
+  VkShaderModule module = VK_NULL_HANDLE;
+  if (0 != PipelineLoadShaderModule(shader, &module)) {
+    return VK_NULL_HANDLE;
+  }
+
+  VkComputePipelineCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+  create_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+  create_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  create_info.stage.module = module;
+  create_info.stage.pName = "main";
+  create_info.layout = layout;
+
+  VkPipeline pipeline = VK_NULL_HANDLE;
+  VkResult res = vkCreateComputePipelines(device, pipeline_cache, 1,
+                                          &create_info, VK_NULL_HANDLE,
+                                          &pipeline);
+  vkDestroyShaderModule(device, module, VK_NULL_HANDLE);
+  if (VK_SUCCESS != res) {
+    fprintf(stderr, "Failed to create compute pipeline %s\n", shader);
+    return VK_NULL_HANDLE;
+  }
+  return pipeline;
+}
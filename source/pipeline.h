@@ -0,0 +1,63 @@
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/* the cache file in the working directory, unless PipelineSetCachePath()
+ * picks another */
+#define PIPELINE_CACHE_FILE "pipeline_cache.bin"
+
+/* a shader compiled to SPIR-V and embedded into the executable by the
+ * build, see cmake/embed_spirv.cmake */
+typedef struct {
+  /* the source's file name with .spv appended, "graph.frag.spv" */
+  const char* name;
+  const uint32_t* code;
+  size_t size;
+} PipelineShader;
+
+/* what differs between the graphics pipelines. The rest is the state every
+ * draw uses: filled polygons without culling or depth test, dynamic
+ * viewport and scissor, one sample, dynamic rendering */
+typedef struct {
+  const char* vertex_shader;
+  const char* fragment_shader;
+  VkPipelineLayout layout;
+  VkPrimitiveTopology topology;
+  const VkVertexInputBindingDescription* bindings;
+  uint32_t binding_count;
+  const VkVertexInputAttributeDescription* attributes;
+  uint32_t attribute_count;
+  /* blend by source alpha instead of overwriting the attachment */
+  bool alpha_blend;
+  /* of the attachments the pipeline renders into, VK_FORMAT_UNDEFINED for
+   * no depth attachment */
+  VkFormat color_format;
+  VkFormat depth_format;
+} PipelineGraphicsDesc;
+
+/* where the cache is loaded from and saved to, call before
+ * CreatePipelineCache(). Takes a plain path so the cache can be created on
+ * a thread that must not call SDL */
+void PipelineSetCachePath(const char* path);
+
+/* load the cache a previous run saved. A missing file, or one written for
+ * another device or driver, starts an empty cache. Call after the device
+ * exists */
+int CreatePipelineCache(void);
+
+/* save the cache and destroy it, before the device. Does nothing without
+ * a cache */
+void DestroyPipelineCache(void);
+
+/* a module from the embedded shader called name */
+int PipelineLoadShaderModule(const char* name, VkShaderModule* module);
+
+/* VK_NULL_HANDLE on failure. Both go through the cache */
+VkPipeline PipelineCreateGraphics(const PipelineGraphicsDesc* desc);
+VkPipeline PipelineCreateCompute(const char* shader, VkPipelineLayout layout);
+
+#endif  // PIPELINE_H_
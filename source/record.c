@@ -0,0 +1,267 @@
+#include "record.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "frame.h"
+#include "trace.h"
+
+extern VkDevice device;
+extern uint32_t queue_family_index;
+
+/* what one thread records into. Command pools are externally synchronized,
+ * so every thread has its own, one per frame context since the secondaries
+ * of a context can only be reset once its fence has signaled */
+typedef struct {
+  VkCommandPool pools[FRAME_MAX_IN_FLIGHT];
+  /* allocated from pools[f] so far, reused after every reset */
+  VkCommandBuffer cmds[FRAME_MAX_IN_FLIGHT][RECORD_MAX_SLICES];
+  uint32_t allocated[FRAME_MAX_IN_FLIGHT];
+  /* of cmds[frame] in the dispatch in progress */
+  uint32_t used;
+} RecordThread;
+
+/* the graph's draws are a handful of slices, which one thread records
+ * faster than it can wake the others */
+static uint32_t requested_threads = 1;
+/* threads[0] is the caller's, the rest belong to the pool threads */
+static RecordThread threads[RECORD_MAX_THREADS];
+static uint32_t thread_count = 0;
+static uint32_t frame_count = 0;
+
+/* the pool stays alive for the whole run, a dispatch hands out slices from
+ * a shared counter like the layout workers do */
+static pthread_t workers[RECORD_MAX_THREADS];
+static uint32_t worker_count = 0;
+static pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t start = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done = PTHREAD_COND_INITIALIZER;
+static uint64_t generation = 0;
+static uint32_t running = 0;
+static bool quit = false;
+
+/* the dispatch in progress, written before the pool is woken */
+static const VkCommandBufferInheritanceRenderingInfo* dispatch_rendering;
+static RecordSlice dispatch_record;
+static void* dispatch_user;
+static uint32_t dispatch_frame;
+static uint32_t dispatch_slices;
+static uint32_t next_slice;
+/* VK_NULL_HANDLE for a slice that failed to record */
+static VkCommandBuffer slices[RECORD_MAX_SLICES];
+
+int RecordSetThreads(uint32_t count) {
+  if (count > RECORD_MAX_THREADS) {
+    fprintf(stderr, "at most %u recording threads\n", RECORD_MAX_THREADS);
+    return -1;
+  }
+  requested_threads = count;
+  return 0;
+}
+
+uint32_t RecordThreads(void) { return thread_count; }
+
+static VkCommandBuffer NextCommandBuffer(RecordThread* thread) {
+  uint32_t frame = dispatch_frame;
+  if (thread->used == thread->allocated[frame]) {
+    VkCommandBufferAllocateInfo allocate_info = {};
+    allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocate_info.commandPool = thread->pools[frame];
+    allocate_info.commandBufferCount = 1;
+    if (VK_SUCCESS !=
+        vkAllocateCommandBuffers(device, &allocate_info,
+                                 &thread->cmds[frame][thread->used])) {
+      return VK_NULL_HANDLE;
+    }
+    thread->allocated[frame]++;
+  }
+  return thread->cmds[frame][thread->used++];
+}
+
+static void RecordRunSlices(RecordThread* thread) {
+  TRACE_BEGIN("record_slices");
+  VkCommandBufferInheritanceInfo inheritance = {};
+  inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+  inheritance.pNext = dispatch_rendering;
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+                     VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+  begin_info.pInheritanceInfo = &inheritance;
+
+  for (;;) {
+    uint32_t slice = __atomic_fetch_add(&next_slice, 1u, __ATOMIC_RELAXED);
+    if (slice >= dispatch_slices) {
+      break;
+    }
+    slices[slice] = VK_NULL_HANDLE;
+    VkCommandBuffer cmd = NextCommandBuffer(thread);
+    if (cmd == VK_NULL_HANDLE ||
+        VK_SUCCESS != vkBeginCommandBuffer(cmd, &begin_info)) {
+      fprintf(stderr, "Failed to begin recording slice %u\n", slice);
+      continue;
+    }
+    dispatch_record(cmd, slice, dispatch_user);
+    if (VK_SUCCESS != vkEndCommandBuffer(cmd)) {
+      fprintf(stderr, "Failed to record slice %u\n", slice);
+      continue;
+    }
+    slices[slice] = cmd;
+  }
+  TRACE_END("record_slices");
+}
+
+static void* RecordWorkerMain(void* arg) {
+  RecordThread* thread = (RecordThread*)arg;
+  uint64_t seen = 0;
+
+  for (;;) {
+    pthread_mutex_lock(&mutex);
+    while (generation == seen && !quit) {
+      pthread_cond_wait(&start, &mutex);
+    }
+    if (quit) {
+      pthread_mutex_unlock(&mutex);
+      break;
+    }
+    seen = generation;
+    pthread_mutex_unlock(&mutex);
+
+    RecordRunSlices(thread);
+
+    pthread_mutex_lock(&mutex);
+    if (--running == 0) {
+      pthread_cond_signal(&done);
+    }
+    pthread_mutex_unlock(&mutex);
+  }
+  return NULL;
+}
+
+int CreateRecorder(void) {
+  thread_count = requested_threads;
+  if (thread_count == 0) {
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    thread_count = online > 0 ? (uint32_t)online : 1u;
+  }
+  if (thread_count > RECORD_MAX_THREADS) {
+    thread_count = RECORD_MAX_THREADS;
+  }
+  frame_count = FrameInFlight();
+  memset(threads, 0, sizeof(threads));
+
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  /* reset as a whole when the frame context comes around again */
+  pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex = queue_family_index;
+  for (uint32_t i = 0; i < thread_count; i++) {
+    for (uint32_t f = 0; f < frame_count; f++) {
+      if (VK_SUCCESS != vkCreateCommandPool(device, &pool_info,
+                                            VK_NULL_HANDLE,
+                                            &threads[i].pools[f])) {
+        fprintf(stderr, "Failed to create recording command pools\n");
+        DestroyRecorder();
+        return -1;
+      }
+    }
+  }
+
+  /* a failed thread creation only costs speed, the slices are handed out
+   * to whoever is running */
+  for (uint32_t i = 1; i < thread_count; i++) {
+    if (0 != pthread_create(&workers[worker_count], NULL, RecordWorkerMain,
+                            &threads[i])) {
+      break;
+    }
+    worker_count++;
+  }
+  return 0;
+}
+
+void DestroyRecorder(void) {
+  pthread_mutex_lock(&mutex);
+  quit = true;
+  pthread_cond_broadcast(&start);
+  pthread_mutex_unlock(&mutex);
+  for (uint32_t i = 0; i < worker_count; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  worker_count = 0;
+  quit = false;
+  generation = 0;
+
+  /* frees the secondaries as well */
+  for (uint32_t i = 0; i < thread_count; i++) {
+    for (uint32_t f = 0; f < frame_count; f++) {
+      if (threads[i].pools[f] != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(device, threads[i].pools[f], VK_NULL_HANDLE);
+      }
+    }
+  }
+  memset(threads, 0, sizeof(threads));
+  thread_count = 0;
+}
+
+void RecordSecondaries(VkCommandBuffer primary,
+                       const VkCommandBufferInheritanceRenderingInfo* rendering,
+                       uint32_t slice_count, RecordSlice record, void* user) {
+  if (slice_count == 0 || thread_count == 0) {
+    return;
+  }
+  if (slice_count > RECORD_MAX_SLICES) {
+    fprintf(stderr, "%u slices, recording only %u\n", slice_count,
+            RECORD_MAX_SLICES);
+    slice_count = RECORD_MAX_SLICES;
+  }
+
+  /* FrameWait() waited for this context's previous submission, and the
+   * pool threads are idle between dispatches */
+  dispatch_frame = FrameIndex();
+  for (uint32_t i = 0; i < thread_count; i++) {
+    vkResetCommandPool(device, threads[i].pools[dispatch_frame], 0);
+    threads[i].used = 0;
+  }
+  dispatch_rendering = rendering;
+  dispatch_record = record;
+  dispatch_user = user;
+  dispatch_slices = slice_count;
+  next_slice = 0;
+
+  /* a single slice is not worth waking anyone */
+  uint32_t helpers = slice_count > 1 ? worker_count : 0;
+  if (helpers > 0) {
+    pthread_mutex_lock(&mutex);
+    running = helpers;
+    generation++;
+    pthread_cond_broadcast(&start);
+    pthread_mutex_unlock(&mutex);
+  }
+
+  RecordRunSlices(&threads[0]);
+
+  if (helpers > 0) {
+    pthread_mutex_lock(&mutex);
+    while (running != 0) {
+      pthread_cond_wait(&done, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+  }
+
+  /* executed in slice order whoever recorded them, so draws keep the order
+   * they would have had in the primary */
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < slice_count; i++) {
+    if (slices[i] != VK_NULL_HANDLE) {
+      slices[count++] = slices[i];
+    }
+  }
+  if (count > 0) {
+    vkCmdExecuteCommands(primary, count, slices);
+  }
+}
@@ -0,0 +1,39 @@
+#ifndef RECORD_H_
+#define RECORD_H_
+
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/* recording threads, the caller included */
+#define RECORD_MAX_THREADS 16u
+/* secondary command buffers one RecordSecondaries() call can execute */
+#define RECORD_MAX_SLICES 64u
+
+/* record slice into cmd, a secondary command buffer continuing the
+ * rendering pass of the primary. Runs on any recording thread, only state
+ * nothing writes during the call may be read */
+typedef void (*RecordSlice)(VkCommandBuffer cmd, uint32_t slice, void* user);
+
+/* the number of threads CreateRecorder() records on, 1 unless set, 0 for
+ * one per online core. -1 over RECORD_MAX_THREADS */
+int RecordSetThreads(uint32_t count);
+
+uint32_t RecordThreads(void);
+
+/* start the recording threads with a command pool per thread and frame
+ * context, call after CreateFrames() */
+int CreateRecorder(void);
+
+/* the frame contexts must be idle */
+void DestroyRecorder(void);
+
+/* record slice_count secondaries in parallel and execute them into primary
+ * in slice order. primary must be inside a vkCmdBeginRendering with
+ * VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT whose attachments
+ * have the formats of rendering. At most once per frame, the secondaries
+ * of the current frame context are recycled by the call */
+void RecordSecondaries(VkCommandBuffer primary,
+                       const VkCommandBufferInheritanceRenderingInfo* rendering,
+                       uint32_t slice_count, RecordSlice record, void* user);
+
+#endif  // RECORD_H_
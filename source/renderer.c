@@ -5,91 +5,67 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "frame.h"
+#include "graph_renderer.h"
 #include "mem.h"
+#include "record.h"
+#include "staging.h"
+#include "timing.h"
 
 extern VkDevice device;
-extern uint32_t queue_family_index;
+extern bool vulkan_headless;
 extern VkQueue graphics_queue;
 extern uint32_t swapchain_image_count;
 extern uint32_t swapchain_frame_count;
 extern uint32_t swapchain_current_frame;
 extern uint32_t swapchain_current_image;
 extern VkExtent2D swapchain_size;
+extern VkFormat swapchain_image_format;
 extern VkImage* swapchain_images;
 extern VkImageView* swapchain_image_views;
-extern VkSemaphore* image_available_semaphores;
 extern VkSemaphore* render_finished_semaphores;
-extern VkFence* in_flight_fences;
-
-static VkCommandPool command_pool = VK_NULL_HANDLE;
-
-VkCommandBuffer* command_buffers = NULL;
-
-static VkBuffer vertex_buffer;
-static VkDeviceMemory vertex_buffer_memory;
 
 /* depth image */
 static VkImage* depth_images;
 static VkImageView* depth_image_views;
-static VkDeviceMemory depth_images_memory;
+static MemAllocation* depth_images_memory;
 static VkFormat depth_image_format;
 
-static int CreateCommandBuffers(void) {
-  VkCommandPoolCreateInfo create_info = {};
-  create_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-  create_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-  create_info.queueFamilyIndex = queue_family_index;
-
-  if (VK_SUCCESS != vkCreateCommandPool(device, &create_info, VK_NULL_HANDLE,
-                                        &command_pool)) {
-    return -1;
-  }
-
-  VkCommandBufferAllocateInfo allocate_info = {};
-  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-
-  allocate_info.commandPool = command_pool;
-  allocate_info.commandBufferCount = swapchain_image_count;
-
-  command_buffers =
-      (VkCommandBuffer*)malloc(sizeof(VkCommandBuffer) * swapchain_image_count);
-  if (VK_SUCCESS !=
-      vkAllocateCommandBuffers(device, &allocate_info, command_buffers)) {
-    return -1;
-  }
-
-  return 0;
-}
-
-static int SubmitRenderCommandBuffer() {
-  VkCommandBuffer cmd = command_buffers[swapchain_current_frame];
+static void SubmitRenderCommandBuffer(void) {
+  FrameContext* frame = FrameCurrent();
+  VkCommandBuffer cmd = frame->cmd;
 
   VkSubmitInfo submit_info = {};
   submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
   submit_info.commandBufferCount = 1;
   submit_info.pCommandBuffers = &cmd;
-  submit_info.waitSemaphoreCount = 1;
-  submit_info.pWaitSemaphores =
-      &image_available_semaphores[swapchain_current_frame];
-  submit_info.signalSemaphoreCount = 1;
-  submit_info.pSignalSemaphores =
-      &render_finished_semaphores[swapchain_current_image];
+  /* offscreen images are neither acquired nor presented */
+  if (!vulkan_headless) {
+    submit_info.waitSemaphoreCount = 1;
+    submit_info.pWaitSemaphores = &frame->image_available;
+    submit_info.signalSemaphoreCount = 1;
+    submit_info.pSignalSemaphores =
+        &render_finished_semaphores[swapchain_current_image];
+  }
 
   VkPipelineStageFlags wait_stages[] = {
       VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
   submit_info.pWaitDstStageMask = wait_stages;
 
-  vkQueueSubmit(graphics_queue, 1, &submit_info,
-                in_flight_fences[swapchain_current_frame]);
+  double start = TimingNow();
+  vkQueueSubmit(graphics_queue, 1, &submit_info, frame->in_flight);
+  TimingRecord(TIMING_SUBMIT, start);
+  StagingEndFrame(frame->in_flight);
 }
 
 static int CreateDepthImages(void) {
   depth_image_format = VK_FORMAT_D32_SFLOAT;
 
-  depth_images = (VkImage*)malloc(sizeof(VkImage) * swapchain_frame_count);
+  depth_images = (VkImage*)calloc(swapchain_frame_count, sizeof(VkImage));
   depth_image_views =
-      (VkImageView*)malloc(sizeof(VkImageView) * swapchain_frame_count);
+      (VkImageView*)calloc(swapchain_frame_count, sizeof(VkImageView));
+  depth_images_memory = (MemAllocation*)calloc(swapchain_frame_count,
+                                               sizeof(MemAllocation));
   VkImageCreateInfo create_info = {
       .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
       .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
@@ -129,7 +105,7 @@ static int CreateDepthImages(void) {
 
   if (0 != AllocateImagesMemory(depth_images, swapchain_frame_count,
                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                &depth_images_memory)) {
+                                depth_images_memory)) {
     return -1;
   }
 
@@ -144,7 +120,7 @@ static int CreateDepthImages(void) {
   return 0;
 }
 
-VkBuffer CreateBuffer(uint32_t size, VkBufferUsageFlags usage_flags) {
+VkBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage_flags) {
   VkBufferCreateInfo create_info = {};
   create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
   create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -154,32 +130,34 @@ VkBuffer CreateBuffer(uint32_t size, VkBufferUsageFlags usage_flags) {
   VkBuffer res = VK_NULL_HANDLE;
   if (VK_SUCCESS !=
       vkCreateBuffer(device, &create_info, VK_NULL_HANDLE, &res)) {
-    fprintf(stderr, "failed to create buffer %d %d \n", size, usage_flags);
+    fprintf(stderr, "failed to create buffer %llu %d \n",
+            (unsigned long long)size, usage_flags);
   }
 
   return res;
 }
 
 int CreateRenderer(void) {
-  if (0 != CreateCommandBuffers()) {
-    fprintf(stderr, "Failed to create command buffers");
+  if (0 != CreateFrames()) {
     return -1;
   }
 
-  vertex_buffer = CreateBuffer(100u, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
-  if (0 != AllocateBufferMemory(vertex_buffer,
-                                VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                                &vertex_buffer_memory)) {
+  if (0 != CreateDepthImages()) {
     return -1;
   }
 
-  if (0 != CreateDepthImages()) {
+  if (0 != CreateStaging()) {
     return -1;
   }
+
+  if (0 != CreateRecorder()) {
+    return -1;
+  }
+  return 0;
 }
 
 static void PreRender(void) {
-  VkCommandBuffer cmd = command_buffers[swapchain_current_frame];
+  VkCommandBuffer cmd = FrameCurrent()->cmd;
   /* transition the current image to Present layout */
   VkImageMemoryBarrier image_memory_barrier = {
       .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
@@ -201,13 +179,14 @@ static void PreRender(void) {
 }
 
 static void PostRender(void) {
-  VkCommandBuffer cmd = command_buffers[swapchain_current_frame];
+  VkCommandBuffer cmd = FrameCurrent()->cmd;
   /* transition the current image to Present layout */
   VkImageMemoryBarrier image_memory_barrier = {
       .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
       .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
       .oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-      .newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+      .newLayout = vulkan_headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL
+                                   : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
       .image = swapchain_images[swapchain_current_image],
       .subresourceRange = {
           .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
@@ -223,16 +202,24 @@ static void PostRender(void) {
 }
 
 void Render(void) {
-  VkCommandBuffer cmd = command_buffers[swapchain_current_frame];
+  VkCommandBuffer cmd = FrameCurrent()->cmd;
 
   VkCommandBufferBeginInfo begin_info = {};
   begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 
-  /* reset and begin rendering */
-  vkResetCommandBuffer(cmd, 0);
+  /* acquiring the image recycled the frame's context, its pool is reset */
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
   vkBeginCommandBuffer(cmd, &begin_info);
+  TimingMarkGpu(cmd, TIMING_MARK_BEGIN);
+  StagingBeginFrame(cmd, FrameCurrent()->in_flight);
 
+  /* copies cannot be recorded inside the rendering pass */
+  GraphRendererRecordUploads(cmd);
+  GraphRendererRecordLayout(cmd);
+
+  TimingMarkGpu(cmd, TIMING_MARK_PRE_RENDER);
   PreRender();
+  TimingMarkGpu(cmd, TIMING_MARK_DRAW);
 
   /* dynamic rendering */
   VkRenderingInfo rendering_info = {};
@@ -268,16 +255,29 @@ void Render(void) {
 
   rendering_info.layerCount = 1;
   VkRect2D render_area = {.offset = {.x = 0, .y = 0},
-                          .extent = {.width = 800, .height = 600}};
+                          .extent = swapchain_size};
   rendering_info.renderArea = render_area;
 
+  /* the draws are recorded on several threads into secondaries, which
+   * have to know the attachment formats they continue the pass with */
+  rendering_info.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT;
+  VkCommandBufferInheritanceRenderingInfo inheritance = {};
+  inheritance.sType =
+      VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO;
+  inheritance.colorAttachmentCount = 1;
+  inheritance.pColorAttachmentFormats = &swapchain_image_format;
+  inheritance.depthAttachmentFormat = depth_image_format;
+  inheritance.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
   vkCmdBeginRendering(cmd, &rendering_info);
 
-  /* TODO: rendering */
+  GraphRendererDraw(cmd, &inheritance);
 
   vkCmdEndRendering(cmd);
 
+  TimingMarkGpu(cmd, TIMING_MARK_POST_RENDER);
   PostRender();
+  TimingMarkGpu(cmd, TIMING_MARK_END);
 
   vkEndCommandBuffer(cmd);
 
@@ -285,31 +285,42 @@ void Render(void) {
 }
 
 static void DestroyDepthImages(void) {
-  for (uint32_t i = 0; i < swapchain_frame_count; i++) {
+  for (uint32_t i = 0; i < swapchain_frame_count && depth_images != NULL;
+       i++) {
     if (depth_images[i] != VK_NULL_HANDLE) {
       vkDestroyImage(device, depth_images[i], VK_NULL_HANDLE);
     }
     if (depth_image_views[i] != VK_NULL_HANDLE) {
       vkDestroyImageView(device, depth_image_views[i], VK_NULL_HANDLE);
     }
-    if (depth_images_memory != VK_NULL_HANDLE) {
-      vkFreeMemory(device, depth_images_memory, VK_NULL_HANDLE);
+  }
+  free(depth_images);
+  depth_images = NULL;
+  free(depth_image_views);
+  depth_image_views = NULL;
+  if (depth_images_memory != NULL) {
+    for (uint32_t i = 0; i < swapchain_frame_count; i++) {
+      FreeMemory(&depth_images_memory[i]);
     }
+    free(depth_images_memory);
+    depth_images_memory = NULL;
   }
 }
 
-static void DestroyCommandBuffers(void) {
-  if (command_buffers != NULL) {
-    vkFreeCommandBuffers(device, command_pool, swapchain_image_count,
-                         command_buffers);
-    free(command_buffers);
-  }
-  if (command_pool != VK_NULL_HANDLE) {
-    vkDestroyCommandPool(device, command_pool, VK_NULL_HANDLE);
+int RendererResize(void) {
+  /* VulkanRecreateSwapchain() waited for the device */
+  DestroyDepthImages();
+  if (0 != CreateDepthImages()) {
+    fprintf(stderr, "Failed to recreate the depth images\n");
+    return -1;
   }
+  return 0;
 }
+
 void DestroyRenderer(void) {
   vkDeviceWaitIdle(device);
+  DestroyRecorder();
+  DestroyStaging();
   DestroyDepthImages();
-  DestroyCommandBuffers();
+  DestroyFrames();
 }
@@ -6,10 +6,14 @@
 /* create the rendering resources */
 int CreateRenderer(void);
 
-VkBuffer CreateBuffer(uint32_t size, VkBufferUsageFlags usage_flags);
+VkBuffer CreateBuffer(VkDeviceSize size, VkBufferUsageFlags usage_flags);
 
 void Render(void);
 
+/* recreate what is sized like the swapchain, after
+ * VulkanRecreateSwapchain() */
+int RendererResize(void);
+
 void DestroyRenderer(void);
 
 #endif  // RENDERER_H_
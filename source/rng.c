@@ -0,0 +1,132 @@
+
+#include "rng.h"
+
+#include <string.h>
+
+static uint64_t SplitMix64(uint64_t* state) {
+  uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31);
+}
+
+void RngSeed(Rng* rng, uint64_t seed) { RngSeedStream(rng, seed, 0); }
+
+void RngSeedStream(Rng* rng, uint64_t seed, uint64_t stream) {
+  /* the stream is hashed into the splitmix state so neighbouring streams do
+   * not share a prefix */
+  uint64_t state = seed;
+  uint64_t stream_state = stream;
+  state ^= SplitMix64(&stream_state);
+  for (int i = 0; i < 4; i++) {
+    rng->s[i] = SplitMix64(&state);
+  }
+  /* the all-zero state is a fixed point */
+  if ((rng->s[0] | rng->s[1] | rng->s[2] | rng->s[3]) == 0) {
+    rng->s[0] = 1;
+  }
+}
+
+static void RngJumpBy(Rng* rng, const uint64_t polynomial[4]) {
+  uint64_t s[4] = {0, 0, 0, 0};
+  for (int i = 0; i < 4; i++) {
+    for (int b = 0; b < 64; b++) {
+      if (polynomial[i] & (1ull << b)) {
+        s[0] ^= rng->s[0];
+        s[1] ^= rng->s[1];
+        s[2] ^= rng->s[2];
+        s[3] ^= rng->s[3];
+      }
+      RngNext(rng);
+    }
+  }
+  memcpy(rng->s, s, sizeof(s));
+}
+
+void RngJump(Rng* rng) {
+  static const uint64_t jump[4] = {
+      0x180ec6d33cfd0abaull, 0xd5a61266f0c9392cull, 0xa9582618e03fc9aaull,
+      0x39abdc4529b1661cull};
+  RngJumpBy(rng, jump);
+}
+
+void RngLongJump(Rng* rng) {
+  static const uint64_t long_jump[4] = {
+      0x76e15d3efefdcbbfull, 0xc5004e441c522fb3ull, 0x77710069854ee241ull,
+      0x39109bb02acbe635ull};
+  RngJumpBy(rng, long_jump);
+}
+
+uint64_t RngUniform(Rng* rng, uint64_t bound) {
+  /* Lemire's nearly divisionless method */
+  unsigned __int128 product = (unsigned __int128)RngNext(rng) * bound;
+  uint64_t low = (uint64_t)product;
+  if (low < bound) {
+    uint64_t threshold = -bound % bound;
+    while (low < threshold) {
+      product = (unsigned __int128)RngNext(rng) * bound;
+      low = (uint64_t)product;
+    }
+  }
+  return (uint64_t)(product >> 64);
+}
+
+uint64_t RngCounter(uint64_t seed, uint64_t counter) {
+  uint64_t state = counter * 0x9e3779b97f4a7c15ull;
+  uint64_t mixed = SplitMix64(&state);
+  state = seed ^ mixed;
+  return SplitMix64(&state);
+}
+
+void RngBatchSeed(RngBatch* batch, uint64_t seed, uint64_t stream) {
+  Rng lane;
+  RngSeedStream(&lane, seed, stream);
+  for (int l = 0; l < RNG_LANES; l++) {
+    for (int i = 0; i < 4; i++) {
+      batch->s[i][l] = lane.s[i];
+    }
+    RngJump(&lane);
+  }
+}
+
+/* one step of every lane, written so the compiler can keep the lanes in
+ * vector registers */
+static void RngBatchStep(RngBatch* batch, uint64_t out[RNG_LANES]) {
+  uint64_t* s0 = batch->s[0];
+  uint64_t* s1 = batch->s[1];
+  uint64_t* s2 = batch->s[2];
+  uint64_t* s3 = batch->s[3];
+  for (int l = 0; l < RNG_LANES; l++) {
+    out[l] = RngRotl(s1[l] * 5, 7) * 9;
+    uint64_t t = s1[l] << 17;
+    s2[l] ^= s0[l];
+    s3[l] ^= s1[l];
+    s1[l] ^= s2[l];
+    s0[l] ^= s3[l];
+    s2[l] ^= t;
+    s3[l] = RngRotl(s3[l], 45);
+  }
+}
+
+void RngBatchFill(RngBatch* batch, uint64_t* out, size_t count) {
+  size_t i = 0;
+  for (; i + RNG_LANES <= count; i += RNG_LANES) {
+    RngBatchStep(batch, out + i);
+  }
+  if (i < count) {
+    uint64_t tail[RNG_LANES];
+    RngBatchStep(batch, tail);
+    memcpy(out + i, tail, sizeof(uint64_t) * (count - i));
+  }
+}
+
+void RngBatchFillDouble(RngBatch* batch, double* out, size_t count) {
+  uint64_t bits[RNG_LANES];
+  for (size_t i = 0; i < count; i += RNG_LANES) {
+    RngBatchStep(batch, bits);
+    size_t n = count - i < RNG_LANES ? count - i : RNG_LANES;
+    for (size_t l = 0; l < n; l++) {
+      out[i + l] = RngToDouble(bits[l]);
+    }
+  }
+}
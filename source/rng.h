@@ -0,0 +1,74 @@
+#ifndef RNG_H_
+#define RNG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* xoshiro256** generator, one independent stream per instance */
+typedef struct {
+  uint64_t s[4];
+} Rng;
+
+/* lanes of the batch generator, interleaved so the fill loop vectorizes */
+#define RNG_LANES 8
+
+typedef struct {
+  uint64_t s[4][RNG_LANES];
+} RngBatch;
+
+/* seed a stream, different (seed, stream) pairs give unrelated sequences */
+void RngSeed(Rng* rng, uint64_t seed);
+void RngSeedStream(Rng* rng, uint64_t seed, uint64_t stream);
+
+/* advance by 2^128 and 2^192 draws, to split one seed into
+ * non-overlapping per-thread streams */
+void RngJump(Rng* rng);
+void RngLongJump(Rng* rng);
+
+static inline uint64_t RngRotl(uint64_t x, int k) {
+  return (x << k) | (x >> (64 - k));
+}
+
+static inline uint64_t RngNext(Rng* rng) {
+  uint64_t* s = rng->s;
+  uint64_t result = RngRotl(s[1] * 5, 7) * 9;
+  uint64_t t = s[1] << 17;
+  s[2] ^= s[0];
+  s[3] ^= s[1];
+  s[1] ^= s[2];
+  s[0] ^= s[3];
+  s[2] ^= t;
+  s[3] = RngRotl(s[3], 45);
+  return result;
+}
+
+/* map 64 random bits to [0, bound) with a multiply-shift, the bias is at
+ * most bound / 2^64 */
+static inline uint64_t RngBounded(uint64_t x, uint64_t bound) {
+  return (uint64_t)(((unsigned __int128)x * bound) >> 64);
+}
+
+/* map 64 random bits to [0, 1) using the top 53 bits */
+static inline double RngToDouble(uint64_t x) {
+  return (double)(x >> 11) * 0x1.0p-53;
+}
+
+/* unbiased uniform integer in [0, bound) */
+uint64_t RngUniform(Rng* rng, uint64_t bound);
+
+/* uniform double in [0, 1) */
+static inline double RngUniformDouble(Rng* rng) {
+  return RngToDouble(RngNext(rng));
+}
+
+/* stateless counter-based draw: the same (seed, counter) always gives the
+ * same bits, for work whose result must not depend on scheduling */
+uint64_t RngCounter(uint64_t seed, uint64_t counter);
+
+void RngBatchSeed(RngBatch* batch, uint64_t seed, uint64_t stream);
+
+/* fill out with count raw draws / doubles in [0, 1) */
+void RngBatchFill(RngBatch* batch, uint64_t* out, size_t count);
+void RngBatchFillDouble(RngBatch* batch, double* out, size_t count);
+
+#endif  // RNG_H_
@@ -0,0 +1,609 @@
+#include "staging.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "graphics.h"
+#include "mem.h"
+#include "renderer.h"
+
+extern VkDevice device;
+extern uint32_t queue_family_index;
+extern VkQueue graphics_queue;
+extern uint32_t transfer_queue_family_index;
+extern VkQueue transfer_queue;
+
+/* submissions whose staged bytes are not free yet, frames in flight plus
+ * batches */
+#define STAGING_MAX_PENDING 32u
+#define STAGING_NO_BATCH UINT32_MAX
+/* resources written by batches that the graphics family has not acquired
+ * yet */
+#define STAGING_MAX_RELEASES 64u
+
+typedef struct {
+  /* the ring head once the submission was made, the tail moves here once
+   * it has finished */
+  VkDeviceSize end;
+  VkFence fence;
+  /* the batch that owns fence, STAGING_NO_BATCH for a frame */
+  uint32_t batch;
+  uint64_t serial;
+  /* a frame known to have finished, batches ask their own fence */
+  bool done;
+} StagingPending;
+
+typedef struct {
+  VkCommandBuffer cmd;
+  VkFence fence;
+  /* counts the submissions, a pending entry with an older serial has
+   * finished since its fence was waited on before the batch was reused */
+  uint64_t serial;
+  bool in_flight;
+} StagingBatch;
+
+static VkBuffer ring_buffer = VK_NULL_HANDLE;
+static MemAllocation ring_memory;
+static uint8_t* ring_mapped = NULL;
+/* bytes from tail to head, alignment padding and the skipped end of the
+ * ring included. Always below STAGING_RING_BYTES so that head == tail
+ * only when the ring is empty */
+static VkDeviceSize ring_head = 0;
+static VkDeviceSize ring_tail = 0;
+static VkDeviceSize ring_used = 0;
+static bool ring_open = false;
+
+static StagingPending pending[STAGING_MAX_PENDING];
+static uint32_t pending_first = 0;
+static uint32_t pending_count = 0;
+
+/* a buffer or image a batch on the transfer family wrote */
+typedef struct {
+  VkBuffer buffer;
+  VkImage image;
+  uint32_t batch;
+  /* the batch's ticket, 0 until it is submitted */
+  uint64_t serial;
+} StagingRelease;
+
+static VkCommandPool batch_pool = VK_NULL_HANDLE;
+static StagingBatch batches[STAGING_MAX_BATCHES];
+static uint64_t batch_serial = 0;
+
+static StagingRelease releases[STAGING_MAX_RELEASES];
+static uint32_t release_count = 0;
+
+/* acquires outside the frame, on the graphics family */
+static VkCommandPool acquire_pool = VK_NULL_HANDLE;
+static VkCommandBuffer acquire_cmd = VK_NULL_HANDLE;
+static VkFence acquire_fence = VK_NULL_HANDLE;
+
+/* batches run on a transfer queue of their own and hand what they wrote
+ * over to the graphics family */
+static bool SeparateTransferFamily(void) {
+  return transfer_queue_family_index != queue_family_index;
+}
+
+int CreateStaging(void) {
+  ring_buffer = CreateBuffer(STAGING_RING_BYTES,
+                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT);
+  if (ring_buffer == VK_NULL_HANDLE ||
+      0 != AllocateBufferMemory(ring_buffer,
+                                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                    VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                                &ring_memory)) {
+    fprintf(stderr, "failed to allocate the staging ring\n");
+    DestroyStaging();
+    return -1;
+  }
+  ring_mapped = (uint8_t*)ring_memory.mapped;
+  ring_head = 0;
+  ring_tail = 0;
+  ring_used = 0;
+  ring_open = false;
+  pending_first = 0;
+  pending_count = 0;
+  release_count = 0;
+
+  VkCommandPoolCreateInfo pool_info = {};
+  pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+  pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
+                    VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+  pool_info.queueFamilyIndex = transfer_queue_family_index;
+  if (VK_SUCCESS !=
+      vkCreateCommandPool(device, &pool_info, VK_NULL_HANDLE, &batch_pool)) {
+    DestroyStaging();
+    return -1;
+  }
+
+  VkCommandBuffer cmds[STAGING_MAX_BATCHES];
+  VkCommandBufferAllocateInfo allocate_info = {};
+  allocate_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+  allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocate_info.commandPool = batch_pool;
+  allocate_info.commandBufferCount = STAGING_MAX_BATCHES;
+  if (VK_SUCCESS != vkAllocateCommandBuffers(device, &allocate_info, cmds)) {
+    DestroyStaging();
+    return -1;
+  }
+  VkFenceCreateInfo fence_info = {};
+  fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+  for (uint32_t i = 0; i < STAGING_MAX_BATCHES; i++) {
+    batches[i].cmd = cmds[i];
+    batches[i].in_flight = false;
+    if (VK_SUCCESS != vkCreateFence(device, &fence_info, VK_NULL_HANDLE,
+                                    &batches[i].fence)) {
+      DestroyStaging();
+      return -1;
+    }
+  }
+
+  if (!SeparateTransferFamily()) {
+    return 0;
+  }
+  pool_info.queueFamilyIndex = queue_family_index;
+  if (VK_SUCCESS != vkCreateCommandPool(device, &pool_info, VK_NULL_HANDLE,
+                                        &acquire_pool)) {
+    DestroyStaging();
+    return -1;
+  }
+  allocate_info.commandPool = acquire_pool;
+  allocate_info.commandBufferCount = 1;
+  if (VK_SUCCESS !=
+          vkAllocateCommandBuffers(device, &allocate_info, &acquire_cmd) ||
+      VK_SUCCESS !=
+          vkCreateFence(device, &fence_info, VK_NULL_HANDLE, &acquire_fence)) {
+    DestroyStaging();
+    return -1;
+  }
+  return 0;
+}
+
+void DestroyStaging(void) {
+  for (uint32_t i = 0; i < STAGING_MAX_BATCHES; i++) {
+    if (batches[i].fence == VK_NULL_HANDLE) {
+      continue;
+    }
+    if (batches[i].in_flight) {
+      vkWaitForFences(device, 1, &batches[i].fence, VK_TRUE, UINT64_MAX);
+    }
+    vkDestroyFence(device, batches[i].fence, VK_NULL_HANDLE);
+  }
+  memset(batches, 0, sizeof(batches));
+  /* frees the command buffers as well */
+  if (batch_pool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device, batch_pool, VK_NULL_HANDLE);
+    batch_pool = VK_NULL_HANDLE;
+  }
+  if (acquire_fence != VK_NULL_HANDLE) {
+    vkDestroyFence(device, acquire_fence, VK_NULL_HANDLE);
+    acquire_fence = VK_NULL_HANDLE;
+  }
+  if (acquire_pool != VK_NULL_HANDLE) {
+    vkDestroyCommandPool(device, acquire_pool, VK_NULL_HANDLE);
+    acquire_pool = VK_NULL_HANDLE;
+    acquire_cmd = VK_NULL_HANDLE;
+  }
+  release_count = 0;
+  if (ring_buffer != VK_NULL_HANDLE) {
+    vkDestroyBuffer(device, ring_buffer, VK_NULL_HANDLE);
+    ring_buffer = VK_NULL_HANDLE;
+  }
+  FreeMemory(&ring_memory);
+  ring_mapped = NULL;
+  pending_count = 0;
+}
+
+VkBuffer StagingBuffer(void) { return ring_buffer; }
+
+/* free the bytes of the oldest pending submission */
+static void PopPending(void) {
+  StagingPending* oldest = &pending[pending_first];
+  ring_used -= (oldest->end + STAGING_RING_BYTES - ring_tail) %
+               STAGING_RING_BYTES;
+  ring_tail = oldest->end;
+  if (oldest->batch != STAGING_NO_BATCH &&
+      batches[oldest->batch].serial == oldest->serial) {
+    batches[oldest->batch].in_flight = false;
+  }
+  pending_first = (pending_first + 1) % STAGING_MAX_PENDING;
+  pending_count--;
+}
+
+/* submissions at the front that have finished, never waits. The ring is
+ * freed in submission order, so a batch still running on the transfer
+ * queue holds back the frames behind it */
+static void ReclaimPending(void) {
+  while (pending_count > 0) {
+    StagingPending* oldest = &pending[pending_first];
+    if (oldest->batch == STAGING_NO_BATCH) {
+      if (!oldest->done) {
+        break;
+      }
+    } else if (batches[oldest->batch].serial == oldest->serial &&
+               VK_SUCCESS != vkGetFenceStatus(device, oldest->fence)) {
+      break;
+    }
+    PopPending();
+  }
+}
+
+static void PushPending(VkFence fence, uint32_t batch, uint64_t serial) {
+  if (pending_count == STAGING_MAX_PENDING) {
+    /* more submissions in flight than frames and batches combined */
+    fprintf(stderr, "staging: too many pending submissions, waiting\n");
+    vkDeviceWaitIdle(device);
+    while (pending_count > 0) {
+      PopPending();
+    }
+  }
+  StagingPending* entry =
+      &pending[(pending_first + pending_count) % STAGING_MAX_PENDING];
+  entry->end = ring_head;
+  entry->fence = fence;
+  entry->batch = batch;
+  entry->serial = serial;
+  entry->done = false;
+  pending_count++;
+  ring_open = false;
+}
+
+void* StagingReserve(VkDeviceSize size, VkDeviceSize alignment,
+                     VkDeviceSize* offset) {
+  if (ring_mapped == NULL || size == 0 || size >= STAGING_RING_BYTES) {
+    return NULL;
+  }
+  ReclaimPending();
+
+  VkDeviceSize start = (ring_head + alignment - 1) / alignment * alignment;
+  if (start + size > STAGING_RING_BYTES) {
+    start = 0;
+  }
+  /* padding, or the skipped end of the ring, and the bytes themselves */
+  VkDeviceSize added =
+      (start + STAGING_RING_BYTES - ring_head) % STAGING_RING_BYTES + size;
+  if (ring_used + added >= STAGING_RING_BYTES) {
+    return NULL;
+  }
+  ring_used += added;
+  ring_head = (start + size) % STAGING_RING_BYTES;
+  ring_open = true;
+  *offset = start;
+  return ring_mapped + start;
+}
+
+/* the batch recording into cmd, STAGING_MAX_BATCHES for a frame */
+static uint32_t FindBatch(VkCommandBuffer cmd) {
+  uint32_t batch = 0;
+  while (batch < STAGING_MAX_BATCHES && batches[batch].cmd != cmd) {
+    batch++;
+  }
+  return batch;
+}
+
+/* note that the batch recording into cmd writes the buffer or image, it is
+ * released when the batch is submitted. -1 when there is no room for it */
+static int AddRelease(VkCommandBuffer cmd, VkBuffer buffer, VkImage image) {
+  uint32_t batch = FindBatch(cmd);
+  if (!SeparateTransferFamily() || batch == STAGING_MAX_BATCHES) {
+    return 0;
+  }
+  for (uint32_t i = 0; i < release_count; i++) {
+    if (releases[i].serial == 0 && releases[i].batch == batch &&
+        releases[i].buffer == buffer && releases[i].image == image) {
+      return 0;
+    }
+  }
+  if (release_count == STAGING_MAX_RELEASES) {
+    return -1;
+  }
+  StagingRelease* release = &releases[release_count++];
+  release->buffer = buffer;
+  release->image = image;
+  release->batch = batch;
+  release->serial = 0;
+  return 0;
+}
+
+int StagingCopyToBuffer(VkCommandBuffer cmd, VkBuffer dst,
+                        VkDeviceSize dst_offset, const void* data,
+                        VkDeviceSize size) {
+  if (0 != AddRelease(cmd, dst, VK_NULL_HANDLE)) {
+    return -1;
+  }
+  VkDeviceSize offset = 0;
+  void* mapped = StagingReserve(size, 16, &offset);
+  if (mapped == NULL) {
+    return -1;
+  }
+  memcpy(mapped, data, size);
+  VkBufferCopy region = {
+      .srcOffset = offset, .dstOffset = dst_offset, .size = size};
+  vkCmdCopyBuffer(cmd, ring_buffer, dst, 1, &region);
+  return 0;
+}
+
+int StagingCopyToImage(VkCommandBuffer cmd, VkImage image, uint32_t width,
+                       uint32_t height, const void* pixels,
+                       VkDeviceSize size) {
+  if (0 != AddRelease(cmd, VK_NULL_HANDLE, image)) {
+    return -1;
+  }
+  VkDeviceSize offset = 0;
+  void* mapped = StagingReserve(size, 16, &offset);
+  if (mapped == NULL) {
+    return -1;
+  }
+  memcpy(mapped, pixels, size);
+
+  VkImageMemoryBarrier barrier = {};
+  barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+  barrier.srcAccessMask = 0;
+  barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  barrier.image = image;
+  barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  barrier.subresourceRange.levelCount = 1;
+  barrier.subresourceRange.layerCount = 1;
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1,
+                       &barrier);
+
+  VkBufferImageCopy region = {};
+  region.bufferOffset = offset;
+  region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  region.imageSubresource.layerCount = 1;
+  region.imageExtent.width = width;
+  region.imageExtent.height = height;
+  region.imageExtent.depth = 1;
+  vkCmdCopyBufferToImage(cmd, ring_buffer, image,
+                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+  if (SeparateTransferFamily() && FindBatch(cmd) != STAGING_MAX_BATCHES) {
+    /* the release and acquire make the transition */
+    return 0;
+  }
+  barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+  barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+  barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, NULL, 0,
+                       NULL, 1, &barrier);
+  return 0;
+}
+
+/* the batch still running the ticket's submission, NULL once it is done.
+ * A batch is only reused after its previous submission has finished */
+static StagingBatch* TicketBatch(StagingTicket ticket) {
+  for (uint32_t i = 0; i < STAGING_MAX_BATCHES; i++) {
+    if (batches[i].serial == ticket && batches[i].in_flight) {
+      return &batches[i];
+    }
+  }
+  return NULL;
+}
+
+/* the release on the transfer family, or the matching acquire on the
+ * graphics family */
+static void RecordOwnership(VkCommandBuffer cmd, const StagingRelease* release,
+                            bool acquire) {
+  if (release->image == VK_NULL_HANDLE) {
+    if (acquire) {
+      VulkanAcquireBuffer(cmd, release->buffer, transfer_queue_family_index,
+                          queue_family_index,
+                          VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                          VK_ACCESS_MEMORY_READ_BIT);
+    } else {
+      VulkanReleaseBuffer(cmd, release->buffer, transfer_queue_family_index,
+                          queue_family_index, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                          VK_ACCESS_TRANSFER_WRITE_BIT);
+    }
+    return;
+  }
+  /* both halves make the transition StagingCopyToImage leaves out */
+  VkImageLayout old_layout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+  VkImageLayout new_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+  if (acquire) {
+    VulkanAcquireImage(cmd, release->image, old_layout, new_layout,
+                       transfer_queue_family_index, queue_family_index,
+                       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                       VK_ACCESS_SHADER_READ_BIT);
+  } else {
+    VulkanReleaseImage(cmd, release->image, old_layout, new_layout,
+                       transfer_queue_family_index, queue_family_index,
+                       VK_PIPELINE_STAGE_TRANSFER_BIT,
+                       VK_ACCESS_TRANSFER_WRITE_BIT);
+  }
+}
+
+/* acquire what the batches that have finished released, never waits */
+static void RecordAcquires(VkCommandBuffer cmd) {
+  for (uint32_t i = 0; i < release_count;) {
+    StagingBatch* batch = TicketBatch(releases[i].serial);
+    if (releases[i].serial == 0 ||
+        (batch != NULL &&
+         VK_SUCCESS != vkGetFenceStatus(device, batch->fence))) {
+      i++;
+      continue;
+    }
+    RecordOwnership(cmd, &releases[i], true);
+    releases[i] = releases[--release_count];
+  }
+}
+
+static bool HasReleases(StagingTicket ticket) {
+  for (uint32_t i = 0; i < release_count && ticket != 0; i++) {
+    if (releases[i].serial == ticket) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void StagingBeginFrame(VkCommandBuffer cmd, VkFence fence) {
+  /* the frame fences are reset once waited on, so the last frame
+   * submitted with this fence is known to be done without asking for its
+   * status, and so are the frames before it on the graphics queue. The
+   * fence says nothing about batches on the transfer queue, they are
+   * retired by their own fence */
+  uint32_t done = 0;
+  for (uint32_t i = 0; i < pending_count; i++) {
+    const StagingPending* entry =
+        &pending[(pending_first + i) % STAGING_MAX_PENDING];
+    if (entry->batch == STAGING_NO_BATCH && entry->fence == fence) {
+      done = i + 1;
+    }
+  }
+  for (uint32_t i = 0; i < done; i++) {
+    StagingPending* entry =
+        &pending[(pending_first + i) % STAGING_MAX_PENDING];
+    if (entry->batch == STAGING_NO_BATCH) {
+      entry->done = true;
+    }
+  }
+  ReclaimPending();
+  RecordAcquires(cmd);
+}
+
+void StagingEndFrame(VkFence fence) {
+  if (ring_open) {
+    PushPending(fence, STAGING_NO_BATCH, 0);
+  }
+}
+
+VkCommandBuffer StagingBeginBatch(void) {
+  if (batch_pool == VK_NULL_HANDLE) {
+    return VK_NULL_HANDLE;
+  }
+  ReclaimPending();
+  uint32_t batch = 0;
+  while (batch < STAGING_MAX_BATCHES && batches[batch].in_flight) {
+    batch++;
+  }
+  if (batch == STAGING_MAX_BATCHES) {
+    /* every batch is in flight, wait for the one submitted first. Its
+     * bytes stay pending until the entries in front of them are freed */
+    batch = 0;
+    for (uint32_t i = 1; i < STAGING_MAX_BATCHES; i++) {
+      if (batches[i].serial < batches[batch].serial) {
+        batch = i;
+      }
+    }
+    vkWaitForFences(device, 1, &batches[batch].fence, VK_TRUE, UINT64_MAX);
+    batches[batch].in_flight = false;
+  }
+  /* releases recorded by a batch that was never submitted */
+  for (uint32_t i = 0; i < release_count;) {
+    if (releases[i].batch == batch && releases[i].serial == 0) {
+      releases[i] = releases[--release_count];
+    } else {
+      i++;
+    }
+  }
+
+  VkCommandBuffer cmd = batches[batch].cmd;
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (VK_SUCCESS != vkResetCommandBuffer(cmd, 0) ||
+      VK_SUCCESS != vkBeginCommandBuffer(cmd, &begin_info)) {
+    return VK_NULL_HANDLE;
+  }
+  return cmd;
+}
+
+StagingTicket StagingSubmitBatch(VkCommandBuffer cmd) {
+  uint32_t batch = FindBatch(cmd);
+  if (batch == STAGING_MAX_BATCHES) {
+    return 0;
+  }
+
+  if (SeparateTransferFamily()) {
+    for (uint32_t i = 0; i < release_count; i++) {
+      if (releases[i].batch == batch && releases[i].serial == 0) {
+        RecordOwnership(cmd, &releases[i], false);
+      }
+    }
+  } else {
+    /* later submissions read what the batch wrote without further sync */
+    VkMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier,
+                         0, NULL, 0, NULL);
+  }
+  if (VK_SUCCESS != vkEndCommandBuffer(cmd)) {
+    return 0;
+  }
+
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &cmd;
+  vkResetFences(device, 1, &batches[batch].fence);
+  if (VK_SUCCESS != vkQueueSubmit(transfer_queue, 1, &submit_info,
+                                  batches[batch].fence)) {
+    return 0;
+  }
+  batches[batch].in_flight = true;
+  batches[batch].serial = ++batch_serial;
+  for (uint32_t i = 0; i < release_count; i++) {
+    if (releases[i].batch == batch && releases[i].serial == 0) {
+      releases[i].serial = batch_serial;
+    }
+  }
+  PushPending(batches[batch].fence, batch, batch_serial);
+  return batch_serial;
+}
+
+bool StagingTicketDone(StagingTicket ticket) {
+  StagingBatch* batch = TicketBatch(ticket);
+  if (batch != NULL) {
+    if (VK_SUCCESS != vkGetFenceStatus(device, batch->fence)) {
+      return false;
+    }
+    ReclaimPending();
+  }
+  /* until the next frame acquires them */
+  return !HasReleases(ticket);
+}
+
+void StagingTicketWait(StagingTicket ticket) {
+  StagingBatch* batch = TicketBatch(ticket);
+  if (batch != NULL) {
+    vkWaitForFences(device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+    ReclaimPending();
+  }
+  if (!HasReleases(ticket)) {
+    return;
+  }
+  /* acquire now instead of in the next frame */
+  VkCommandBufferBeginInfo begin_info = {};
+  begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+  begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (VK_SUCCESS != vkResetCommandBuffer(acquire_cmd, 0) ||
+      VK_SUCCESS != vkBeginCommandBuffer(acquire_cmd, &begin_info)) {
+    fprintf(stderr, "staging: failed to record the acquires\n");
+    return;
+  }
+  RecordAcquires(acquire_cmd);
+  VkSubmitInfo submit_info = {};
+  submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+  submit_info.commandBufferCount = 1;
+  submit_info.pCommandBuffers = &acquire_cmd;
+  vkResetFences(device, 1, &acquire_fence);
+  if (VK_SUCCESS != vkEndCommandBuffer(acquire_cmd) ||
+      VK_SUCCESS !=
+          vkQueueSubmit(graphics_queue, 1, &submit_info, acquire_fence) ||
+      VK_SUCCESS !=
+          vkWaitForFences(device, 1, &acquire_fence, VK_TRUE, UINT64_MAX)) {
+    fprintf(stderr, "staging: failed to submit the acquires\n");
+  }
+}
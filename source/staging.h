@@ -0,0 +1,80 @@
+#ifndef STAGING_H_
+#define STAGING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <vulkan/vulkan.h>
+
+/* one persistently mapped ring shared by every upload, it holds the
+ * GRAPH_RENDERER_UPLOAD_BYTES of every frame in flight with room to spare
+ * for uploads outside the frame */
+#define STAGING_RING_BYTES (64u << 20)
+/* uploads outside the frame that can be in flight at once */
+#define STAGING_MAX_BATCHES 8u
+
+/* a submitted batch, 0 when the submission failed */
+typedef uint64_t StagingTicket;
+
+/* create the ring and the command buffers of the batches, call after the
+ * device exists */
+int CreateStaging(void);
+
+/* waits for the batches still in flight */
+void DestroyStaging(void);
+
+/* the buffer StagingReserve() offsets point into */
+VkBuffer StagingBuffer(void);
+
+/* size bytes of the ring at a multiple of alignment, or NULL while the
+ * copies in flight still use too much of it. Never waits and never
+ * allocates, the caller retries next frame */
+void* StagingReserve(VkDeviceSize size, VkDeviceSize alignment,
+                     VkDeviceSize* offset);
+
+/* stage size bytes of data and record their copy to dst, -1 when the ring
+ * is full */
+int StagingCopyToBuffer(VkCommandBuffer cmd, VkBuffer dst,
+                        VkDeviceSize dst_offset, const void* data,
+                        VkDeviceSize size);
+
+/* stage tightly packed pixels for mip level 0 of a 2D color image and
+ * record the copy between the layout transitions from UNDEFINED to
+ * SHADER_READ_ONLY_OPTIMAL, -1 when the ring is full */
+int StagingCopyToImage(VkCommandBuffer cmd, VkImage image, uint32_t width,
+                       uint32_t height, const void* pixels,
+                       VkDeviceSize size);
+
+/* the frame about to be recorded into cmd waited on fence, whatever the
+ * frame that last submitted with it staged is free again. Records the
+ * acquires of what finished batches released to the graphics family */
+void StagingBeginFrame(VkCommandBuffer cmd, VkFence fence);
+
+/* everything reserved since the last submission is read by the frame
+ * submission that signals fence */
+void StagingEndFrame(VkFence fence);
+
+/* a command buffer for uploads outside the frame loop, any number of
+ * copies and transitions can be recorded into it. NULL on failure. Not
+ * while a frame is being recorded, its reservations would be taken for
+ * the batch's. Waits only when STAGING_MAX_BATCHES batches are still in
+ * flight */
+VkCommandBuffer StagingBeginBatch(void);
+
+/* submit the batch with its own fence without waiting for it. Batches run
+ * on the transfer queue, which is the graphics queue unless the device has
+ * a transfer-only family. On the same queue the writes are visible to
+ * every later submission. Otherwise the buffers and images a batch wrote
+ * are released to the graphics family and must not be used there before
+ * the ticket is done. They must not be in use on the graphics queue while
+ * the batch writes them */
+StagingTicket StagingSubmitBatch(VkCommandBuffer cmd);
+
+/* whether the batch has finished and what it wrote has been acquired by
+ * the graphics family, which the first frame after the batch does. Never
+ * waits */
+bool StagingTicketDone(StagingTicket ticket);
+
+/* block until the batch has finished and what it wrote is acquired */
+void StagingTicketWait(StagingTicket ticket);
+
+#endif  // STAGING_H_
@@ -4,56 +4,6 @@
 
 #include "texture_renderer.h"
 
-void init(){
-
-    for(int i = 0; i < M0; i++){
-        for(int j = i + 1; j < M0; j++){
-            graph[i].edge_list[j] = 1;
-            graph[j].edge_list[i] = 1;
-            vertex_pool[i]++;
-            vertex_pool[j]++;
-            total_degree += 2;
-        }
-    }
-}
-
-void add_node(int i, int j){
-    graph[i].edge_list[j] = 1;
-    graph[j].edge_list[i] = 1;
-    vertex_pool[i]++;
-    vertex_pool[j]++;
-    total_degree += 2;
-}
-
-void generate(){
-    for(int i = M0; i < N; i++){
-        int edges_added = 0;
-        while (edges_added < M){
-            double p = (double)rand() / RAND_MAX;
-            double cumulative = 0.0;
-            for(int j = 0; j < i; j++){
-                cumulative += (double)vertex_pool[j] / total_degree;
-                if(p < cumulative){
-                    if(graph[j].edge_list[i] == 0){
-                        add_node(j, i);
-                        edges_added++;
-                        break;
-                    }
-                }
-            }
-        }
-    }
-}
-
-void print_graph(){
-    for(int i = 0; i < N; i++){
-        for(int j = 0; j < N; j++){
-            printf("%d ", graph[i].edge_list[j]);
-        }
-        printf("\n");
-    }
-}
-
 void textureRendererInit(TextureRenderer* renderer, VkDevice device, VkPhysicalDevice physicalDevice,
                         VkCommandPool commandPool, VkQueue graphicsQueue) {
     memset(renderer, 0, sizeof(TextureRenderer));
@@ -64,22 +14,24 @@ void textureRendererInit(TextureRenderer* renderer, VkDevice device, VkPhysicalD
 }
 
 int textureRendererCreateTexture(TextureRenderer* renderer, const uint8_t* pixels, uint32_t width, uint32_t height) {
+    VkCommandBuffer commandBuffer = StagingBeginBatch();
+    if (commandBuffer == VK_NULL_HANDLE || !textureRendererRecordTexture(renderer, commandBuffer, pixels, width, height)) {
+        return 0;
+    }
+    renderer->uploadTicket = StagingSubmitBatch(commandBuffer);
+    if (renderer->uploadTicket == 0) {
+        fprintf(stderr, "Failed to submit the texture upload\n");
+        return 0;
+    }
+    return 1;
+}
+
+int textureRendererRecordTexture(TextureRenderer* renderer, VkCommandBuffer commandBuffer, const uint8_t* pixels,
+                                 uint32_t width, uint32_t height) {
     renderer->textureWidth = width;
     renderer->textureHeight = height;
     VkDeviceSize imageSize = width * height * 4;
 
-    // Create staging buffer
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-    createBuffer(renderer, imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &stagingBuffer, &stagingMemory);
-
-    void* data;
-    vkMapMemory(renderer->device, stagingMemory, 0, imageSize, 0, &data);
-    memcpy(data, pixels, imageSize);
-    vkUnmapMemory(renderer->device, stagingMemory);
-
     // Create texture image
     VkImageCreateInfo imageInfo = {0};
     imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -101,31 +53,17 @@ int textureRendererCreateTexture(TextureRenderer* renderer, const uint8_t* pixel
         return 0;
     }
 
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements(renderer->device, renderer->textureImage, &memReqs);
-
-    VkMemoryAllocateInfo allocInfo = {0};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memReqs.size;
-    allocInfo.memoryTypeIndex = findMemoryType(renderer->physicalDevice, memReqs.memoryTypeBits,
-                                               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-    if (vkAllocateMemory(renderer->device, &allocInfo, NULL, &renderer->textureMemory) != VK_SUCCESS) {
+    if (AllocateImagesMemory(&renderer->textureImage, 1, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                             &renderer->textureMemory) != 0) {
         fprintf(stderr, "Failed to allocate texture memory\n");
         return 0;
     }
 
-    vkBindImageMemory(renderer->device, renderer->textureImage, renderer->textureMemory, 0);
-
-    // Transition and copy
-    transitionImageLayout(renderer, renderer->textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-                         VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-    copyBufferToImage(renderer, stagingBuffer, renderer->textureImage, width, height);
-    transitionImageLayout(renderer, renderer->textureImage, VK_FORMAT_R8G8B8A8_UNORM,
-                         VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-    vkDestroyBuffer(renderer->device, stagingBuffer, NULL);
-    vkFreeMemory(renderer->device, stagingMemory, NULL);
+    // Transitions and copy, staged in the ring
+    if (StagingCopyToImage(commandBuffer, renderer->textureImage, width, height, pixels, imageSize) != 0) {
+        fprintf(stderr, "Failed to stage %llu bytes of texture\n", (unsigned long long)imageSize);
+        return 0;
+    }
 
     // Create image view
     VkImageViewCreateInfo viewInfo = {0};
@@ -234,42 +172,24 @@ int textureRendererCreateVertexBuffer(TextureRenderer* renderer) {
     VkDeviceSize vertexBufferSize = sizeof(vertices);
     VkDeviceSize indexBufferSize = sizeof(indices);
 
-    // Create vertex buffer
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-    createBuffer(renderer, vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &stagingBuffer, &stagingMemory);
-
-    void* data;
-    vkMapMemory(renderer->device, stagingMemory, 0, vertexBufferSize, 0, &data);
-    memcpy(data, vertices, vertexBufferSize);
-    vkUnmapMemory(renderer->device, stagingMemory);
-
     createBuffer(renderer, vertexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &renderer->vertexBuffer, &renderer->vertexBufferMemory);
-
-    copyBuffer(renderer, stagingBuffer, renderer->vertexBuffer, vertexBufferSize);
-
-    vkDestroyBuffer(renderer->device, stagingBuffer, NULL);
-    vkFreeMemory(renderer->device, stagingMemory, NULL);
-
-    // Create index buffer
-    createBuffer(renderer, indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                &stagingBuffer, &stagingMemory);
-
-    vkMapMemory(renderer->device, stagingMemory, 0, indexBufferSize, 0, &data);
-    memcpy(data, indices, indexBufferSize);
-    vkUnmapMemory(renderer->device, stagingMemory);
-
     createBuffer(renderer, indexBufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &renderer->indexBuffer, &renderer->indexBufferMemory);
 
-    copyBuffer(renderer, stagingBuffer, renderer->indexBuffer, indexBufferSize);
-
-    vkDestroyBuffer(renderer->device, stagingBuffer, NULL);
-    vkFreeMemory(renderer->device, stagingMemory, NULL);
+    // Both copies go through the staging ring in one batch
+    VkCommandBuffer commandBuffer = StagingBeginBatch();
+    if (commandBuffer == VK_NULL_HANDLE ||
+        StagingCopyToBuffer(commandBuffer, renderer->vertexBuffer, 0, vertices, vertexBufferSize) != 0 ||
+        StagingCopyToBuffer(commandBuffer, renderer->indexBuffer, 0, indices, indexBufferSize) != 0) {
+        fprintf(stderr, "Failed to upload the quad\n");
+        return 0;
+    }
+    renderer->uploadTicket = StagingSubmitBatch(commandBuffer);
+    if (renderer->uploadTicket == 0) {
+        fprintf(stderr, "Failed to submit the quad upload\n");
+        return 0;
+    }
 
     return 1;
 }
@@ -289,6 +209,11 @@ void textureRendererRender(TextureRenderer* renderer, VkCommandBuffer commandBuf
     vkCmdDrawIndexed(commandBuffer, renderer->indexCount, 1, 0, 0, 0);
 }
 
+// Whether the uploads submitted so far have finished, batches on the queue finish in order
+int textureRendererUploadsDone(TextureRenderer* renderer) {
+    return StagingTicketDone(renderer->uploadTicket);
+}
+
 // Get descriptor set layout
 VkDescriptorSetLayout textureRendererGetDescriptorSetLayout(TextureRenderer* renderer) {
     return renderer->descriptorSetLayout;
@@ -302,70 +227,21 @@ void textureRendererDestroy(TextureRenderer* renderer) {
         vkDestroyImageView(renderer->device, renderer->textureImageView, NULL);
     if (renderer->textureImage)
         vkDestroyImage(renderer->device, renderer->textureImage, NULL);
-    if (renderer->textureMemory)
-        vkFreeMemory(renderer->device, renderer->textureMemory, NULL);
+    FreeMemory(&renderer->textureMemory);
     if (renderer->vertexBuffer)
         vkDestroyBuffer(renderer->device, renderer->vertexBuffer, NULL);
-    if (renderer->vertexBufferMemory)
-        vkFreeMemory(renderer->device, renderer->vertexBufferMemory, NULL);
+    FreeMemory(&renderer->vertexBufferMemory);
     if (renderer->indexBuffer)
         vkDestroyBuffer(renderer->device, renderer->indexBuffer, NULL);
-    if (renderer->indexBufferMemory)
-        vkFreeMemory(renderer->device, renderer->indexBufferMemory, NULL);
+    FreeMemory(&renderer->indexBufferMemory);
     if (renderer->descriptorSetLayout)
         vkDestroyDescriptorSetLayout(renderer->device, renderer->descriptorSetLayout, NULL);
 }
 
 // Helper functions
 
-static uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProps;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProps);
-
-    for (uint32_t i = 0; i < memProps.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProps.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
-    }
-
-    fprintf(stderr, "Failed to find suitable memory type\n");
-    return 0;
-}
-
-static VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool) {
-    VkCommandBufferAllocateInfo allocInfo = {0};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo = {0};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    return commandBuffer;
-}
-
-static void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue, VkCommandBuffer commandBuffer) {
-    vkEndCommandBuffer(commandBuffer);
-
-    VkSubmitInfo submitInfo = {0};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
-
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
 static void createBuffer(TextureRenderer* renderer, VkDeviceSize size, VkBufferUsageFlags usage,
-                        VkMemoryPropertyFlags properties, VkBuffer* buffer, VkDeviceMemory* memory) {
+                        VkMemoryPropertyFlags properties, VkBuffer* buffer, MemAllocation* memory) {
     VkBufferCreateInfo bufferInfo = {0};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
@@ -377,92 +253,10 @@ static void createBuffer(TextureRenderer* renderer, VkDeviceSize size, VkBufferU
         return;
     }
 
-    VkMemoryRequirements memReqs;
-    vkGetBufferMemoryRequirements(renderer->device, *buffer, &memReqs);
-
-    VkMemoryAllocateInfo allocInfo = {0};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memReqs.size;
-    allocInfo.memoryTypeIndex = findMemoryType(renderer->physicalDevice, memReqs.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(renderer->device, &allocInfo, NULL, memory) != VK_SUCCESS) {
+    if (AllocateBufferMemory(*buffer, properties, memory) != 0) {
         fprintf(stderr, "Failed to allocate buffer memory\n");
         return;
     }
-
-    vkBindBufferMemory(renderer->device, *buffer, *memory, 0);
-}
-
-static void copyBuffer(TextureRenderer* renderer, VkBuffer src, VkBuffer dst, VkDeviceSize size) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(renderer->device, renderer->commandPool);
-
-    VkBufferCopy copyRegion = {0};
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, src, dst, 1, &copyRegion);
-
-    endSingleTimeCommands(renderer->device, renderer->commandPool, renderer->graphicsQueue, commandBuffer);
-}
-
-static void copyBufferToImage(TextureRenderer* renderer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(renderer->device, renderer->commandPool);
-
-    VkBufferImageCopy region = {0};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset.x = 0;
-    region.imageOffset.y = 0;
-    region.imageOffset.z = 0;
-    region.imageExtent.width = width;
-    region.imageExtent.height = height;
-    region.imageExtent.depth = 1;
-
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-    endSingleTimeCommands(renderer->device, renderer->commandPool, renderer->graphicsQueue, commandBuffer);
-}
-
-static void transitionImageLayout(TextureRenderer* renderer, VkImage image, VkFormat format,
-                                 VkImageLayout oldLayout, VkImageLayout newLayout) {
-    VkCommandBuffer commandBuffer = beginSingleTimeCommands(renderer->device, renderer->commandPool);
-
-    VkImageMemoryBarrier barrier = {0};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-
-    VkPipelineStageFlags srcStage, dstStage;
-
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    } else {
-        fprintf(stderr, "Unsupported layout transition\n");
-        return;
-    }
-
-    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, NULL, 0, NULL, 1, &barrier);
-
-    endSingleTimeCommands(renderer->device, renderer->commandPool, renderer->graphicsQueue, commandBuffer);
 }
 
 // Vertex input binding description
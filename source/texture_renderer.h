@@ -11,18 +11,19 @@
 #include <string.h>
 #include <vulkan/vulkan_core.h>
 
-#define N 15
-#define M0 4
-#define M 4
-
-static int vertex_pool[N] = {0};
+#include "mem.h"
+#include "staging.h"
 
+/* graph topology lives in graph.h, Vertex only carries what the GPU reads */
 typedef struct {
-    int edge_list[N];
-    float tex_coord[2];
     float pos[2];
+    float tex_coord[2];
 } Vertex;
 
+/* the binding stride, per-node data that is not fetched by the vertex
+ * shader belongs in the host-side graph arrays instead */
+_Static_assert(sizeof(Vertex) == 16, "Vertex is a 16-byte GPU stream");
+
 typedef struct {
     VkDevice device;
     VkPhysicalDevice physicalDevice;
@@ -30,14 +31,14 @@ typedef struct {
     VkQueue graphicsQueue;
 
     VkImage textureImage;
-    VkDeviceMemory textureMemory;
+    MemAllocation textureMemory;
     VkImageView textureImageView;
     VkSampler textureSampler;
 
     VkBuffer vertexBuffer;
-    VkDeviceMemory vertexBufferMemory;
+    MemAllocation vertexBufferMemory;
     VkBuffer indexBuffer;
-    VkDeviceMemory indexBufferMemory;
+    MemAllocation indexBufferMemory;
 
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorSet descriptorSet;
@@ -45,23 +46,20 @@ typedef struct {
     uint32_t textureWidth;
     uint32_t textureHeight;
     uint32_t indexCount;
-} TextureRenderer;
 
-static Vertex graph[N];
-static int total_degree = 0;
+    // the last upload batch submitted
+    StagingTicket uploadTicket;
+} TextureRenderer;
 
-static uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
-static VkCommandBuffer beginSingleTimeCommands(VkDevice device, VkCommandPool commandPool);
-static void endSingleTimeCommands(VkDevice device, VkCommandPool commandPool, VkQueue graphicsQueue, VkCommandBuffer commandBuffer);
 static void createBuffer(TextureRenderer* renderer, VkDeviceSize size, VkBufferUsageFlags usage,
-                        VkMemoryPropertyFlags properties, VkBuffer* buffer, VkDeviceMemory* memory);
-static void copyBuffer(TextureRenderer* renderer, VkBuffer src, VkBuffer dst, VkDeviceSize size);
-static void copyBufferToImage(TextureRenderer* renderer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-static void transitionImageLayout(TextureRenderer* renderer, VkImage image, VkFormat format,
-                                 VkImageLayout oldLayout, VkImageLayout newLayout);
+                        VkMemoryPropertyFlags properties, VkBuffer* buffer, MemAllocation* memory);
 void textureRendererInit(TextureRenderer* renderer, VkDevice device, VkPhysicalDevice physicalDevice,
                         VkCommandPool commandPool, VkQueue graphicsQueue);
 int textureRendererCreateTexture(TextureRenderer* renderer, const uint8_t* pixels, uint32_t width, uint32_t height);
+// record the upload into a batch from StagingBeginBatch(), so many textures share one submission
+int textureRendererRecordTexture(TextureRenderer* renderer, VkCommandBuffer commandBuffer, const uint8_t* pixels,
+                                 uint32_t width, uint32_t height);
+int textureRendererUploadsDone(TextureRenderer* renderer);
 int textureRendererCreateDescriptorSetLayout(TextureRenderer* renderer);
 int textureRendererCreateDescriptorSet(TextureRenderer* renderer, VkDescriptorPool descriptorPool);
 int textureRendererCreateVertexBuffer(TextureRenderer* renderer);
@@ -69,14 +67,8 @@ void textureRendererRender(TextureRenderer* renderer, VkCommandBuffer commandBuf
                           VkPipeline pipeline, VkPipelineLayout pipelineLayout);
 VkDescriptorSetLayout textureRendererGetDescriptorSetLayout(TextureRenderer* renderer);
 void textureRendererDestroy(TextureRenderer* renderer);
-static uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
 void getVertexAttributeDescriptions(VkVertexInputAttributeDescription* attributeDescriptions);
 
-
-void init();
-void add_Vertex(int i, int j);
-void generate();
-void print_graph();
 void createTexture(const uint8_t* pixels, uint32_t width, uint32_t height);
 
 #endif //CS226FINALPROJECT_TEXTURE_RENDERER_H
\ No newline at end of file
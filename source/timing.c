@@ -0,0 +1,335 @@
+#include "timing.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace.h"
+
+extern VkDevice device;
+extern VkPhysicalDevice physical_device;
+extern uint32_t queue_family_index;
+extern uint32_t swapchain_frame_count;
+extern uint32_t swapchain_current_frame;
+
+static const char* const stage_names[TIMING_STAGE_COUNT] = {
+    "acquire",  "update",         "render",   "submit",
+    "present",  "frame",          "gpu_uploads", "gpu_pre_render",
+    "gpu_draw", "gpu_post_render", "gpu_frame"};
+
+static const char* const startup_names[TIMING_STARTUP_COUNT] = {
+    "device", "window", "swapchain", "renderer",
+    "mode",   "first_frame", "total"};
+
+/* NAN until the phase is recorded */
+static double startup_ms[TIMING_STARTUP_COUNT] = {NAN, NAN, NAN, NAN,
+                                                   NAN, NAN, NAN};
+
+/* the GPU stages span consecutive marks */
+static const TimingMark gpu_stage_marks[][2] = {
+    {TIMING_MARK_BEGIN, TIMING_MARK_PRE_RENDER},
+    {TIMING_MARK_PRE_RENDER, TIMING_MARK_DRAW},
+    {TIMING_MARK_DRAW, TIMING_MARK_POST_RENDER},
+    {TIMING_MARK_POST_RENDER, TIMING_MARK_END},
+    {TIMING_MARK_BEGIN, TIMING_MARK_END}};
+
+/* one frame of the rolling window, NAN where a stage has no sample */
+typedef struct {
+  uint64_t frame;
+  double ms[TIMING_STAGE_COUNT];
+} TimingRow;
+
+static TimingRow* rows = NULL;
+static uint32_t window = 0;
+static uint64_t current_frame = 0;
+static double frame_start = 0.0;
+
+/* TIMING_MARK_COUNT timestamps per frame in flight */
+static VkQueryPool query_pool = VK_NULL_HANDLE;
+static uint32_t query_slot_count = 0;
+static uint64_t* slot_frames = NULL;
+static bool* slot_written = NULL;
+static double tick_ms = 0.0;
+static uint64_t tick_mask = 0;
+
+/* scratch for the percentiles */
+static double* sorted = NULL;
+
+static TimingRow* Row(uint64_t frame) {
+  TimingRow* row = &rows[frame % window];
+  return row->frame == frame ? row : NULL;
+}
+
+static void ResetRow(uint64_t frame) {
+  TimingRow* row = &rows[frame % window];
+  row->frame = frame;
+  for (uint32_t s = 0; s < TIMING_STAGE_COUNT; s++) {
+    row->ms[s] = NAN;
+  }
+}
+
+static void CreateQueryPool(void) {
+  uint32_t family_count = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count,
+                                           NULL);
+  VkQueueFamilyProperties* families = (VkQueueFamilyProperties*)malloc(
+      sizeof(VkQueueFamilyProperties) * family_count);
+  if (families == NULL) {
+    return;
+  }
+  vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count,
+                                           families);
+  uint32_t valid_bits = families[queue_family_index].timestampValidBits;
+  free(families);
+  if (valid_bits == 0) {
+    return;
+  }
+
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physical_device, &properties);
+  tick_ms = (double)properties.limits.timestampPeriod * 1e-6;
+  tick_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+  query_slot_count = swapchain_frame_count;
+  slot_frames = (uint64_t*)calloc(query_slot_count, sizeof(uint64_t));
+  slot_written = (bool*)calloc(query_slot_count, sizeof(bool));
+  if (slot_frames == NULL || slot_written == NULL) {
+    return;
+  }
+  VkQueryPoolCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  create_info.queryCount = TIMING_MARK_COUNT * query_slot_count;
+  if (VK_SUCCESS != vkCreateQueryPool(device, &create_info, VK_NULL_HANDLE,
+                                      &query_pool)) {
+    fprintf(stderr, "failed to create the timestamp query pool\n");
+    query_pool = VK_NULL_HANDLE;
+  }
+}
+
+int TimingCreate(uint32_t window_frames) {
+  window = window_frames > 0 ? window_frames : TIMING_DEFAULT_WINDOW;
+  /* a frame's GPU times arrive frames in flight later */
+  if (window < 2 * swapchain_frame_count) {
+    window = 2 * swapchain_frame_count;
+  }
+  rows = (TimingRow*)malloc(sizeof(TimingRow) * window);
+  sorted = (double*)malloc(sizeof(double) * window);
+  if (rows == NULL || sorted == NULL) {
+    fprintf(stderr, "failed to allocate %u frames of timings\n", window);
+    TimingDestroy();
+    return -1;
+  }
+  /* no frame has number UINT64_MAX, so every row starts out stale */
+  for (uint32_t i = 0; i < window; i++) {
+    rows[i].frame = UINT64_MAX;
+  }
+  current_frame = 0;
+  CreateQueryPool();
+  return 0;
+}
+
+void TimingDestroy(void) {
+  if (query_pool != VK_NULL_HANDLE) {
+    vkDestroyQueryPool(device, query_pool, VK_NULL_HANDLE);
+    query_pool = VK_NULL_HANDLE;
+  }
+  free(slot_frames);
+  slot_frames = NULL;
+  free(slot_written);
+  slot_written = NULL;
+  query_slot_count = 0;
+  free(rows);
+  rows = NULL;
+  free(sorted);
+  sorted = NULL;
+  window = 0;
+}
+
+double TimingNow(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + (double)now.tv_nsec * 1e-9;
+}
+
+void TimingBeginFrame(void) {
+  if (rows == NULL) {
+    return;
+  }
+  current_frame++;
+  ResetRow(current_frame);
+  frame_start = TimingNow();
+}
+
+void TimingEndFrame(void) { TimingRecord(TIMING_FRAME, frame_start); }
+
+void TimingRecord(TimingStage stage, double start) {
+  if (rows == NULL) {
+    return;
+  }
+  double now = TimingNow();
+  rows[current_frame % window].ms[stage] = (now - start) * 1e3;
+  TRACE_COMPLETE(stage_names[stage], (uint64_t)(start * 1e9),
+                 (uint64_t)(now * 1e9));
+}
+
+void TimingRecordStartup(TimingStartupPhase phase, double start) {
+  double now = TimingNow();
+  startup_ms[phase] = (now - start) * 1e3;
+  TRACE_COMPLETE(startup_names[phase], (uint64_t)(start * 1e9),
+                 (uint64_t)(now * 1e9));
+}
+
+void TimingPrintStartup(FILE* file) {
+  fprintf(file, "%-16s %9s\n", "startup (ms)", "time");
+  for (uint32_t p = 0; p < TIMING_STARTUP_COUNT; p++) {
+    if (!isnan(startup_ms[p])) {
+      fprintf(file, "%-16s %9.3f\n", startup_names[p], startup_ms[p]);
+    }
+  }
+}
+
+/* move the slot's timestamps into the row of the frame that wrote them */
+static void ReadSlot(uint32_t slot, VkQueryResultFlags flags) {
+  if (!slot_written[slot]) {
+    return;
+  }
+  slot_written[slot] = false;
+  uint64_t ticks[TIMING_MARK_COUNT];
+  if (VK_SUCCESS != vkGetQueryPoolResults(
+                        device, query_pool, TIMING_MARK_COUNT * slot,
+                        TIMING_MARK_COUNT, sizeof(ticks), ticks,
+                        sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | flags)) {
+    return;
+  }
+  TimingRow* row = Row(slot_frames[slot]);
+  if (row == NULL) {
+    return;
+  }
+  for (uint32_t s = TIMING_GPU_UPLOADS; s < TIMING_STAGE_COUNT; s++) {
+    const TimingMark* marks = gpu_stage_marks[s - TIMING_GPU_UPLOADS];
+    uint64_t elapsed = (ticks[marks[1]] - ticks[marks[0]]) & tick_mask;
+    row->ms[s] = (double)elapsed * tick_ms;
+  }
+}
+
+void TimingMarkGpu(VkCommandBuffer cmd, TimingMark mark) {
+  if (query_pool == VK_NULL_HANDLE) {
+    return;
+  }
+  uint32_t slot = swapchain_current_frame % query_slot_count;
+  uint32_t first_query = TIMING_MARK_COUNT * slot;
+  if (mark == TIMING_MARK_BEGIN) {
+    ReadSlot(slot, 0);
+    vkCmdResetQueryPool(cmd, query_pool, first_query, TIMING_MARK_COUNT);
+    vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool,
+                        first_query);
+    return;
+  }
+  /* after everything recorded before it has finished */
+  vkCmdWriteTimestamp(cmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool,
+                      first_query + mark);
+  if (mark == TIMING_MARK_END) {
+    slot_frames[slot] = current_frame;
+    slot_written[slot] = true;
+  }
+}
+
+void TimingFlush(void) {
+  for (uint32_t slot = 0; slot < query_slot_count; slot++) {
+    ReadSlot(slot, VK_QUERY_RESULT_WAIT_BIT);
+  }
+}
+
+static int CompareDoubles(const void* a, const void* b) {
+  double x = *(const double*)a;
+  double y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/* nearest rank */
+static double Percentile(const double* values, uint32_t count, double p) {
+  uint32_t rank = (uint32_t)ceil(p * count);
+  return values[rank > 0 ? rank - 1 : 0];
+}
+
+bool TimingSummarize(TimingStage stage, TimingSummary* summary) {
+  memset(summary, 0, sizeof(TimingSummary));
+  if (rows == NULL) {
+    return false;
+  }
+  uint32_t count = 0;
+  double sum = 0.0;
+  for (uint32_t i = 0; i < window; i++) {
+    double ms = rows[i].ms[stage];
+    if (rows[i].frame != UINT64_MAX && !isnan(ms)) {
+      sorted[count++] = ms;
+      sum += ms;
+    }
+  }
+  if (count == 0) {
+    return false;
+  }
+  qsort(sorted, count, sizeof(double), CompareDoubles);
+  summary->count = count;
+  summary->mean = sum / count;
+  summary->p50 = Percentile(sorted, count, 0.50);
+  summary->p95 = Percentile(sorted, count, 0.95);
+  summary->p99 = Percentile(sorted, count, 0.99);
+  summary->max = sorted[count - 1];
+  return true;
+}
+
+void TimingPrint(FILE* file) {
+  fprintf(file, "%-16s %6s %9s %9s %9s %9s %9s\n", "stage (ms)", "frames",
+          "mean", "p50", "p95", "p99", "max");
+  for (uint32_t s = 0; s < TIMING_STAGE_COUNT; s++) {
+    TimingSummary summary;
+    if (TimingSummarize((TimingStage)s, &summary)) {
+      fprintf(file, "%-16s %6u %9.3f %9.3f %9.3f %9.3f %9.3f\n",
+              stage_names[s], summary.count, summary.mean, summary.p50,
+              summary.p95, summary.p99, summary.max);
+    }
+  }
+}
+
+int TimingWriteCsv(const char* path) {
+  if (rows == NULL) {
+    return -1;
+  }
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "failed to open %s\n", path);
+    return -1;
+  }
+  fprintf(file, "frame");
+  for (uint32_t s = 0; s < TIMING_STAGE_COUNT; s++) {
+    fprintf(file, ",%s_ms", stage_names[s]);
+  }
+  fprintf(file, "\n");
+
+  /* oldest first */
+  uint64_t first = current_frame >= window ? current_frame - window + 1 : 0;
+  for (uint64_t frame = first; frame <= current_frame; frame++) {
+    const TimingRow* row = Row(frame);
+    if (row == NULL) {
+      continue;
+    }
+    fprintf(file, "%llu", (unsigned long long)frame);
+    for (uint32_t s = 0; s < TIMING_STAGE_COUNT; s++) {
+      if (isnan(row->ms[s])) {
+        fprintf(file, ",");
+      } else {
+        fprintf(file, ",%.6f", row->ms[s]);
+      }
+    }
+    fprintf(file, "\n");
+  }
+
+  if (0 != fclose(file)) {
+    fprintf(stderr, "failed to write %s\n", path);
+    return -1;
+  }
+  return 0;
+}
@@ -0,0 +1,105 @@
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <vulkan/vulkan.h>
+
+/* frames kept when TimingCreate() is given 0 */
+#define TIMING_DEFAULT_WINDOW 512u
+
+typedef enum {
+  /* host timers */
+  TIMING_ACQUIRE = 0, /* waiting for the frame's fence and the next image */
+  TIMING_UPDATE,      /* the mode's CPU work between acquire and render */
+  TIMING_RENDER,      /* Render(), recording and submitting */
+  TIMING_SUBMIT,      /* vkQueueSubmit inside Render() */
+  TIMING_PRESENT,     /* VulkanSCPresent() */
+  TIMING_FRAME,       /* the whole frame on the host */
+  /* GPU timestamps */
+  TIMING_GPU_UPLOADS,     /* copies and compute before PreRender() */
+  TIMING_GPU_PRE_RENDER,  /* PreRender() */
+  TIMING_GPU_DRAW,        /* the rendering pass */
+  TIMING_GPU_POST_RENDER, /* PostRender() */
+  TIMING_GPU_FRAME,       /* the whole command buffer */
+  TIMING_STAGE_COUNT,
+} TimingStage;
+
+/* where the renderer writes its timestamps, in recording order */
+typedef enum {
+  TIMING_MARK_BEGIN = 0,
+  TIMING_MARK_PRE_RENDER,
+  TIMING_MARK_DRAW,
+  TIMING_MARK_POST_RENDER,
+  TIMING_MARK_END,
+  TIMING_MARK_COUNT,
+} TimingMark;
+
+/* startup, each phase measured once. The device and the window are created
+ * at the same time, so the phases can add up to more than the total */
+typedef enum {
+  TIMING_STARTUP_DEVICE = 0,  /* instance, device, pipeline cache, compute */
+  TIMING_STARTUP_WINDOW,      /* SDL and the window */
+  TIMING_STARTUP_SWAPCHAIN,   /* surface and swapchain, or offscreen images */
+  TIMING_STARTUP_RENDERER,    /* frame contexts, staging, recorder, timers */
+  TIMING_STARTUP_MODE,        /* the mode's graph, buffers and pipelines */
+  TIMING_STARTUP_FIRST_FRAME, /* the end of setup to the first present */
+  TIMING_STARTUP_TOTAL,       /* the start of main() to that present */
+  TIMING_STARTUP_COUNT,
+} TimingStartupPhase;
+
+typedef struct {
+  uint32_t count;
+  double mean;
+  double p50;
+  double p95;
+  double p99;
+  double max;
+} TimingSummary;
+
+/* keep the last window_frames frames (0 for TIMING_DEFAULT_WINDOW). Call
+ * once the swapchain or offscreen images exist, without timestamp support
+ * only the host stages are measured */
+int TimingCreate(uint32_t window_frames);
+
+void TimingDestroy(void);
+
+/* seconds on a monotonic clock */
+double TimingNow(void);
+
+/* milliseconds since start, a TimingNow() value, for a startup phase.
+ * Works before TimingCreate() and from any thread, one thread per phase */
+void TimingRecordStartup(TimingStartupPhase phase, double start);
+
+/* one line per startup phase that was recorded */
+void TimingPrintStartup(FILE* file);
+
+/* start a new frame, the stages recorded until the next call belong to
+ * it */
+void TimingBeginFrame(void);
+
+void TimingEndFrame(void);
+
+/* milliseconds since start, a TimingNow() value, for a host stage */
+void TimingRecord(TimingStage stage, double start);
+
+/* the frame in flight's timestamps: TIMING_MARK_BEGIN reads what the slot
+ * measured the last time it was used, so call it after the frame's fence
+ * has been waited on */
+void TimingMarkGpu(VkCommandBuffer cmd, TimingMark mark);
+
+/* wait for the frames still in flight and collect their timestamps */
+void TimingFlush(void);
+
+/* statistics of one stage over the window, false without samples */
+bool TimingSummarize(TimingStage stage, TimingSummary* summary);
+
+/* one line per stage with samples */
+void TimingPrint(FILE* file);
+
+/* every frame of the window, one column per stage, empty where a stage
+ * was not measured */
+int TimingWriteCsv(const char* path);
+
+#endif  // TIMING_H_
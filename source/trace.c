@@ -0,0 +1,159 @@
+#include "trace.h"
+
+#ifdef ENABLE_TRACING
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+  uint64_t ns;
+  const char* name;
+  /* the duration of 'X', the value of 'i' and 'C' */
+  int64_t arg;
+  char phase;
+} TraceEvent;
+
+/* written only by its thread, without locks */
+typedef struct TraceRing {
+  struct TraceRing* next;
+  uint32_t thread_id;
+  uint64_t written;
+  TraceEvent events[TRACE_RING_EVENTS];
+} TraceRing;
+
+static pthread_mutex_t rings_mutex = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing* rings = NULL;
+static uint32_t ring_count = 0;
+static const char* trace_path = NULL;
+static bool tracing = false;
+
+static _Thread_local TraceRing* thread_ring = NULL;
+
+int TraceStart(const char* path) {
+  trace_path = path;
+  __atomic_store_n(&tracing, true, __ATOMIC_RELEASE);
+  return 0;
+}
+
+uint64_t TraceNow(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+/* the calling thread's ring, created the first time it records */
+static TraceRing* ThreadRing(void) {
+  if (thread_ring != NULL) {
+    return thread_ring;
+  }
+  TraceRing* ring = (TraceRing*)malloc(sizeof(TraceRing));
+  if (ring == NULL) {
+    return NULL;
+  }
+  ring->written = 0;
+  pthread_mutex_lock(&rings_mutex);
+  ring->thread_id = ring_count++;
+  ring->next = rings;
+  rings = ring;
+  pthread_mutex_unlock(&rings_mutex);
+  thread_ring = ring;
+  return ring;
+}
+
+void TraceRecord(char phase, const char* name, uint64_t ns, int64_t arg) {
+  if (!__atomic_load_n(&tracing, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  TraceRing* ring = ThreadRing();
+  if (ring == NULL) {
+    return;
+  }
+  TraceEvent* event = &ring->events[ring->written % TRACE_RING_EVENTS];
+  event->ns = ns;
+  event->name = name;
+  event->arg = arg;
+  event->phase = phase;
+  ring->written++;
+}
+
+static void WriteEvent(FILE* file, const TraceEvent* event, uint32_t tid,
+                       bool first) {
+  /* microseconds with nanosecond precision */
+  fprintf(file,
+          "%s\n{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu.%03u,"
+          "\"pid\":%d,\"tid\":%u",
+          first ? "" : ",", event->name, event->phase,
+          (unsigned long long)(event->ns / 1000), (unsigned)(event->ns % 1000),
+          (int)getpid(), tid);
+  switch (event->phase) {
+    case 'X':
+      fprintf(file, ",\"dur\":%lld.%03u",
+              (long long)(event->arg / 1000), (unsigned)(event->arg % 1000));
+      break;
+    case 'i':
+      fprintf(file, ",\"s\":\"t\",\"args\":{\"value\":%lld}",
+              (long long)event->arg);
+      break;
+    case 'C':
+      fprintf(file, ",\"args\":{\"value\":%lld}", (long long)event->arg);
+      break;
+  }
+  fprintf(file, "}");
+}
+
+static int WriteTrace(const char* path) {
+  FILE* file = fopen(path, "w");
+  if (file == NULL) {
+    fprintf(stderr, "failed to open %s\n", path);
+    return -1;
+  }
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  bool first = true;
+  uint64_t dropped = 0;
+  for (TraceRing* ring = rings; ring != NULL; ring = ring->next) {
+    /* oldest first, a full ring starts at the slot written next */
+    uint64_t begin = 0;
+    if (ring->written > TRACE_RING_EVENTS) {
+      begin = ring->written - TRACE_RING_EVENTS;
+      dropped += begin;
+    }
+    for (uint64_t i = begin; i < ring->written; i++) {
+      WriteEvent(file, &ring->events[i % TRACE_RING_EVENTS],
+                 ring->thread_id, first);
+      first = false;
+    }
+  }
+  fprintf(file, "\n]}\n");
+  if (0 != fclose(file)) {
+    fprintf(stderr, "failed to write %s\n", path);
+    return -1;
+  }
+  if (dropped > 0) {
+    fprintf(stderr, "trace dropped the %llu oldest events\n",
+            (unsigned long long)dropped);
+  }
+  return 0;
+}
+
+void TraceStop(void) {
+  if (!__atomic_exchange_n(&tracing, false, __ATOMIC_ACQ_REL)) {
+    return;
+  }
+  pthread_mutex_lock(&rings_mutex);
+  WriteTrace(trace_path);
+  while (rings != NULL) {
+    TraceRing* next = rings->next;
+    free(rings);
+    rings = next;
+  }
+  ring_count = 0;
+  pthread_mutex_unlock(&rings_mutex);
+  /* the calling thread's ring is gone, the others have exited */
+  thread_ring = NULL;
+}
+
+#endif  // ENABLE_TRACING
@@ -0,0 +1,50 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdint.h>
+
+/* events per thread, the oldest are overwritten when a ring is full */
+#define TRACE_RING_EVENTS 65536u
+
+/* Tracing is compiled in with -DENABLE_TRACING, otherwise every TRACE_*
+ * macro expands to nothing and TraceStart() fails. Names must be string
+ * literals or otherwise outlive TraceStop(), only the pointer is kept */
+#ifdef ENABLE_TRACING
+
+/* start recording, the events are written to path as Chrome trace-event
+ * JSON by TraceStop() */
+int TraceStart(const char* path);
+
+/* write the trace and free every ring, the threads that recorded events
+ * must have finished */
+void TraceStop(void);
+
+/* nanoseconds on the clock TimingNow() reads */
+uint64_t TraceNow(void);
+
+/* phase is a Chrome trace-event phase: 'B', 'E', 'X', 'i' or 'C' */
+void TraceRecord(char phase, const char* name, uint64_t ns, int64_t arg);
+
+#define TRACE_BEGIN(name) TraceRecord('B', (name), TraceNow(), 0)
+#define TRACE_END(name) TraceRecord('E', (name), TraceNow(), 0)
+/* a span measured elsewhere, start_ns and end_ns from TraceNow() */
+#define TRACE_COMPLETE(name, start_ns, end_ns) \
+  TraceRecord('X', (name), (start_ns), (int64_t)((end_ns) - (start_ns)))
+#define TRACE_INSTANT(name, value) \
+  TraceRecord('i', (name), TraceNow(), (int64_t)(value))
+#define TRACE_COUNTER(name, value) \
+  TraceRecord('C', (name), TraceNow(), (int64_t)(value))
+
+#else
+
+#define TraceStart(path) ((void)(path), -1)
+#define TraceStop() ((void)0)
+#define TRACE_BEGIN(name) ((void)0)
+#define TRACE_END(name) ((void)0)
+#define TRACE_COMPLETE(name, start_ns, end_ns) ((void)0)
+#define TRACE_INSTANT(name, value) ((void)0)
+#define TRACE_COUNTER(name, value) ((void)0)
+
+#endif  // ENABLE_TRACING
+
+#endif  // TRACE_H_
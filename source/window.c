@@ -6,7 +6,11 @@
 #include <SDL3/SDL_vulkan.h>
 #include <stdio.h>
 
+#include "timing.h"
+
 static SDL_Window* window = NULL;
+/* the drawable size changed since the last WindowResized() */
+static bool window_resized = false;
 
 static void PrintSDLError(const char* message) {
   fprintf(stderr, "%s: %s\n", message, SDL_GetError());
@@ -21,7 +25,8 @@ int CreateWindow(int width, int height, const char* title) {
     return -1;
   }
 
-  window = SDL_CreateWindow(title, width, height, SDL_WINDOW_VULKAN);
+  window = SDL_CreateWindow(title, width, height,
+                            SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
   if (window == NULL) {
     PrintSDLError("CreateWindow: SDL_CreateWindow failed");
     SDL_Quit();
@@ -32,13 +37,23 @@ int CreateWindow(int width, int height, const char* title) {
 }
 
 int PollEvents(void) {
+  /* nothing is drawn while minimized, block instead of spinning */
+  if (SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED) {
+    SDL_WaitEventTimeout(NULL, 100);
+  }
   SDL_Event event;
   while (SDL_PollEvent(&event)) {
     if (event.type == SDL_EVENT_QUIT) {
       return -1;
+    } else if (event.type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED) {
+      window_resized = true;
     } else if (event.type == SDL_EVENT_KEY_UP &&
                event.key.scancode == SDL_SCANCODE_ESCAPE) {
       return -1;
+    } else if (event.type == SDL_EVENT_KEY_UP &&
+               event.key.scancode == SDL_SCANCODE_T) {
+      /* frame times on demand */
+      TimingPrint(stdout);
     }
   }
   return 0;
@@ -55,4 +70,29 @@ int DestroyWindow(void) {
 
 int VulkanInitializeSurface(void) { return 0; }
 
+bool WindowResized(void) {
+  bool resized = window_resized;
+  window_resized = false;
+  return resized;
+}
+
+void GetWindowPixelSize(int* width, int* height) {
+  *width = 0;
+  *height = 0;
+  if (window != NULL &&
+      !(SDL_GetWindowFlags(window) & SDL_WINDOW_MINIMIZED)) {
+    SDL_GetWindowSizeInPixels(window, width, height);
+  }
+}
+
 void* GetWindowHandle(void) { return window; }
+
+int WindowPrefPath(const char* file, char* path, size_t size) {
+  char* directory = SDL_GetPrefPath("CS226", "FinalProject");
+  if (directory == NULL) {
+    return -1;
+  }
+  int length = snprintf(path, size, "%s%s", directory, file);
+  SDL_free(directory);
+  return length >= 0 && (size_t)length < size ? 0 : -1;
+}
@@ -2,6 +2,9 @@
 #ifndef WINDOW_H_
 #define WINDOW_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+
 /* Create the main window */
 int CreateWindow(int width, int height, const char* title);
 
@@ -16,4 +19,15 @@ int VulkanInitializeSurface(void);
 
 void* GetWindowHandle(void);
 
+/* file in the user's preference directory, which SDL creates. -1 when
+ * there is none or the result does not fit in size bytes. Like every SDL
+ * call, only from the main thread */
+int WindowPrefPath(const char* file, char* path, size_t size);
+
+/* whether the window was resized since the last call */
+bool WindowResized(void);
+
+/* the drawable size in pixels, 0 x 0 while minimized */
+void GetWindowPixelSize(int* width, int* height);
+
 #endif  // WINDOW_H_